@@ -503,174 +503,222 @@ impl fmt::Display for TokenStream {
     }
 }
 
-/// Receive a token stream from the compiler
-pub fn recv_token_stream() -> TokenStream
-{
-    struct Reader<R> {
-        inner: R,
-    }
-    impl<R: ::std::io::Read> Reader<R> {
-        fn getb(&mut self) -> Option<u8> {
-            let mut b = [0];
+struct Reader<R> {
+    inner: R,
+}
+impl<R: ::std::io::Read> Reader<R> {
+    /// Read a byte, returning `None` at EOF
+    fn try_getb(&mut self) -> Option<u8> {
+        let mut b = [0];
+        loop
+        {
             match self.inner.read(&mut b)
             {
-            Ok(1) => Some(b[0]),
-            Ok(0) => panic!("Unexpected EOF reading from stdin"),
+            Ok(1) => return Some(b[0]),
+            Ok(0) => return None,
             Ok(_) => panic!("Bad byte count"),
+            Err(ref e) if e.kind() == ::std::io::ErrorKind::Interrupted => {},
             Err(e) => panic!("Error reading from stdin - {}", e),
             }
         }
-        fn get_u128v(&mut self) -> u128 {
-            let mut ofs = 0;
-            let mut raw_rv = 0u128;
-            loop
-            {
-                let b = self.getb().unwrap();
-                raw_rv |= ((b & 0x7F) as u128) << ofs;
-                if b < 128 {
-                    break;
-                }
-                assert!(ofs < 18);  // at most 18 bytes needed for a i128
-                ofs += 7;
-            }
-            raw_rv
-        }
-        fn get_i128v(&mut self) -> i128 {
-            let raw_rv = self.get_u128v();
-            // Zig-zag encoding (0 = 0, 1 = -1, 2 = 1, ...)
-            if raw_rv & 1 != 0 {
-                -( (raw_rv >> 1) as i128 + 1 )
-            }
-            else {
-                (raw_rv >> 1) as i128
-            }
+    }
+    fn getb(&mut self) -> Option<u8> {
+        match self.try_getb()
+        {
+        Some(v) => Some(v),
+        None => panic!("Unexpected EOF reading from stdin"),
         }
-        fn get_byte_vec(&mut self) -> Vec<u8> {
-            let size = self.get_u128v();
-            assert!(size < (1<<30));
-            let size = size as usize;
-            let mut buf = vec![0u8; size];
-            match self.inner.read_exact(&mut buf)
-            {
-            Ok(_) => {},
-            Err(e) => panic!("Error reading from stdin get_byte_vec({}) - {}", size, e),
+    }
+    fn get_u128v(&mut self) -> u128 {
+        let mut ofs = 0;
+        let mut raw_rv = 0u128;
+        loop
+        {
+            let b = self.getb().unwrap();
+            raw_rv |= ((b & 0x7F) as u128) << ofs;
+            if b < 128 {
+                break;
             }
-
-            buf
+            assert!(ofs < 18*7);  // at most 19 bytes needed for a u128
+            ofs += 7;
         }
-        fn get_string(&mut self) -> String {
-            let raw = self.get_byte_vec();
-            String::from_utf8(raw).expect("Invalid UTF-8 passed from compiler")
+        raw_rv
+    }
+    fn get_i128v(&mut self) -> i128 {
+        let raw_rv = self.get_u128v();
+        // Zig-zag encoding (0 = 0, 1 = -1, 2 = 1, ...)
+        if raw_rv & 1 != 0 {
+            -( (raw_rv >> 1) as i128 + 1 )
         }
-        fn get_f64(&mut self) -> f64 {
-            let mut buf = [0u8; 8];
-            match self.inner.read_exact(&mut buf)
-            {
-            Ok(_) => {},
-            Err(e) => panic!("Error reading from stdin - {}", e),
-            }
-            unsafe {
-                ::std::mem::transmute(buf)
-            }
+        else {
+            (raw_rv >> 1) as i128
         }
     }
+    fn get_byte_vec(&mut self) -> Vec<u8> {
+        let size = self.get_u128v();
+        assert!(size < (1<<30));
+        let size = size as usize;
+        let mut buf = vec![0u8; size];
+        match self.inner.read_exact(&mut buf)
+        {
+        Ok(_) => {},
+        Err(e) => panic!("Error reading from stdin get_byte_vec({}) - {}", size, e),
+        }
 
-    let mut s = Reader { inner: ::std::io::stdin().lock() };
-    let mut toks = Vec::new();
-    loop
-    {
-        let hdr_b = some_else!( s.getb() => break );
-        toks.push(match hdr_b
-            {
-            0 => {
-                let sym = s.get_string();
-                if sym == "" { break ; }
-                Token::Symbol( sym )
-                },
-            1 => Token::Ident( s.get_string() ),
-            2 => Token::Lifetime( s.get_string() ),
-            3 => Token::String( s.get_string() ),
-            4 => Token::ByteString( s.get_byte_vec() ),
-            5 => Token::CharLit(::std::char::from_u32(s.get_i128v() as u32).expect("char lit")),
-            6 => {
-                let ty = s.getb().expect("getb int ty");
-                Token::UnsignedInt(s.get_u128v(), ty)
-                },
-            7 => {
-                let ty = s.getb().expect("getb int ty");
-                Token::SignedInt(s.get_i128v(), ty)
-                },
-            8 => {
-                let ty = s.getb().expect("getb float ty");
-                Token::Float(s.get_f64(), ty)
-                }
-            });
-        //eprintln!("> {:?}\r", toks.last().unwrap());
+        buf
     }
-    TokenStream {
-        inner: toks,
-        }
-}
-/// Send a token stream back to the compiler
-pub fn send_token_stream(ts: TokenStream)
-{
-    struct Writer<T> {
-        inner: T,
+    fn get_string(&mut self) -> String {
+        let raw = self.get_byte_vec();
+        String::from_utf8(raw).expect("Invalid UTF-8 passed from compiler")
     }
-    impl<T: ::std::io::Write> Writer<T> {
-        fn putb(&mut self, v: u8) {
-            let buf = [v];
-            self.inner.write(&buf).expect("");
+    fn get_f64(&mut self) -> f64 {
+        let mut buf = [0u8; 8];
+        match self.inner.read_exact(&mut buf)
+        {
+        Ok(_) => {},
+        Err(e) => panic!("Error reading from stdin - {}", e),
         }
-        fn put_u128v(&mut self, mut v: u128) {
-            while v > 128 {
-                self.putb( (v & 0x7F) as u8 | 0x80 );
-                v >>= 7;
-            }
-            self.putb( (v & 0x7F) as u8 );
+        unsafe {
+            ::std::mem::transmute(buf)
         }
-        fn put_i128v(&mut self, v: i128) {
-            if v < 0 {
-                self.put_u128v( (((v + 1) as u128) << 1) | 1 );
-            }
-            else {
-                self.put_u128v( (v as u128) << 1 );
+    }
+
+    /// Read a frame (length-prefixed block), returning `None` if EOF is hit before the frame starts
+    fn get_frame(&mut self) -> Option<Vec<u8>> {
+        let mut ofs = 0;
+        let mut size = 0u128;
+        loop
+        {
+            let b = if ofs == 0 { some_else!(self.try_getb() => return None) } else { self.getb().unwrap() };
+            size |= ((b & 0x7F) as u128) << ofs;
+            if b < 128 {
+                break;
             }
+            assert!(ofs < 18*7);
+            ofs += 7;
         }
-        fn put_bytes(&mut self, v: &[u8]) {
-            self.put_u128v(v.len() as u128);
-            self.inner.write(v).expect("");
+        assert!(size < (1<<30));
+        let mut buf = vec![0u8; size as usize];
+        match self.inner.read_exact(&mut buf)
+        {
+        Ok(_) => {},
+        Err(e) => panic!("Error reading from stdin get_frame({}) - {}", size, e),
         }
-        fn put_f64(&mut self, v: f64) {
-            let buf: [u8; 8] = unsafe { ::std::mem::transmute(v) };
-            self.inner.write(&buf).expect("");
+        Some(buf)
+    }
+
+    fn get_token_stream(&mut self) -> TokenStream {
+        let mut toks = Vec::new();
+        loop
+        {
+            let hdr_b = some_else!( self.getb() => break );
+            toks.push(match hdr_b
+                {
+                0 => {
+                    let sym = self.get_string();
+                    if sym == "" { break ; }
+                    Token::Symbol( sym )
+                    },
+                1 => Token::Ident( self.get_string() ),
+                2 => Token::Lifetime( self.get_string() ),
+                3 => Token::String( self.get_string() ),
+                4 => Token::ByteString( self.get_byte_vec() ),
+                5 => Token::CharLit(::std::char::from_u32(self.get_i128v() as u32).expect("char lit")),
+                6 => {
+                    let ty = self.getb().expect("getb int ty");
+                    Token::UnsignedInt(self.get_u128v(), ty)
+                    },
+                7 => {
+                    let ty = self.getb().expect("getb int ty");
+                    Token::SignedInt(self.get_i128v(), ty)
+                    },
+                8 => {
+                    let ty = self.getb().expect("getb float ty");
+                    Token::Float(self.get_f64(), ty)
+                    },
+                v => panic!("Unknown token class {} from compiler", v),
+                });
+            //eprintln!("> {:?}\r", toks.last().unwrap());
         }
+        TokenStream {
+            inner: toks,
+            }
     }
+}
 
-    let mut s = Writer { inner: ::std::io::stdout().lock() };
+struct Writer<T> {
+    inner: T,
+}
+impl<T: ::std::io::Write> Writer<T> {
+    fn putb(&mut self, v: u8) {
+        let buf = [v];
+        self.inner.write_all(&buf).expect("");
+    }
+    fn put_u128v(&mut self, mut v: u128) {
+        while v >= 128 {
+            self.putb( (v & 0x7F) as u8 | 0x80 );
+            v >>= 7;
+        }
+        self.putb( (v & 0x7F) as u8 );
+    }
+    fn put_i128v(&mut self, v: i128) {
+        if v < 0 {
+            self.put_u128v( (((v + 1) as u128) << 1) | 1 );
+        }
+        else {
+            self.put_u128v( (v as u128) << 1 );
+        }
+    }
+    fn put_bytes(&mut self, v: &[u8]) {
+        self.put_u128v(v.len() as u128);
+        self.inner.write_all(v).expect("");
+    }
+    fn put_f64(&mut self, v: f64) {
+        let buf: [u8; 8] = unsafe { ::std::mem::transmute(v) };
+        self.inner.write_all(&buf).expect("");
+    }
 
-    for t in &ts.inner
-    {
-        //eprintln!("{:?}\r", t);
-        match t
+    fn put_token_stream(&mut self, ts: &TokenStream) {
+        for t in &ts.inner
         {
-        &Token::Symbol(ref v)   => { s.putb(0); s.put_bytes(v.as_bytes()); },
-        &Token::Ident(ref v)    => { s.putb(1); s.put_bytes(v.as_bytes()); },
-        &Token::Lifetime(ref v) => { s.putb(2); s.put_bytes(v.as_bytes()); },
-        &Token::String(ref v)      => { s.putb(3); s.put_bytes(v.as_bytes()); },
-        &Token::ByteString(ref v)  => { s.putb(4); s.put_bytes(&v[..]); },
-        &Token::CharLit(v)         => { s.putb(5); s.put_u128v(v as u32 as u128); },
-        &Token::UnsignedInt(v, sz) => { s.putb(6); s.putb(sz); s.put_u128v(v); },
-        &Token::SignedInt(v, sz)   => { s.putb(7); s.putb(sz); s.put_i128v(v); },
-        &Token::Float(v, sz)       => { s.putb(8); s.putb(sz); s.put_f64(v); },
-        &Token::Fragment(ty, key)  => { s.putb(9); s.putb(ty as u8); s.put_u128v(key as u128); },
+            //eprintln!("{:?}\r", t);
+            match t
+            {
+            &Token::Symbol(ref v)   => { self.putb(0); self.put_bytes(v.as_bytes()); },
+            &Token::Ident(ref v)    => { self.putb(1); self.put_bytes(v.as_bytes()); },
+            &Token::Lifetime(ref v) => { self.putb(2); self.put_bytes(v.as_bytes()); },
+            &Token::String(ref v)      => { self.putb(3); self.put_bytes(v.as_bytes()); },
+            &Token::ByteString(ref v)  => { self.putb(4); self.put_bytes(&v[..]); },
+            &Token::CharLit(v)         => { self.putb(5); self.put_u128v(v as u32 as u128); },
+            &Token::UnsignedInt(v, sz) => { self.putb(6); self.putb(sz); self.put_u128v(v); },
+            &Token::SignedInt(v, sz)   => { self.putb(7); self.putb(sz); self.put_i128v(v); },
+            &Token::Float(v, sz)       => { self.putb(8); self.putb(sz); self.put_f64(v); },
+            &Token::Fragment(ty, key)  => { self.putb(9); self.putb(ty as u8); self.put_u128v(key as u128); },
+            }
         }
+
+        // Empty symbol indicates EOF
+        self.putb(0); self.putb(0);
     }
+}
 
-    // Empty symbol indicates EOF
-    s.putb(0); s.putb(0);
-    drop(s);
-    ::std::io::Write::flush(&mut ::std::io::stdout());
+/// Receive a token stream from the compiler
+pub fn recv_token_stream() -> TokenStream
+{
+    let stdin = ::std::io::stdin();
+    let mut s = Reader { inner: stdin.lock() };
+    s.get_token_stream()
+}
+/// Send a token stream back to the compiler
+pub fn send_token_stream(ts: TokenStream)
+{
+    // Serialise to a buffer first, so the data goes out in a single write
+    let mut buf = Vec::new();
+    Writer { inner: &mut buf }.put_token_stream(&ts);
+    let stdout = ::std::io::stdout();
+    let mut s = stdout.lock();
+    ::std::io::Write::write_all(&mut s, &buf).expect("");
+    ::std::io::Write::flush(&mut s).expect("");
 }
 
 pub struct MacroDesc
@@ -679,11 +727,59 @@ pub struct MacroDesc
     handler: fn(TokenStream)->TokenStream,
 }
 
+/// Handle requests from the compiler until it closes our stdin
+///
+/// Each request is a frame containing the macro name then the input token stream, the response is a frame containing
+/// the output token stream.
+fn run_server(macros: &[MacroDesc])
+{
+    use std::io::Write;
+    let stdin = ::std::io::stdin();
+    let stdout = ::std::io::stdout();
+    let mut input = Reader { inner: stdin.lock() };
+    let mut output = stdout.lock();
+
+    output.write_all(&[0]).expect("");
+    output.flush().expect("");
+
+    let mut buf = Vec::new();
+    let mut frame_buf = Vec::new();
+    while let Some(req) = input.get_frame()
+    {
+        let mut r = Reader { inner: &req[..] };
+        let mac_name = r.get_string();
+        let m = match macros.iter().find(|m| m.name == mac_name)
+            {
+            Some(m) => m,
+            None => panic!("Unknown macro name '{}'", mac_name),
+            };
+        let input = r.get_token_stream();
+        debug!("{}: INPUT = `{}`\r", mac_name, input);
+        let output_ts = (m.handler)( input );
+        debug!("{}: OUTPUT = `{}`\r", mac_name, output_ts);
+
+        buf.clear();
+        Writer { inner: &mut buf }.put_token_stream(&output_ts);
+        frame_buf.clear();
+        {
+            let mut w = Writer { inner: &mut frame_buf };
+            w.put_bytes(&buf);
+        }
+        output.write_all(&frame_buf).expect("");
+        output.flush().expect("");
+    }
+    note!("Done");
+}
+
 pub fn main(macros: &[MacroDesc])
 {
     //::env_logger::init();
 
     let mac_name = ::std::env::args().nth(1).expect("Was not passed a macro name");
+    if mac_name == "--server" {
+        run_server(macros);
+        return ;
+    }
     //eprintln!("Searching for macro {}\r", mac_name);
     for m in macros
     {
@@ -703,4 +799,3 @@ pub fn main(macros: &[MacroDesc])
     }
     panic!("Unknown macro name '{}'", mac_name);
 }
-
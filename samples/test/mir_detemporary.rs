@@ -0,0 +1,88 @@
+// MIR temporary elimination (copy propagation across blocks)
+// - A use of a copy may only be replaced by its source while the source is unchanged on every path
+
+fn copy_then_overwrite_source(mut a: i32) -> i32 {
+    let t = a;
+    a = 5;
+    t + a
+}
+
+#[test]
+fn overwritten_source()
+{
+    assert_eq!(copy_then_overwrite_source(1), 6);
+}
+
+fn copy_in_loop(n: i32) -> i32 {
+    let mut x = 1;
+    let mut acc = 0;
+    let mut i = 0;
+    while i < n {
+        let t = x;
+        x = x + 1;
+        acc += t;
+        i += 1;
+    }
+    acc
+}
+
+#[test]
+fn source_changed_by_loop()
+{
+    assert_eq!(copy_in_loop(4), 10);
+}
+
+fn copy_on_one_path(c: bool, a: i32, b: i32) -> i32 {
+    let mut t = a;
+    if c {
+        t = b;
+    }
+    let u = t;
+    u * 10 + t
+}
+
+#[test]
+fn copy_from_merged_paths()
+{
+    assert_eq!(copy_on_one_path(true, 1, 2), 22);
+    assert_eq!(copy_on_one_path(false, 1, 2), 11);
+}
+
+fn copy_of_borrowed_local() -> i32 {
+    let mut a = 1;
+    let t = a;
+    {
+        let r = &mut a;
+        *r = 7;
+    }
+    t * 10 + a
+}
+
+#[test]
+fn source_written_through_borrow()
+{
+    assert_eq!(copy_of_borrowed_local(), 17);
+}
+
+struct DropCount<'a>(&'a ::std::cell::Cell<i32>);
+impl<'a> ::std::ops::Drop for DropCount<'a>
+{
+    fn drop(&mut self) {
+        self.0.set( self.0.get() + 1 );
+    }
+}
+
+#[test]
+fn moved_through_temporaries()
+{
+    let count = ::std::cell::Cell::new(0);
+    {
+        let a = DropCount(&count);
+        let b = a;
+        let c = if count.get() == 0 { b } else { DropCount(&count) };
+        assert_eq!(count.get(), 0);
+        drop(c);
+        assert_eq!(count.get(), 1);
+    }
+    assert_eq!(count.get(), 1);
+}
@@ -0,0 +1,94 @@
+// MIR inliner
+// - Recursive `#[inline(always)]` functions can't be fully inlined, compilation must still terminate
+// - Inlined code must behave the same as the call it replaces
+
+#[inline(always)]
+fn count_down(n: u32) -> u32 {
+    if n == 0 { 0 } else { 1 + count_down(n - 1) }
+}
+
+#[inline(always)]
+fn is_even(n: u32) -> bool {
+    if n == 0 { true } else { is_odd(n - 1) }
+}
+#[inline(always)]
+fn is_odd(n: u32) -> bool {
+    if n == 0 { false } else { is_even(n - 1) }
+}
+
+#[test]
+fn recursive_inline_always()
+{
+    assert_eq!(count_down(10), 10);
+    assert!(is_even(10));
+    assert!(is_odd(7));
+    assert!(!is_odd(4));
+}
+
+// Generic, so it is only inlined once monomorphised
+#[inline(always)]
+fn generic_depth<T: Copy>(v: T, n: u32) -> u32 {
+    if n == 0 { 0 } else { 1 + generic_depth(v, n - 1) }
+}
+
+#[test]
+fn recursive_inline_always_generic()
+{
+    assert_eq!(generic_depth(1u8, 5), 5);
+    assert_eq!(generic_depth("x", 3), 3);
+}
+
+#[inline(never)]
+fn double(a: i32) -> i32 {
+    a * 2
+}
+fn add(a: i32, b: i32) -> i32 {
+    a + b
+}
+fn shift(x: i32, by: u32) -> i32 {
+    if by > 0 { x << by } else { x }
+}
+
+#[test]
+fn inlined_calls()
+{
+    let mut v = 0;
+    let mut i = 0;
+    while i < 10 {
+        v = add(v, double(i));
+        i += 1;
+    }
+    assert_eq!(v, 90);
+    // Constant arguments
+    assert_eq!(shift(3, 2), 12);
+    assert_eq!(shift(3, 0), 3);
+}
+
+struct DropCount<'a>(&'a ::std::cell::Cell<i32>);
+impl<'a> ::std::ops::Drop for DropCount<'a>
+{
+    fn drop(&mut self) {
+        self.0.set( self.0.get() + 1 );
+    }
+}
+fn consume(_v: DropCount) {
+}
+fn bump(v: &mut i32, by: i32) {
+    *v += by;
+}
+
+#[test]
+fn inlined_drops_and_borrows()
+{
+    let count = ::std::cell::Cell::new(0);
+    consume(DropCount(&count));
+    assert_eq!(count.get(), 1);
+    consume(DropCount(&count));
+    assert_eq!(count.get(), 2);
+
+    let mut v = 1;
+    bump(&mut v, 2);
+    let by = v;
+    bump(&mut v, by);
+    assert_eq!(v, 6);
+}
@@ -0,0 +1,75 @@
+// MIR value numbering (common subexpression elimination)
+// - A repeated expression may only reuse the earlier result if none of its inputs changed in between
+
+fn recompute_after_write(mut a: i32, b: i32) -> (i32, i32) {
+    let x = a + b;
+    a += 1;
+    let y = a + b;
+    (x, y)
+}
+
+#[test]
+fn write_to_operand()
+{
+    assert_eq!(recompute_after_write(1, 2), (3, 4));
+}
+
+fn recompute_after_store(v: &mut i32, b: i32) -> (i32, i32) {
+    let x = *v * b;
+    *v += 1;
+    let y = *v * b;
+    (x, y)
+}
+
+#[test]
+fn write_through_pointer()
+{
+    let mut v = 3;
+    assert_eq!(recompute_after_store(&mut v, 2), (6, 8));
+    assert_eq!(v, 4);
+}
+
+fn recompute_after_branch(c: bool, a: i32, b: i32) -> i32 {
+    let x = if c { a * b } else { a - b };
+    let y = a * b;
+    x + y
+}
+
+#[test]
+fn expression_in_one_branch()
+{
+    assert_eq!(recompute_after_branch(true, 3, 4), 24);
+    assert_eq!(recompute_after_branch(false, 3, 4), 11);
+}
+
+fn recompute_after_call(c: &::std::cell::Cell<i32>) -> (i32, i32) {
+    let x = c.get() + 1;
+    c.set(10);
+    let y = c.get() + 1;
+    (x, y)
+}
+
+#[test]
+fn write_by_call()
+{
+    let c = ::std::cell::Cell::new(1);
+    assert_eq!(recompute_after_call(&c), (2, 11));
+}
+
+fn recompute_in_loop(n: i32) -> i32 {
+    let mut i = 0;
+    let mut acc = 0;
+    while i < n {
+        let a = i * 3;
+        i += 1;
+        let b = i * 3;
+        acc += b - a;
+    }
+    acc
+}
+
+#[test]
+fn loop_carried_value()
+{
+    assert_eq!(recompute_in_loop(5), 15);
+}
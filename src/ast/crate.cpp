@@ -6,6 +6,7 @@
 #include "../expand/cfg.hpp"
 #include <hir/hir.hpp>  // HIR::Crate
 #include <hir/main_bindings.hpp>    // HIR_Deserialise
+#include <timings.hpp>
 #include <fstream>
 
 ::std::vector<::std::string>    AST::g_crate_load_dirs = { };
@@ -178,6 +179,7 @@ ExternCrate::ExternCrate(const ::std::string& name, const ::std::string& path):
     m_filename(path)
 {
     TRACE_FUNCTION_F("name=" << name << ", path='" << path << "'");
+    Timings_Scope   ts(name);
     m_hir = HIR_Deserialise(path, name);
 
     m_hir->post_load_update(name);
@@ -22,6 +22,7 @@
 #define rc_new$(...) ::make_shared_ptr(::std::move(__VA_ARGS__))
 
 #include "include/debug.hpp"
+#include "include/rc_string.hpp"
 #include "include/rustic.hpp"   // slice and option
 #include "include/compile_error.hpp"
 
@@ -131,6 +132,11 @@ static inline Ordering ord(const ::std::string& l, const ::std::string& r)
     else
         return OrdLess;
 }
+static inline Ordering ord(const RcString& l, const RcString& r)
+{
+    int v = l.compare(r);
+    return v == 0 ? OrdEqual : (v > 0 ? OrdGreater : OrdLess);
+}
 template<typename T>
 Ordering ord(const T& l, const T& r)
 {
@@ -1,46 +1,25 @@
 
 #include <debug.hpp>
 
-TraceLog::TraceLog(const char* tag, ::std::function<void(::std::ostream&)> info_cb, ::std::function<void(::std::ostream&)> ret):
-    m_tag(tag),
-    m_ret(ret)
+void TraceLog::enter(void (*info_fcn)(const void*, ::std::ostream&), const void* info_obj)
 {
-    if(debug_enabled()) {
-        auto& os = debug_output(g_debug_indent_level, m_tag);
+    auto& os = debug_output(g_debug_indent_level, m_tag);
+    if( info_fcn ) {
         os << ">> (";
-        info_cb(os);
+        info_fcn(info_obj, os);
         os << ")" << ::std::endl;
     }
-    INDENT();
-}
-TraceLog::TraceLog(const char* tag, ::std::function<void(::std::ostream&)> info_cb):
-    m_tag(tag),
-    m_ret([](const auto&){})
-{
-    if(debug_enabled()) {
-        auto& os = debug_output(g_debug_indent_level, m_tag);
-        os << ">> (";
-        info_cb(os);
-        os << ")" << ::std::endl;
-    }
-    INDENT();
-}
-TraceLog::TraceLog(const char* tag):
-    m_tag(tag),
-    m_ret([](const auto&){})
-{
-    if(debug_enabled()) {
-        auto& os = debug_output(g_debug_indent_level, m_tag);
+    else {
         os << ">>" << ::std::endl;
     }
     INDENT();
 }
-TraceLog::~TraceLog() {
+void TraceLog::leave()
+{
     UNINDENT();
-    if(debug_enabled()) {
-        auto& os = debug_output(g_debug_indent_level, m_tag);
-        os << "<< (";
-        m_ret(os);
-        os << ")" << ::std::endl;
-    }
+    auto& os = debug_output(g_debug_indent_level, m_tag);
+    os << "<< (";
+    if( m_ret_fcn )
+        m_ret_fcn(m_ret_obj, os);
+    os << ")" << ::std::endl;
 }
@@ -12,6 +12,7 @@
 #include <parse/ttstream.hpp>
 #include <parse/lex.hpp>    // Lexer (new files)
 #include <ast/expr.hpp>
+#include <fstream>
 
 namespace {
 
@@ -62,7 +62,7 @@ class CMacroUseHandler:
                     });
                 for(const auto& p : ec.m_hir->m_proc_macros)
                 {
-                    mod.m_macro_imports.push_back(::std::make_pair( p.path.m_components, nullptr ));
+                    mod.m_macro_imports.push_back(::std::make_pair( ::std::vector< ::std::string>(p.path.m_components.begin(), p.path.m_components.end()), nullptr ));
                     mod.m_macro_imports.back().first.insert( mod.m_macro_imports.back().first.begin(), p.path.m_crate_name );
                 }
             }
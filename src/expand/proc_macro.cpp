@@ -152,27 +152,68 @@ enum class FragType
     Block = 6,
     Pattern = 7,
 };
-struct ProcMacroInv:
-    public TokenStream
+/// Connection to a running proc macro plugin (one per plugin executable, shared by all invocations)
+///
+/// Each invocation is a single request frame (`v128 length`, then the macro name and the input token stream), and
+/// is answered by a single response frame (the output token stream). Frames are written with one `write` call,
+/// and the incoming side is read in large chunks.
+class ProcMacroServer
 {
-    Span    m_parent_span;
-    const ::HIR::ProcMacro& m_proc_macro_desc;
-
-#ifdef WIN32
+    ::std::string   m_executable;
+    bool    m_good = false;
+#ifdef _WIN32
     HANDLE  child_handle;
     HANDLE  child_stdin;
     HANDLE  child_stdout;
 #else
     // POSIX
-    pid_t   child_pid;  // Questionably needed
-     int    child_stdin;
-     int    child_stdout;
+    pid_t   child_pid = 0;
+     int    child_stdin = -1;
+     int    child_stdout = -1;
     // NOTE: stderr stays as our stderr
 #endif
+
+    ::std::vector<uint8_t>  m_rbuf;
+    size_t  m_rbuf_pos = 0;
+    size_t  m_rbuf_len = 0;
+
+public:
+    ProcMacroServer(const Span& sp, ::std::string executable);
+    ProcMacroServer(const ProcMacroServer&) = delete;
+    ProcMacroServer& operator=(const ProcMacroServer&) = delete;
+    ~ProcMacroServer();
+
+    /// Obtain the (started) server for the given plugin executable
+    static ProcMacroServer& get(const Span& sp, const ::std::string& executable);
+
+    bool is_good() const { return m_good; }
+    /// Send a request frame and return the payload of the response frame
+    ::std::string transact(const Span& sp, const ::std::string& request);
+
+private:
+    void write_all(const Span& sp, const void* data, size_t len);
+    /// Read more data into the buffer, returns false on EOF
+    bool fill(const Span& sp);
+    bool recv_u8(const Span& sp, uint8_t& v);
+    void recv_exact(const Span& sp, void* data, size_t len);
+};
+
+struct ProcMacroInv:
+    public TokenStream
+{
+    Span    m_parent_span;
+    const ::HIR::ProcMacro& m_proc_macro_desc;
+    ProcMacroServer&    m_server;
+
+    /// Request payload (filled by the `send_*` methods, and sent by `send_done`)
+    ::std::string   m_request;
+    /// Response payload (read by `realGetToken`)
+    ::std::string   m_response;
+    size_t  m_response_pos = 0;
     bool    m_eof_hit = false;
 
 public:
-    ProcMacroInv(const Span& sp, const char* executable, const ::HIR::ProcMacro& proc_macro_desc);
+    ProcMacroInv(const Span& sp, ProcMacroServer& server, const ::HIR::ProcMacro& proc_macro_desc);
     ProcMacroInv(const ProcMacroInv&) = delete;
     ProcMacroInv(ProcMacroInv&&);
     ProcMacroInv& operator=(const ProcMacroInv&) = delete;
@@ -180,10 +221,7 @@ public:
     virtual ~ProcMacroInv();
 
     bool check_good();
-    void send_done() {
-        send_symbol("");
-        DEBUG("Input tokens sent");
-    }
+    void send_done();
     void send_symbol(const char* val) {
         this->send_u8(static_cast<uint8_t>(TokenClass::Symbol));
         this->send_bytes(val, ::std::strlen(val));
@@ -256,8 +294,8 @@ ProcMacroInv ProcMacro_Invoke_int(const Span& sp, const ::AST::Crate& crate, con
     // 2. Get executable and macro name
     ::std::string   proc_macro_exe_name = (ext_crate.m_filename + "-plugin");
 
-    // 3. Create ProcMacroInv
-    return ProcMacroInv(sp, proc_macro_exe_name.c_str(), *pmp);
+    // 3. Create ProcMacroInv (starting the plugin if this is the first use)
+    return ProcMacroInv(sp, ProcMacroServer::get(sp, proc_macro_exe_name), *pmp);
 }
 
 
@@ -778,10 +816,22 @@ namespace {
     return box$(pmi);
 }
 
-ProcMacroInv::ProcMacroInv(const Span& sp, const char* executable, const ::HIR::ProcMacro& proc_macro_desc):
-    m_parent_span(sp),
-    m_proc_macro_desc(proc_macro_desc)
+ProcMacroServer& ProcMacroServer::get(const Span& sp, const ::std::string& executable)
 {
+    // NOTE: Servers live until the compiler exits (closing their stdin then tells the plugin to stop)
+    static ::std::map< ::std::string, ::std::unique_ptr<ProcMacroServer> >  s_servers;
+    auto it = s_servers.find(executable);
+    if( it == s_servers.end() )
+    {
+        it = s_servers.insert(::std::make_pair( executable, ::std::unique_ptr<ProcMacroServer>(new ProcMacroServer(sp, executable)) )).first;
+    }
+    return *it->second;
+}
+ProcMacroServer::ProcMacroServer(const Span& sp, ::std::string executable):
+    m_executable(mv$(executable)),
+    m_rbuf(64*1024)
+{
+    const char* exe = m_executable.c_str();
 #ifdef _WIN32
 #else
      int    stdin_pipes[2];
@@ -806,9 +856,10 @@ ProcMacroInv::ProcMacroInv(const Span& sp, const char* executable, const ::HIR::
     posix_spawn_file_actions_addclose(&file_actions, stdout_pipes[0]);
     posix_spawn_file_actions_addclose(&file_actions, stdout_pipes[1]);
 
-    char*   argv[3] = { const_cast<char*>(executable), const_cast<char*>(proc_macro_desc.name.c_str()), nullptr };
+    // `--server` requests the multi-invocation mode (passing a macro name instead runs a single invocation)
+    char*   argv[3] = { const_cast<char*>(exe), const_cast<char*>("--server"), nullptr };
     //char*   envp[] = { nullptr };
-    int rv = posix_spawn(&this->child_pid, executable, &file_actions, nullptr, argv, environ);
+    int rv = posix_spawn(&this->child_pid, exe, &file_actions, nullptr, argv, environ);
     if( rv != 0 )
     {
         BUG(sp, "Error in posix_spawn - " << rv);
@@ -818,97 +869,186 @@ ProcMacroInv::ProcMacroInv(const Span& sp, const char* executable, const ::HIR::
     // Close the ends we don't care about.
     close(stdin_pipes[0]);
     close(stdout_pipes[1]);
-
 #endif
-}
-ProcMacroInv::ProcMacroInv(ProcMacroInv&& x):
-    m_parent_span(x.m_parent_span),
-    m_proc_macro_desc(x.m_proc_macro_desc),
-#ifdef _WIN32
-    child_handle(x.child_handle),
-    child_stdin(x.child_stdin),
-    child_stdout(x.child_stdout)
-#else
-    child_pid(x.child_pid),
-    child_stdin(x.child_stdin),
-    child_stdout(x.child_stdout)
-#endif
-{
-#ifdef _WIN32
-#else
-    x.child_pid = 0;
-#endif
-    DEBUG("");
-}
-#if 0
-ProcMacroInv& ProcMacroInv::operator=(ProcMacroInv&& x)
-{
-    m_parent_span = x.m_parent_span;
-#ifdef _WIN32
-#else
-    child_pid = x.child_pid;
-    child_stdin = x.child_stdin;
-    child_stdout = x.child_stdout;
 
-    x.child_pid = 0;
-#endif
-    DEBUG("");
-    return *this;
+    // The plugin sends a single zero byte once it has started
+    uint8_t v;
+    if( !this->recv_u8(sp, v) )
+    {
+        DEBUG("Unexpected EOF from child");
+    }
+    else
+    {
+        DEBUG("Child started, value = " << (int)v);
+        m_good = (v == 0);
+    }
 }
-#endif
-ProcMacroInv::~ProcMacroInv()
+ProcMacroServer::~ProcMacroServer()
 {
 #ifdef _WIN32
 #else
     if( this->child_pid != 0 )
     {
+        // Closing stdin ends the plugin's request loop
+        close(this->child_stdin);
         DEBUG("Waiting for child " << this->child_pid << " to terminate");
         int status;
         waitpid(this->child_pid, &status, 0);
         close(this->child_stdout);
-        close(this->child_stdin);
     }
 #endif
 }
-bool ProcMacroInv::check_good()
+::std::string ProcMacroServer::transact(const Span& sp, const ::std::string& request)
 {
-    char    v;
+    ASSERT_BUG(sp, m_good, "Sending a request to a failed proc macro plugin");
+    // Frame header (`v128` payload length), then the payload
+    {
+        uint8_t hdr[10];
+        size_t  hdr_len = 0;
+        uint64_t    len = request.size();
+        while( len >= 128 ) {
+            hdr[hdr_len++] = static_cast<uint8_t>(len & 0x7F) | 0x80;
+            len >>= 7;
+        }
+        hdr[hdr_len++] = static_cast<uint8_t>(len & 0x7F);
+        ::std::string   frame;
+        frame.reserve(hdr_len + request.size());
+        frame.append(reinterpret_cast<const char*>(hdr), hdr_len);
+        frame.append(request);
+        this->write_all(sp, frame.data(), frame.size());
+    }
+
+    // Response: Same framing
+    uint64_t    len = 0;
+    for(unsigned ofs = 0; ; ofs += 7)
+    {
+        uint8_t b;
+        if( !this->recv_u8(sp, b) )
+        {
+            m_good = false;
+            ERROR(sp, E0000, "Proc macro plugin `" << m_executable << "` exited while handling a request");
+        }
+        len |= static_cast<uint64_t>(b & 0x7F) << ofs;
+        if( (b & 0x80) == 0 )
+            break;
+    }
+    ASSERT_BUG(sp, len < SIZE_MAX, "Oversized response from child process");
+    ::std::string   rv;
+    rv.resize(len);
+    this->recv_exact(sp, &rv[0], len);
+    return rv;
+}
+void ProcMacroServer::write_all(const Span& sp, const void* data, size_t len)
+{
+    const char* p = static_cast<const char*>(data);
+    while( len > 0 )
+    {
 #ifdef _WIN32
-    int rv = ReadFile(this->child_stdout, &v, 1, nullptr, nullptr);
+        DWORD n;
+        if( !WriteFile(this->child_stdin, p, len, &n, nullptr) )
+            BUG(sp, "Error writing to child");
 #else
-    int rv = read(this->child_stdout, &v, 1);
+        auto n = write(this->child_stdin, p, len);
+        if( n < 0 && errno == EINTR )
+            continue ;
+        if( n <= 0 )
+            BUG(sp, "Error writing to child, " << strerror(errno));
 #endif
-    if( rv == 0 )
-    {
-        DEBUG("Unexpected EOF from child");
-        return false;
+        p += n;
+        len -= n;
     }
-    if( rv < 0 )
+}
+bool ProcMacroServer::fill(const Span& sp)
+{
+    assert(m_rbuf_pos == m_rbuf_len);
+    for(;;)
     {
-        DEBUG("Error reading from child, rv=" << rv << " " << strerror(errno));
-        return false;
+#ifdef _WIN32
+        DWORD n;
+        if( !ReadFile(this->child_stdout, m_rbuf.data(), m_rbuf.size(), &n, nullptr) )
+            n = 0;
+#else
+        auto n = read(this->child_stdout, m_rbuf.data(), m_rbuf.size());
+        if( n < 0 && errno == EINTR )
+            continue ;
+        if( n < 0 ) {
+            BUG(sp, "Error while reading from child process, " << strerror(errno));
+        }
+#endif
+        m_rbuf_pos = 0;
+        m_rbuf_len = n;
+        return n > 0;
     }
-    DEBUG("Child started, value = " << (int)v);
-    if( v != 0 )
+}
+bool ProcMacroServer::recv_u8(const Span& sp, uint8_t& v)
+{
+    if( m_rbuf_pos == m_rbuf_len && !this->fill(sp) )
         return false;
+    v = m_rbuf[m_rbuf_pos++];
     return true;
 }
+void ProcMacroServer::recv_exact(const Span& sp, void* data, size_t len)
+{
+    char*   p = static_cast<char*>(data);
+    while( len > 0 )
+    {
+        if( m_rbuf_pos == m_rbuf_len && !this->fill(sp) )
+        {
+            m_good = false;
+            ERROR(sp, E0000, "Proc macro plugin `" << m_executable << "` exited while handling a request");
+        }
+        size_t  n = ::std::min(len, m_rbuf_len - m_rbuf_pos);
+        memcpy(p, m_rbuf.data() + m_rbuf_pos, n);
+        m_rbuf_pos += n;
+        p += n;
+        len -= n;
+    }
+}
+
+ProcMacroInv::ProcMacroInv(const Span& sp, ProcMacroServer& server, const ::HIR::ProcMacro& proc_macro_desc):
+    m_parent_span(sp),
+    m_proc_macro_desc(proc_macro_desc),
+    m_server(server)
+{
+    // Request header: the name of the macro to invoke
+    this->send_bytes(proc_macro_desc.name.data(), proc_macro_desc.name.size());
+}
+ProcMacroInv::ProcMacroInv(ProcMacroInv&& x):
+    m_parent_span(x.m_parent_span),
+    m_proc_macro_desc(x.m_proc_macro_desc),
+    m_server(x.m_server),
+    m_request(mv$(x.m_request)),
+    m_response(mv$(x.m_response)),
+    m_response_pos(x.m_response_pos),
+    m_eof_hit(x.m_eof_hit)
+{
+    DEBUG("");
+}
+ProcMacroInv::~ProcMacroInv()
+{
+}
+bool ProcMacroInv::check_good()
+{
+    return m_server.is_good();
+}
+void ProcMacroInv::send_done()
+{
+    send_symbol("");
+    DEBUG("Input tokens sent (" << m_request.size() << " bytes)");
+    // The whole response is read here, so the connection is free for other invocations while this one is consumed
+    m_response = m_server.transact(m_parent_span, m_request);
+    m_request = ::std::string();
+    m_response_pos = 0;
+    DEBUG("Output tokens received (" << m_response.size() << " bytes)");
+}
 void ProcMacroInv::send_u8(uint8_t v)
 {
-#ifdef _WIN32
-#else
-    if( write(this->child_stdin, &v, 1) != 1 )
-        BUG(m_parent_span, "Error writing to child, " << strerror(errno));
-#endif
+    m_request.push_back(static_cast<char>(v));
 }
 void ProcMacroInv::send_bytes(const void* val, size_t size)
 {
     this->send_v128u( static_cast<uint64_t>(size) );
-#ifdef _WIN32
-#else
-    if( write(this->child_stdin, val, size) != static_cast<ssize_t>(size) )
-        BUG(m_parent_span, "Error writing to child, " << strerror(errno));
-#endif
+    m_request.append(static_cast<const char*>(val), size);
 }
 void ProcMacroInv::send_v128u(uint64_t val)
 {
@@ -920,44 +1060,17 @@ void ProcMacroInv::send_v128u(uint64_t val)
 }
 uint8_t ProcMacroInv::recv_u8()
 {
-    uint8_t v;
-#ifdef _WIN32
-    DWORD n;
-    if( !ReadFile(this->child_stdout, &v, 1, &n, nullptr) )
-        BUG(this->m_parent_span, "Unexpected EOF while reading from child process");
-#else
-    if( read(this->child_stdout, &v, 1) != 1 )
-        BUG(this->m_parent_span, "Unexpected EOF while reading from child process");
-#endif
-    return v;
+    if( m_response_pos == m_response.size() )
+        BUG(this->m_parent_span, "Unexpected end of response from child process");
+    return static_cast<uint8_t>(m_response[m_response_pos++]);
 }
 ::std::string ProcMacroInv::recv_bytes()
 {
     auto len = this->recv_v128u();
-    ASSERT_BUG(this->m_parent_span, len < SIZE_MAX, "Oversized string from child process");
-    ::std::string   val;
-    val.resize(len);
-    size_t  ofs = 0, rem = len;
-    while( rem > 0 )
-    {
-#ifdef _WIN32
-        DWORD n;
-        ReadFile(this->child_stdout, &val[ofs], rem, &n, nullptr);
-#else
-        auto n = read(this->child_stdout, &val[ofs], rem);
-#endif
-        if( n == 0 ) {
-            BUG(this->m_parent_span, "Unexpected EOF while reading from child process");
-        }
-        if( n < 0 ) {
-            BUG(this->m_parent_span, "Error while reading from child process");
-        }
-        assert(static_cast<size_t>(n) <= rem);
-        ofs += n;
-        rem -= n;
-    }
-
-    return val;
+    ASSERT_BUG(this->m_parent_span, len <= m_response.size() - m_response_pos, "Oversized string from child process");
+    auto rv = m_response.substr(m_response_pos, len);
+    m_response_pos += len;
+    return rv;
 }
 uint64_t ProcMacroInv::recv_v128u()
 {
@@ -966,7 +1079,7 @@ uint64_t ProcMacroInv::recv_v128u()
     for(;;)
     {
         auto b = recv_u8();
-        v |= static_cast<uint64_t>(b) << ofs;
+        v |= static_cast<uint64_t>(b & 0x7F) << ofs;
         if( (b & 0x80) == 0 )
             break;
         ofs += 7;
@@ -22,5 +22,9 @@ void HIR::Crate::post_load_update(const ::std::string& name)
             mac.second->m_source_crate = name;
         }
     }
+
+    // Impls in a loaded crate don't change, so can be indexed now
+    this->build_trait_impl_index();
+    this->build_type_impl_index();
 }
 
@@ -12,7 +12,9 @@
 #include <mir/mir.hpp>
 #include <macro_rules/macro_rules.hpp>
 #include "serialise_lowlevel.hpp"
+#include <hir/visitor.hpp>
 #include <typeinfo>
+#include <chrono>
 
 namespace {
 
@@ -21,16 +23,38 @@ namespace {
     {
     };
 
+    /// Loads a MIR body from the metadata's data section on first use
+    class MirLoader:
+        public ::MIR::FunctionLoader
+    {
+        ::std::shared_ptr< ::HIR::serialise::BlockSource>    m_source;
+        ::HIR::serialise::BlockRef  m_ref;
+        ::std::string   m_crate_name;
+    public:
+        MirLoader(::std::shared_ptr< ::HIR::serialise::BlockSource> source, ::HIR::serialise::BlockRef ref, ::std::string crate_name):
+            m_source(mv$(source)),
+            m_ref(ref),
+            m_crate_name(mv$(crate_name))
+        {}
+        ::MIR::Function* load() override;
+    };
+
     class HirDeserialiser
     {
-        ::std::string m_crate_name;
+        RcString    m_crate_name;
         ::HIR::serialise::Reader&   m_in;
+        ::std::shared_ptr< ::HIR::serialise::BlockSource>    m_block_source;
     public:
-        HirDeserialiser(::HIR::serialise::Reader& in):
+        HirDeserialiser(::HIR::serialise::Reader& in, ::std::string crate_name = ""):
+            m_crate_name(mv$(crate_name)),
             m_in(in)
         {}
+        void set_block_source(::std::shared_ptr< ::HIR::serialise::BlockSource> bs) {
+            m_block_source = mv$(bs);
+        }
 
         ::std::string read_string() { return m_in.read_string(); }
+        RcString read_istring() { return m_in.read_istring(); }
         bool read_bool() { return m_in.read_bool(); }
         size_t deserialise_count() { return m_in.read_count(); }
 
@@ -54,7 +78,7 @@ namespace {
             TRACE_FUNCTION_F("<" << typeid(V).name() << ">");
             size_t n = m_in.read_count();
             ::std::unordered_map< ::std::string, V>   rv;
-            //rv.reserve(n);
+            rv.reserve(n);
             for(size_t i = 0; i < n; i ++)
             {
                 auto s = m_in.read_string();
@@ -64,12 +88,27 @@ namespace {
             return rv;
         }
         template<typename V>
+        ::std::unordered_map< RcString,V> deserialise_istrumap()
+        {
+            TRACE_FUNCTION_F("<" << typeid(V).name() << ">");
+            size_t n = m_in.read_count();
+            ::std::unordered_map< RcString, V>   rv;
+            rv.reserve(n);
+            for(size_t i = 0; i < n; i ++)
+            {
+                auto s = m_in.read_istring();
+                DEBUG("- " << s);
+                rv.insert( ::std::make_pair( mv$(s), D<V>::des(*this) ) );
+            }
+            return rv;
+        }
+        template<typename V>
         ::std::unordered_multimap< ::std::string,V> deserialise_strummap()
         {
             TRACE_FUNCTION_F("<" << typeid(V).name() << ">");
             size_t n = m_in.read_count();
             ::std::unordered_multimap< ::std::string, V>   rv;
-            //rv.reserve(n);
+            rv.reserve(n);
             for(size_t i = 0; i < n; i ++)
             {
                 auto s = m_in.read_string();
@@ -242,6 +281,7 @@ namespace {
                 assert(!m_crate_name.empty());
                 rv.m_source_crate = m_crate_name;
             }
+            rv.build_dispatch();
             return rv;
         }
         ::MacroPatEnt deserialise_macropatent() {
@@ -328,7 +368,12 @@ namespace {
             ::HIR::ExprPtr  rv;
             if( m_in.read_bool() )
             {
-                rv.m_mir = deserialise_mir();
+                ::HIR::serialise::BlockRef  ref;
+                ref.offset = m_in.read_u64c();
+                ref.size = m_in.read_u64c();
+                ref.raw_size = m_in.read_u64c();
+                assert(m_block_source);
+                rv.m_mir = ::MIR::FunctionPointer( new MirLoader(m_block_source, ref, m_crate_name) );
             }
             rv.m_erased_types = deserialise_vec< ::HIR::TypeRef>();
             return rv;
@@ -557,6 +602,7 @@ namespace {
                 deserialise_type(),
                 deserialise_exprptr()
                 };
+            rv.m_inline = static_cast< ::HIR::Function::InlineHint>( m_in.read_tag() );
             return rv;
         }
         ::std::vector< ::std::pair< ::HIR::Pattern, ::HIR::TypeRef> >   deserialise_fcnargs()
@@ -671,6 +717,9 @@ namespace {
     DEF_D( ::std::string,
         return d.read_string(); );
     template<>
+    DEF_D( RcString,
+        return d.read_istring(); );
+    template<>
     DEF_D( bool,
         return d.read_bool(); );
 
@@ -785,8 +834,8 @@ namespace {
     {
         TRACE_FUNCTION;
         // HACK! If the read crate name is empty, replace it with the name we're loaded with
-        auto crate_name = m_in.read_string();
-        auto components = deserialise_vec< ::std::string>();
+        auto crate_name = m_in.read_istring();
+        auto components = deserialise_vec<RcString>();
         if( crate_name == "" && components.size() > 0)
         {
             assert(!m_crate_name.empty());
@@ -1166,8 +1215,8 @@ namespace {
         ::HIR::Module   rv;
 
         // m_traits doesn't need to be serialised
-        rv.m_value_items = deserialise_strumap< ::std::unique_ptr< ::HIR::VisEnt< ::HIR::ValueItem> > >();
-        rv.m_mod_items = deserialise_strumap< ::std::unique_ptr< ::HIR::VisEnt< ::HIR::TypeItem> > >();
+        rv.m_value_items = deserialise_istrumap< ::std::unique_ptr< ::HIR::VisEnt< ::HIR::ValueItem> > >();
+        rv.m_mod_items = deserialise_istrumap< ::std::unique_ptr< ::HIR::VisEnt< ::HIR::TypeItem> > >();
 
         return rv;
     }
@@ -1181,7 +1230,7 @@ namespace {
     {
         ::HIR::Crate    rv;
 
-        this->m_crate_name = m_in.read_string();
+        this->m_crate_name = m_in.read_istring();
         assert(!this->m_crate_name.empty() && "Empty crate name loaded from metadata");
         rv.m_crate_name = this->m_crate_name;
         rv.m_root_module = deserialise_module();
@@ -1227,6 +1276,22 @@ namespace {
 
         return rv;
     }
+
+    ::MIR::Function* MirLoader::load()
+    {
+        TRACE_FUNCTION_F(m_crate_name << " @" << m_ref.offset);
+        try
+        {
+            ::HIR::serialise::Reader    in { m_source->read_block(m_ref) };
+            HirDeserialiser s { in, m_crate_name };
+            return s.deserialise_mir().release();
+        }
+        catch(const ::std::runtime_error& e)
+        {
+            ::std::cerr << "Unable to load MIR from metadata for crate " << m_crate_name << ": " << e.what() << ::std::endl;
+            ::std::abort();
+        }
+    }
 }
 
 ::HIR::CratePtr HIR_Deserialise(const ::std::string& filename, const ::std::string& loaded_name)
@@ -1235,8 +1300,10 @@ namespace {
     {
         ::HIR::serialise::Reader    in{ filename };
         HirDeserialiser  s { in };
+        s.set_block_source( in.get_block_source() );
 
         ::HIR::Crate    rv = s.deserialise_crate();
+        rv.m_content_hash = in.content_hash();
 
         return ::HIR::CratePtr( mv$(rv) );
     }
@@ -1257,3 +1324,39 @@ namespace {
     #endif
 }
 
+
+void HIR_DeserialiseBenchmark(const ::std::string& filename, unsigned int iterations)
+{
+    // Forces every lazily-loaded MIR body to be deserialised
+    struct MirLoadVisitor:
+        public ::HIR::Visitor
+    {
+        void visit_expr(::HIR::ExprPtr& exp) override {
+            if( exp.m_mir )
+                (void)&*exp.m_mir;
+        }
+    };
+
+    double  best = 0, total = 0;
+    for(unsigned int i = 0; i < iterations; i ++)
+    {
+        auto start = ::std::chrono::steady_clock::now();
+        ::HIR::serialise::Reader    in{ filename };
+        HirDeserialiser  s { in };
+        auto bs = in.get_block_source();
+        s.set_block_source( bs );
+        auto crate = s.deserialise_crate();
+        MirLoadVisitor().visit_crate(crate);
+        double secs = ::std::chrono::duration<double>(::std::chrono::steady_clock::now() - start).count();
+
+        double mb = static_cast<double>(in.stream_bytes() + bs->bytes_read()) / (1024*1024);
+        double rate = mb / secs;
+        ::std::cout << "#" << i << ": " << mb << " MiB in " << secs << " s - " << rate << " MiB/s" << ::std::endl;
+        best = ::std::max(best, rate);
+        total += rate;
+    }
+    if( iterations > 0 )
+    {
+        ::std::cout << "Best " << best << " MiB/s, mean " << total / iterations << " MiB/s" << ::std::endl;
+    }
+}
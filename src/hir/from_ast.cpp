@@ -1204,10 +1204,21 @@ namespace {
     }
 
     bool force_emit = false;
+    auto inline_hint = ::HIR::Function::InlineHint::None;
     if( const auto* a = attrs.get("inline") )
     {
-        (void)a;
         force_emit = true;
+        inline_hint = ::HIR::Function::InlineHint::Hint;
+        if( a->has_sub_items() && a->items().size() == 1 )
+        {
+            const auto& v = a->items()[0].name();
+            if( v == "always" )
+                inline_hint = ::HIR::Function::InlineHint::Always;
+            else if( v == "never" )
+                inline_hint = ::HIR::Function::InlineHint::Never;
+            else
+                ERROR(sp, E0000, "Unknown #[inline] option - " << v);
+        }
     }
 
     ::HIR::Linkage  linkage;
@@ -1242,7 +1253,7 @@ namespace {
         linkage.name = p.get_name();
     }
 
-    return ::HIR::Function {
+    ::HIR::Function rv {
         force_emit,
         mv$(linkage),
         receiver,
@@ -1252,6 +1263,8 @@ namespace {
         LowerHIR_Type( f.rettype() ),
         LowerHIR_Expr( f.code() )
         };
+    rv.m_inline = inline_hint;
+    return rv;
 }
 
 void _add_mod_ns_item(::HIR::Module& mod, ::std::string name, bool is_pub,  ::HIR::TypeItem ti) {
@@ -1219,15 +1219,145 @@ const ::HIR::Function& ::HIR::Crate::get_function_by_path(const Span& sp, const
     }
 }
 
+bool ::HIR::TraitImplIndex::Head::operator<(const Head& x) const
+{
+    if( tag != x.tag )  return tag < x.tag;
+    if( core_type != x.core_type )  return core_type < x.core_type;
+    if( !path || !x.path )  return (path == nullptr) > (x.path == nullptr);
+    return *path < *x.path;
+}
+bool ::HIR::TraitImplIndex::Head::get(const ::HIR::TypeRef& ty, Head& out)
+{
+    out = Head { static_cast<unsigned int>(ty.m_data.tag()), 0, nullptr };
+    TU_MATCH_DEF(::HIR::TypeRef::Data, (ty.m_data), (e),
+    (
+        ),
+    (Infer,
+        return false;
+        ),
+    (Generic,
+        return false;
+        ),
+    (ErasedType,
+        return false;
+        ),
+    (Primitive,
+        out.core_type = static_cast<unsigned int>(e);
+        ),
+    (Borrow,
+        out.core_type = static_cast<unsigned int>(e.type);
+        ),
+    (Pointer,
+        out.core_type = static_cast<unsigned int>(e.type);
+        ),
+    (Path,
+        // UFCS paths could resolve to anything
+        if( !e.path.m_data.is_Generic() )
+            return false;
+        out.path = &e.path.m_data.as_Generic().m_path;
+        ),
+    (TraitObject,
+        out.path = &e.m_trait.m_path.m_path;
+        )
+    )
+    return true;
+}
+
+void ::HIR::Crate::build_trait_impl_index()
+{
+    m_trait_impl_index.m_traits.clear();
+    size_t  order = 0;
+    for(const auto& ent : m_trait_impls)
+    {
+        auto& trait = m_trait_impl_index.m_traits[ent.first];
+        const auto& impl = ent.second;
+        TraitImplIndex::Head    head;
+        if( TraitImplIndex::Head::get(impl.m_type, head) )
+            trait.by_head[head].push_back({ order, &impl });
+        else
+            trait.blanket.push_back({ order, &impl });
+        order ++;
+    }
+    m_trait_impl_index.m_populated = true;
+}
+
+void ::HIR::Crate::build_type_impl_index()
+{
+    m_type_impl_index.m_blanket.clear();
+    m_type_impl_index.m_by_head.clear();
+    for(size_t i = 0; i < m_type_impls.size(); i ++)
+    {
+        const auto& impl = m_type_impls[i];
+        TraitImplIndex::Head    head;
+        if( TraitImplIndex::Head::get(impl.m_type, head) )
+            m_type_impl_index.m_by_head[head].push_back({ i, &impl });
+        else
+            m_type_impl_index.m_blanket.push_back({ i, &impl });
+    }
+    m_type_impl_index.m_populated = true;
+}
+
 bool ::HIR::Crate::find_trait_impls(const ::HIR::SimplePath& trait, const ::HIR::TypeRef& type, t_cb_resolve_type ty_res, ::std::function<bool(const ::HIR::TraitImpl&)> callback) const
 {
-    auto its = this->m_trait_impls.equal_range( trait );
-    for( auto it = its.first; it != its.second; ++ it )
+    // Use the index if the head of the desired type is known
+    // - Matches the resolution done at the top level of `matches_type_int`
+    const auto& res_type = (type.m_data.is_Infer() || type.m_data.is_Generic() ? ty_res(type) : type);
+    TraitImplIndex::Head    head;
+    bool use_index = m_trait_impl_index.m_populated;
+    if( use_index && res_type.m_data.is_Generic() )
     {
-        const auto& impl = it->second;
-        if( impl.matches_type(type, ty_res) ) {
-            if( callback(impl) ) {
-                return true;
+        // A generic can only match a generic impl
+    }
+    else if( use_index && TraitImplIndex::Head::get(res_type, head) && !TU_TEST1(res_type.m_data, Path, .binding.is_Unbound()) )
+    {
+    }
+    else
+    {
+        use_index = false;
+    }
+
+    if( use_index )
+    {
+        auto it_t = m_trait_impl_index.m_traits.find(trait);
+        if( it_t != m_trait_impl_index.m_traits.end() )
+        {
+            static const ::std::vector<TraitImplIndex::Ent>   empty;
+            const auto& blanket = it_t->second.blanket;
+            const ::std::vector<TraitImplIndex::Ent>* headed = &empty;
+            if( !res_type.m_data.is_Generic() )
+            {
+                auto it_h = it_t->second.by_head.find(head);
+                if( it_h != it_t->second.by_head.end() )
+                    headed = &it_h->second;
+            }
+            // Merge the two (sorted) lists, so impls are visited in declaration order
+            auto it_b = blanket.begin();
+            auto it_h = headed->begin();
+            while( it_b != blanket.end() || it_h != headed->end() )
+            {
+                const ::HIR::TraitImpl* impl;
+                if( it_h == headed->end() || (it_b != blanket.end() && it_b->order < it_h->order) )
+                    impl = (it_b++)->impl;
+                else
+                    impl = (it_h++)->impl;
+                if( impl->matches_type(type, ty_res) ) {
+                    if( callback(*impl) ) {
+                        return true;
+                    }
+                }
+            }
+        }
+    }
+    else
+    {
+        auto its = this->m_trait_impls.equal_range( trait );
+        for( auto it = its.first; it != its.second; ++ it )
+        {
+            const auto& impl = it->second;
+            if( impl.matches_type(type, ty_res) ) {
+                if( callback(impl) ) {
+                    return true;
+                }
             }
         }
     }
@@ -1261,21 +1391,67 @@ bool ::HIR::Crate::find_auto_trait_impls(const ::HIR::SimplePath& trait, const :
 }
 bool ::HIR::Crate::find_type_impls(const ::HIR::TypeRef& type, t_cb_resolve_type ty_res, ::std::function<bool(const ::HIR::TypeImpl&)> callback) const
 {
-    // TODO: Restrict which crate is searched based on the type.
-    for( const auto& impl : this->m_type_impls )
+    const auto& res_type = (type.m_data.is_Infer() || type.m_data.is_Generic() ? ty_res(type) : type);
+    TraitImplIndex::Head    head;
+    bool has_head = TraitImplIndex::Head::get(res_type, head) && !TU_TEST1(res_type.m_data, Path, .binding.is_Unbound());
+
+    // Inherent impls of a named type (or trait object) can only be in the crate that defines it
+    if( has_head && head.path )
     {
-        if( impl.matches_type(type, ty_res) ) {
-            if( callback(impl) ) {
-                return true;
-            }
-        }
+        const auto& crate_name = head.path->m_crate_name;
+        if( crate_name == m_crate_name )
+            return find_type_impls_local(type, ty_res, callback, &head);
+        auto it = m_ext_crates.find(crate_name);
+        if( it != m_ext_crates.end() )
+            return it->second.m_data->find_type_impls_local(type, ty_res, callback, &head);
     }
+
+    if( find_type_impls_local(type, ty_res, callback, has_head ? &head : nullptr) )
+        return true;
     for( const auto& ec : this->m_ext_crates )
     {
         //DEBUG("- " << ec.first);
-        if( ec.second.m_data->find_type_impls(type, ty_res, callback) ) {
+        if( ec.second.m_data->find_type_impls_local(type, ty_res, callback, has_head ? &head : nullptr) ) {
             return true;
         }
     }
     return false;
 }
+bool ::HIR::Crate::find_type_impls_local(const ::HIR::TypeRef& type, t_cb_resolve_type ty_res, ::std::function<bool(const ::HIR::TypeImpl&)> callback, const TraitImplIndex::Head* head) const
+{
+    if( m_type_impl_index.m_populated && head )
+    {
+        static const ::std::vector<TypeImplIndex::Ent>    empty;
+        const auto& blanket = m_type_impl_index.m_blanket;
+        auto it_bh = m_type_impl_index.m_by_head.find(*head);
+        const auto& headed = (it_bh != m_type_impl_index.m_by_head.end() ? it_bh->second : empty);
+        // Merge the two (sorted) lists, so impls are visited in declaration order
+        auto it_b = blanket.begin();
+        auto it_h = headed.begin();
+        while( it_b != blanket.end() || it_h != headed.end() )
+        {
+            const ::HIR::TypeImpl* impl;
+            if( it_h == headed.end() || (it_b != blanket.end() && it_b->order < it_h->order) )
+                impl = (it_b++)->impl;
+            else
+                impl = (it_h++)->impl;
+            if( impl->matches_type(type, ty_res) ) {
+                if( callback(*impl) ) {
+                    return true;
+                }
+            }
+        }
+    }
+    else
+    {
+        for( const auto& impl : this->m_type_impls )
+        {
+            if( impl.matches_type(type, ty_res) ) {
+                if( callback(impl) ) {
+                    return true;
+                }
+            }
+        }
+    }
+    return false;
+}
@@ -123,6 +123,13 @@ public:
         //PointerConst,
         Box,
     };
+    // `#[inline]` attribute, used by the MIR inliner
+    enum class InlineHint {
+        None,
+        Hint,   // `#[inline]`
+        Always, // `#[inline(always)]`
+        Never,  // `#[inline(never)]`
+    };
 
     typedef ::std::vector< ::std::pair< ::HIR::Pattern, ::HIR::TypeRef> >   args_t;
 
@@ -142,6 +149,8 @@ public:
 
     ExprPtr m_code;
 
+    InlineHint  m_inline = InlineHint::None;
+
     //::HIR::TypeRef make_ty(const Span& sp, const ::HIR::PathParams& params) const;
 };
 
@@ -337,9 +346,10 @@ public:
     ::std::vector< ::HIR::SimplePath>   m_traits;
 
     // Contains all values and functions (including type constructors)
-    ::std::unordered_map< ::std::string, ::std::unique_ptr<VisEnt<ValueItem>> > m_value_items;
+    // NOTE: Keyed by interned strings, so lookups using `SimplePath` components don't rehash the name
+    ::std::unordered_map< RcString, ::std::unique_ptr<VisEnt<ValueItem>> > m_value_items;
     // Contains types, traits, and modules
-    ::std::unordered_map< ::std::string, ::std::unique_ptr<VisEnt<TypeItem>> > m_mod_items;
+    ::std::unordered_map< RcString, ::std::unique_ptr<VisEnt<TypeItem>> > m_mod_items;
 
     Module() {}
     Module(const Module&) = delete;
@@ -465,6 +475,54 @@ public:
     // A list of attributes to hand to the handler
     ::std::vector<::std::string>    attributes;
 };
+/// Index of trait impls by the outermost constructor ("head") of the impl type
+/// - Lets `Crate::find_trait_impls` skip impls that can't match, e.g. `impl From<u8> for String` when looking
+///   for `From<_>` on `Vec<u8>`.
+class TraitImplIndex
+{
+public:
+    struct Head
+    {
+        unsigned int    tag;    // ::HIR::TypeRef::Data::Tag
+        unsigned int    core_type;  // ::HIR::CoreType for primitives, ::HIR::BorrowType for borrows/pointers
+        const ::HIR::SimplePath*    path;   // Struct/enum/union path, or the trait of a trait object
+
+        bool operator<(const Head& x) const;
+
+        /// Get the head of a type, returns false if the type could match types with any head (e.g. a generic)
+        static bool get(const ::HIR::TypeRef& ty, Head& out);
+    };
+    struct Ent
+    {
+        size_t  order;  // Position in `m_trait_impls`, so matches are returned in the same order as a linear search
+        const ::HIR::TraitImpl* impl;
+    };
+    struct Trait
+    {
+        // Impls for generics (or unexpanded associated types), these are candidates for every type
+        ::std::vector<Ent>  blanket;
+        ::std::map<Head, ::std::vector<Ent>>    by_head;
+    };
+
+    bool    m_populated = false;
+    ::std::map< ::HIR::SimplePath, Trait>   m_traits;
+};
+/// Index of inherent impls by the head of the impl type (see `TraitImplIndex`)
+class TypeImplIndex
+{
+public:
+    struct Ent
+    {
+        size_t  order;  // Position in `m_type_impls`
+        const ::HIR::TypeImpl*  impl;
+    };
+
+    bool    m_populated = false;
+    // Impls with a type that doesn't have a known head (not valid for inherent impls, but kept for safety)
+    ::std::vector<Ent>  m_blanket;
+    ::std::map<TraitImplIndex::Head, ::std::vector<Ent>>    m_by_head;
+};
+
 class Crate
 {
 public:
@@ -477,6 +535,10 @@ public:
     /// Impl blocks
     ::std::multimap< ::HIR::SimplePath, ::HIR::TraitImpl > m_trait_impls;
     ::std::multimap< ::HIR::SimplePath, ::HIR::MarkerImpl > m_marker_impls;
+    /// Index over `m_trait_impls` (only built for loaded crates, as the local crate's impls are still being updated)
+    TraitImplIndex  m_trait_impl_index;
+    /// Index over `m_type_impls` (built on load, and for the local crate once the impl types are fully resolved)
+    TypeImplIndex   m_type_impl_index;
 
     /// Macros exported by this crate
     ::std::unordered_map< ::std::string, ::MacroRulesPtr >  m_exported_macros;
@@ -493,9 +555,16 @@ public:
     /// Extra paths for the linker
     ::std::vector<::std::string>    m_link_paths;
 
+    /// Hash recorded in the metadata file this crate was loaded from (zero for the crate being compiled)
+    uint64_t    m_content_hash = 0;
+
     /// Method called to populate runtime state after deserialisation
     /// See hir/crate_post_load.cpp
     void post_load_update(const ::std::string& loaded_name);
+    /// Populate `m_trait_impl_index`, must be re-run if `m_trait_impls` changes
+    void build_trait_impl_index();
+    /// Populate `m_type_impl_index`, must be re-run if the heads of the types in `m_type_impls` change
+    void build_type_impl_index();
 
     const ::HIR::SimplePath& get_lang_item_path(const Span& sp, const char* name) const;
     const ::HIR::SimplePath& get_lang_item_path_opt(const char* name) const;
@@ -531,6 +600,9 @@ public:
     bool find_trait_impls(const ::HIR::SimplePath& path, const ::HIR::TypeRef& type, t_cb_resolve_type ty_res, ::std::function<bool(const ::HIR::TraitImpl&)> callback) const;
     bool find_auto_trait_impls(const ::HIR::SimplePath& path, const ::HIR::TypeRef& type, t_cb_resolve_type ty_res, ::std::function<bool(const ::HIR::MarkerImpl&)> callback) const;
     bool find_type_impls(const ::HIR::TypeRef& type, t_cb_resolve_type ty_res, ::std::function<bool(const ::HIR::TypeImpl&)> callback) const;
+private:
+    /// Search just this crate's inherent impls (using the index if `head` is known)
+    bool find_type_impls_local(const ::HIR::TypeRef& type, t_cb_resolve_type ty_res, ::std::function<bool(const ::HIR::TypeImpl&)> callback, const TraitImplIndex::Head* head) const;
 };
 
 }   // namespace HIR
@@ -17,5 +17,14 @@ namespace AST {
 
 extern void HIR_Dump(::std::ostream& sink, const ::HIR::Crate& crate);
 extern ::HIR::CratePtr  LowerHIR_FromAST(::AST::Crate crate);
-extern void HIR_Serialise(const ::std::string& filename, const ::HIR::Crate& crate);
+/// Compression used for crate metadata (`--metadata-compression`)
+enum class HIR_MetadataCompression
+{
+    None,   // Uncompressed, fastest to write and load
+    Fast,   // zlib level 1
+    Best,   // zlib level 9
+};
+extern void HIR_Serialise(const ::std::string& filename, const ::HIR::Crate& crate, HIR_MetadataCompression compression=HIR_MetadataCompression::Best);
 extern ::HIR::CratePtr HIR_Deserialise(const ::std::string& filename, const ::std::string& loaded_name);
+/// Repeatedly load a metadata file (including all MIR) and report the throughput (`-Z bench-metadata`)
+extern void HIR_DeserialiseBenchmark(const ::std::string& filename, unsigned int iterations);
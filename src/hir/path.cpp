@@ -8,7 +8,7 @@
 #include <hir/path.hpp>
 #include <hir/type.hpp>
 
-::HIR::SimplePath HIR::SimplePath::operator+(const ::std::string& s) const
+::HIR::SimplePath HIR::SimplePath::operator+(const RcString& s) const
 {
     ::HIR::SimplePath ret(m_crate_name);
     ret.m_components = m_components;
@@ -54,18 +54,19 @@ static inline Compare& operator &=(Compare& x, const Compare& y) {
 /// Simple path - Absolute with no generic parameters
 struct SimplePath
 {
-    ::std::string   m_crate_name;
-    ::std::vector< ::std::string>   m_components;
+    // NOTE: Interned, so equality checks are pointer comparisons
+    RcString    m_crate_name;
+    ::std::vector<RcString> m_components;
 
     SimplePath():
         m_crate_name("")
     {
     }
-    SimplePath(::std::string crate):
+    SimplePath(RcString crate):
         m_crate_name( mv$(crate) )
     {
     }
-    SimplePath(::std::string crate, ::std::vector< ::std::string> components):
+    SimplePath(RcString crate, ::std::vector<RcString> components):
         m_crate_name( mv$(crate) ),
         m_components( mv$(components) )
     {
@@ -73,7 +74,7 @@ struct SimplePath
 
     SimplePath clone() const;
 
-    SimplePath operator+(const ::std::string& s) const;
+    SimplePath operator+(const RcString& s) const;
     bool operator==(const SimplePath& x) const {
         return m_crate_name == x.m_crate_name && m_components == x.m_components;
     }
@@ -81,9 +82,7 @@ struct SimplePath
         return !(*this == x);
     }
     bool operator<(const SimplePath& x) const {
-        if( m_crate_name < x.m_crate_name ) return true;
-        if( m_crate_name > x.m_crate_name ) return false;
-        return ( m_components < x.m_components );
+        return ord(x) == OrdLess;
     }
     Ordering ord(const SimplePath& x) const {
         auto rv = ::ord(m_crate_name, x.m_crate_name);
@@ -41,6 +41,16 @@ namespace {
             }
         }
         template<typename V>
+        void serialise_strmap(const ::std::unordered_map< RcString,V>& map)
+        {
+            m_out.write_count(map.size());
+            for(const auto& v : map) {
+                DEBUG("- " << v.first);
+                m_out.write_string(v.first);
+                serialise(v.second);
+            }
+        }
+        template<typename V>
         void serialise_strmap(const ::std::unordered_multimap< ::std::string,V>& map)
         {
             m_out.write_count(map.size());
@@ -387,6 +397,9 @@ namespace {
         void serialise(const ::std::string& v) {
             m_out.write_string(v);
         }
+        void serialise(const RcString& v) {
+            m_out.write_string(v);
+        }
 
         void serialise(const ::MacroRulesPtr& mac)
         {
@@ -486,7 +499,14 @@ namespace {
         {
             m_out.write_bool( (bool)exp.m_mir && save_mir );
             if( exp.m_mir && save_mir ) {
-                serialise(*exp.m_mir);
+                // MIR is stored in the data section, so it's only loaded if used
+                ::HIR::serialise::Writer    body_out;
+                HirSerialiser   s { body_out };
+                s.serialise(*exp.m_mir);
+                auto ref = m_out.write_block( body_out.take_buffer() );
+                m_out.write_u64c(ref.offset);
+                m_out.write_u64c(ref.size);
+                m_out.write_u64c(ref.raw_size);
             }
             serialise_vec( exp.m_erased_types );
         }
@@ -844,6 +864,7 @@ namespace {
             DEBUG("m_args = " << fcn.m_args);
 
             serialise(fcn.m_code, fcn.m_save_code || fcn.m_const);
+            m_out.write_tag( static_cast<int>(fcn.m_inline) );
         }
         void serialise(const ::HIR::Constant& item)
         {
@@ -1007,9 +1028,17 @@ namespace {
     };
 }
 
-void HIR_Serialise(const ::std::string& filename, const ::HIR::Crate& crate)
+void HIR_Serialise(const ::std::string& filename, const ::HIR::Crate& crate, HIR_MetadataCompression compression)
 {
-    ::HIR::serialise::Writer    out { filename };
+    auto codec = ::HIR::serialise::Codec::Deflate;
+    int level = 9;
+    switch(compression)
+    {
+    case HIR_MetadataCompression::None: codec = ::HIR::serialise::Codec::None;  break;
+    case HIR_MetadataCompression::Fast: level = 1;  break;
+    case HIR_MetadataCompression::Best: level = 9;  break;
+    }
+    ::HIR::serialise::Writer    out { filename, codec, level };
     HirSerialiser  s { out };
     s.serialise_crate(crate);
 }
@@ -10,27 +10,75 @@
 #include <zlib.h>
 #include <fstream>
 #include <string.h>   // memcpy
+#include <algorithm>  // min
 #include <common.hpp>
+#include <fnv.hpp>
+#ifndef _WIN32
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <fcntl.h>
+# include <unistd.h>
+#endif
 
 namespace HIR {
 namespace serialise {
 
+namespace {
+    // File header: magic, then the offset and size of the data section (little-endian u64s), then the codec
+    // (padded to 8 bytes), then a hash of the rest of the file
+    // - The (compressed) main stream follows the header, the data section follows the main stream
+    const char FILE_MAGIC[8] = { 'M','R','S','T','H','I','R','5' };
+    const size_t FILE_HEADER_SIZE = 8 + 8 + 8 + 8 + 8;
+    const size_t FILE_HEADER_HASH_OFS = 32;
+
+    const size_t STREAM_BUFFER_SIZE = 64*1024;
+
+    void put_u64(uint8_t* dst, uint64_t v) {
+        for(int i = 0; i < 8; i ++)
+            dst[i] = static_cast<uint8_t>(v >> (i*8));
+    }
+    uint64_t get_u64(const uint8_t* src) {
+        uint64_t rv = 0;
+        for(int i = 0; i < 8; i ++)
+            rv |= static_cast<uint64_t>(src[i]) << (i*8);
+        return rv;
+    }
+}
+
 class WriterInner
 {
     ::std::ofstream m_backing;
+    Codec   m_codec;
+    int     m_level;
     z_stream    m_zstream;
     ::std::vector<unsigned char> m_buffer;
+    // Data section, written after the main stream
+    ::std::vector<uint8_t>  m_data_section;
 
     unsigned int    m_byte_out_count = 0;
     unsigned int    m_byte_in_count = 0;
+    // Hash of everything written after the header
+    Fnv64   m_content_hash;
 public:
-    WriterInner(const ::std::string& filename);
+    WriterInner(const ::std::string& filename, Codec codec, int level);
     ~WriterInner();
     void write(const void* buf, size_t len);
+    BlockRef write_block(const ::std::vector<uint8_t>& data);
+private:
+    void finish_deflate();
+    // Write to the file (after the header)
+    void put(const void* buf, size_t len) {
+        m_content_hash.feed(buf, len);
+        m_backing.write( reinterpret_cast<const char*>(buf), len );
+    }
 };
 
-Writer::Writer(const ::std::string& filename):
-    m_inner( new WriterInner(filename) )
+Writer::Writer(const ::std::string& filename, Codec codec, int level):
+    m_inner( new WriterInner(filename, codec, level) )
+{
+}
+Writer::Writer():
+    m_inner(nullptr)
 {
 }
 Writer::~Writer()
@@ -39,22 +87,49 @@ Writer::~Writer()
 }
 void Writer::write(const void* buf, size_t len)
 {
-    m_inner->write(buf, len);
+    if( m_inner )
+    {
+        m_inner->write(buf, len);
+    }
+    else
+    {
+        const auto* p = reinterpret_cast<const uint8_t*>(buf);
+        m_mem.insert(m_mem.end(), p, p + len);
+    }
+}
+::std::vector<uint8_t> Writer::take_buffer()
+{
+    assert(!m_inner);
+    return mv$(m_mem);
+}
+BlockRef Writer::write_block(const ::std::vector<uint8_t>& data)
+{
+    assert(m_inner);
+    return m_inner->write_block(data);
 }
 
 
-WriterInner::WriterInner(const ::std::string& filename):
+WriterInner::WriterInner(const ::std::string& filename, Codec codec, int level):
     m_backing( filename, ::std::ios_base::out | ::std::ios_base::binary),
+    m_codec(codec),
+    m_level(level),
     m_zstream(),
-    m_buffer( 16*1024 )
-    //m_buffer( 4*1024 )
+    m_buffer( STREAM_BUFFER_SIZE )
 {
+    // Header, the data section location is filled once it's known
+    uint8_t header[FILE_HEADER_SIZE] = {};
+    memcpy(header, FILE_MAGIC, sizeof(FILE_MAGIC));
+    header[24] = static_cast<uint8_t>(codec);
+    m_backing.write(reinterpret_cast<const char*>(header), sizeof(header));
+
+    if( m_codec == Codec::None )
+        return ;
+
     m_zstream.zalloc = Z_NULL;
     m_zstream.zfree = Z_NULL;
     m_zstream.opaque = Z_NULL;
 
-    const int COMPRESSION_LEVEL = Z_BEST_COMPRESSION;
-    int ret = deflateInit(&m_zstream, COMPRESSION_LEVEL);
+    int ret = deflateInit(&m_zstream, m_level);
     if(ret != Z_OK)
         throw ::std::runtime_error("zlib init failure");
 
@@ -62,6 +137,29 @@ WriterInner::WriterInner(const ::std::string& filename):
     m_zstream.next_out = m_buffer.data();
 }
 WriterInner::~WriterInner()
+{
+    if( m_codec == Codec::None )
+    {
+        put(m_buffer.data(), m_byte_in_count);
+    }
+    else
+    {
+        finish_deflate();
+    }
+
+    // Append the data section and update the header
+    uint64_t data_ofs = static_cast<uint64_t>(m_backing.tellp());
+    put(m_data_section.data(), m_data_section.size());
+    uint8_t buf[16];
+    put_u64(buf+0, data_ofs);
+    put_u64(buf+8, m_data_section.size());
+    m_backing.seekp(sizeof(FILE_MAGIC));
+    m_backing.write( reinterpret_cast<const char*>(buf), sizeof(buf) );
+    put_u64(buf, m_content_hash.v);
+    m_backing.seekp(FILE_HEADER_HASH_OFS);
+    m_backing.write( reinterpret_cast<const char*>(buf), 8 );
+}
+void WriterInner::finish_deflate()
 {
     assert( m_zstream.avail_in == 0 );
 
@@ -78,7 +176,7 @@ WriterInner::~WriterInner()
         {
             size_t rem = m_buffer.size() - m_zstream.avail_out;
             m_byte_out_count += rem;
-            m_backing.write( reinterpret_cast<char*>(m_buffer.data()), rem );
+            put(m_buffer.data(), rem);
 
             m_zstream.avail_out = m_buffer.size();
             m_zstream.next_out = m_buffer.data();
@@ -87,8 +185,51 @@ WriterInner::~WriterInner()
     deflateEnd(&m_zstream);
 }
 
+BlockRef WriterInner::write_block(const ::std::vector<uint8_t>& data)
+{
+    BlockRef    rv;
+    rv.offset = m_data_section.size();
+    rv.raw_size = data.size();
+
+    if( m_codec == Codec::None )
+    {
+        m_data_section.insert(m_data_section.end(), data.begin(), data.end());
+        rv.size = data.size();
+        return rv;
+    }
+
+    uLongf  len = compressBound(data.size());
+    m_data_section.resize(rv.offset + len);
+    int ret = compress2(m_data_section.data() + rv.offset, &len, data.data(), data.size(), m_level);
+    if( ret != Z_OK )
+        throw ::std::runtime_error("zlib compress failure");
+    m_data_section.resize(rv.offset + len);
+    rv.size = len;
+    return rv;
+}
+
 void WriterInner::write(const void* buf, size_t len)
 {
+    if( m_codec == Codec::None )
+    {
+        // Uncompressed, `m_byte_in_count` is the used space in `m_buffer`
+        if( m_byte_in_count + len > m_buffer.size() )
+        {
+            put(m_buffer.data(), m_byte_in_count);
+            m_byte_in_count = 0;
+        }
+        if( len >= m_buffer.size() )
+        {
+            put(buf, len);
+        }
+        else
+        {
+            memcpy(m_buffer.data() + m_byte_in_count, buf, len);
+            m_byte_in_count += len;
+        }
+        return ;
+    }
+
     m_zstream.avail_in = len;
     m_zstream.next_in = reinterpret_cast<unsigned char*>( const_cast<void*>(buf) );
 
@@ -113,7 +254,7 @@ void WriterInner::write(const void* buf, size_t len)
         if( m_zstream.avail_in > 0 )
         {
             size_t bytes = m_buffer.size() - m_zstream.avail_out;
-            m_backing.write( reinterpret_cast<char*>(m_buffer.data()), bytes );
+            put(m_buffer.data(), bytes);
             m_byte_out_count += bytes;
 
             m_zstream.avail_out = m_buffer.size();
@@ -125,7 +266,7 @@ void WriterInner::write(const void* buf, size_t len)
     while( m_zstream.avail_out == 0 )
     {
         size_t bytes = m_buffer.size() - m_zstream.avail_out;
-        m_backing.write( reinterpret_cast<char*>(m_buffer.data()), bytes );
+        put(m_buffer.data(), bytes);
         m_byte_out_count += bytes;
 
         m_zstream.avail_out = m_buffer.size();
@@ -141,16 +282,28 @@ void WriterInner::write(const void* buf, size_t len)
 // --------------------------------------------------------------------
 class ReaderInner
 {
+    ::std::string   m_filename;
     ::std::ifstream m_backing;
+    Codec   m_codec;
     z_stream    m_zstream;
     ::std::vector<unsigned char> m_buffer;
 
-    unsigned int    m_byte_out_count = 0;
-    unsigned int    m_byte_in_count = 0;
+    // Bytes of the main stream not yet read from the file
+    uint64_t    m_stream_remaining;
+    uint64_t    m_data_ofs;
+    uint64_t    m_data_size;
+    uint64_t    m_content_hash;
+    ::std::shared_ptr<BlockSource>  m_block_source;
+
+    uint64_t    m_byte_out_count = 0;
+    uint64_t    m_byte_in_count = 0;
 public:
     ReaderInner(const ::std::string& filename);
     ~ReaderInner();
     size_t read(void* buf, size_t len);
+    ::std::shared_ptr<BlockSource> get_block_source();
+    uint64_t stream_bytes() const { return m_byte_out_count; }
+    uint64_t content_hash() const { return m_content_hash; }
 };
 
 
@@ -159,6 +312,11 @@ ReadBuffer::ReadBuffer(size_t cap):
 {
     m_backing.reserve(cap);
 }
+ReadBuffer::ReadBuffer(::std::vector<uint8_t> data):
+    m_backing(mv$(data)),
+    m_ofs(0)
+{
+}
 size_t ReadBuffer::read(void* dst, size_t len)
 {
     size_t rem = m_backing.size() - m_ofs;
@@ -186,13 +344,33 @@ void ReadBuffer::populate(ReaderInner& is)
 
 Reader::Reader(const ::std::string& filename):
     m_inner( new ReaderInner(filename) ),
-    m_buffer(1024)
+    m_buffer(STREAM_BUFFER_SIZE)
+{
+}
+Reader::Reader(::std::vector<uint8_t> data):
+    m_inner(nullptr),
+    m_buffer( mv$(data) )
 {
 }
 Reader::~Reader()
 {
     delete m_inner, m_inner = nullptr;
 }
+::std::shared_ptr<BlockSource> Reader::get_block_source()
+{
+    assert(m_inner);
+    return m_inner->get_block_source();
+}
+
+uint64_t Reader::stream_bytes() const
+{
+    return m_inner ? m_inner->stream_bytes() : 0;
+}
+uint64_t Reader::content_hash() const
+{
+    assert(m_inner);
+    return m_inner->content_hash();
+}
 
 void Reader::read(void* buf, size_t len)
 {
@@ -202,6 +380,8 @@ void Reader::read(void* buf, size_t len)
     }
     buf = reinterpret_cast<uint8_t*>(buf) + used;
     len -= used;
+    if( !m_inner )
+        throw ::std::runtime_error( FMT("Reader::read - Ran out of data in memory buffer (" << len << " bytes short)") );
 
     if( len >= m_buffer.capacity() )
     {
@@ -218,13 +398,35 @@ void Reader::read(void* buf, size_t len)
 
 
 ReaderInner::ReaderInner(const ::std::string& filename):
+    m_filename(filename),
     m_backing(filename, ::std::ios_base::in|::std::ios_base::binary),
     m_zstream(),
-    m_buffer(16*1024)
+    m_buffer(STREAM_BUFFER_SIZE)
 {
     if( !m_backing.is_open() )
         throw ::std::runtime_error("Unable to open file");
 
+    uint8_t header[FILE_HEADER_SIZE];
+    m_backing.read(reinterpret_cast<char*>(header), sizeof(header));
+    if( m_backing.gcount() != sizeof(header) || memcmp(header, FILE_MAGIC, sizeof(FILE_MAGIC)) != 0 )
+        throw ::std::runtime_error("Not a metadata file, or from an incompatible compiler version");
+    m_data_ofs = get_u64(header + 8);
+    m_data_size = get_u64(header + 16);
+    m_codec = static_cast<Codec>(header[24]);
+    m_content_hash = get_u64(header + FILE_HEADER_HASH_OFS);
+    if( m_data_ofs < FILE_HEADER_SIZE )
+        throw ::std::runtime_error("Corrupted metadata header");
+    m_stream_remaining = m_data_ofs - FILE_HEADER_SIZE;
+    switch(m_codec)
+    {
+    case Codec::None:
+        return ;
+    case Codec::Deflate:
+        break;
+    default:
+        throw ::std::runtime_error(FMT("Unknown metadata codec " << static_cast<unsigned>(header[24])));
+    }
+
     m_zstream.zalloc = Z_NULL;
     m_zstream.zfree = Z_NULL;
     m_zstream.opaque = Z_NULL;
@@ -237,18 +439,39 @@ ReaderInner::ReaderInner(const ::std::string& filename):
 }
 ReaderInner::~ReaderInner()
 {
-    inflateEnd(&m_zstream);
+    if( m_codec != Codec::None )
+        inflateEnd(&m_zstream);
+}
+::std::shared_ptr<BlockSource> ReaderInner::get_block_source()
+{
+    if( !m_block_source )
+    {
+        m_block_source = ::std::make_shared<BlockSource>(m_filename, m_codec, m_data_ofs, m_data_size);
+    }
+    return m_block_source;
 }
 size_t ReaderInner::read(void* buf, size_t len)
 {
+    if( m_codec == Codec::None )
+    {
+        if( len > m_stream_remaining )
+            len = m_stream_remaining;
+        m_backing.read( reinterpret_cast<char*>(buf), len );
+        len = m_backing.gcount();
+        m_stream_remaining -= len;
+        m_byte_out_count += len;
+        return len;
+    }
+
     m_zstream.avail_out = len;
     m_zstream.next_out = reinterpret_cast<unsigned char*>(buf);
     do {
         // Reset input buffer if empty
         if( m_zstream.avail_in == 0 )
         {
-            m_backing.read( reinterpret_cast<char*>(m_buffer.data()), m_buffer.size() );
+            m_backing.read( reinterpret_cast<char*>(m_buffer.data()), ::std::min<uint64_t>(m_buffer.size(), m_stream_remaining) );
             m_zstream.avail_in = m_backing.gcount();
+            m_stream_remaining -= m_zstream.avail_in;
             if( m_zstream.avail_in == 0 ) {
                 m_byte_out_count += len  - m_zstream.avail_out;
                 //::std::cerr << "Out of bytes, " << m_zstream.avail_out << " needed" << ::std::endl;
@@ -269,6 +492,10 @@ size_t ReaderInner::read(void* buf, size_t len)
         case Z_DATA_ERROR:
         case Z_MEM_ERROR:
             throw ::std::runtime_error("zlib inflate error");
+        case Z_STREAM_END:
+            // End of the main stream (the data section follows)
+            m_byte_out_count += len - m_zstream.avail_out;
+            return len - m_zstream.avail_out;
         default:
             break;
         }
@@ -279,5 +506,71 @@ size_t ReaderInner::read(void* buf, size_t len)
     return len;
 }
 
+// --------------------------------------------------------------------
+BlockSource::BlockSource(const ::std::string& filename, Codec codec, uint64_t ofs, uint64_t size):
+    m_base(nullptr),
+    m_size(size),
+    m_codec(codec),
+    m_bytes_read(0),
+    m_map(nullptr),
+    m_map_size(0)
+{
+    if( size == 0 )
+        return ;
+#ifndef _WIN32
+    int fd = open(filename.c_str(), O_RDONLY);
+    if( fd >= 0 )
+    {
+        struct stat st;
+        if( fstat(fd, &st) == 0 && static_cast<uint64_t>(st.st_size) >= ofs + size )
+        {
+            void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if( p != MAP_FAILED )
+            {
+                m_map = p;
+                m_map_size = st.st_size;
+                m_base = static_cast<const uint8_t*>(p) + ofs;
+            }
+        }
+        close(fd);
+    }
+    if( m_base )
+        return ;
+#endif
+    // Fallback: Read the whole section into memory
+    ::std::ifstream is(filename, ::std::ios_base::in|::std::ios_base::binary);
+    is.seekg(ofs);
+    m_fallback.resize(size);
+    is.read(reinterpret_cast<char*>(m_fallback.data()), size);
+    if( static_cast<uint64_t>(is.gcount()) != size )
+        throw ::std::runtime_error("Truncated metadata file");
+    m_base = m_fallback.data();
+}
+BlockSource::~BlockSource()
+{
+#ifndef _WIN32
+    if( m_map )
+        munmap(m_map, m_map_size);
+#endif
+}
+::std::vector<uint8_t> BlockSource::read_block(const BlockRef& r) const
+{
+    if( r.offset + r.size > m_size )
+        throw ::std::runtime_error("Block out of range of the data section");
+    m_bytes_read += r.raw_size;
+    if( m_codec == Codec::None )
+    {
+        if( r.size != r.raw_size )
+            throw ::std::runtime_error("Block size mismatch in uncompressed metadata");
+        return ::std::vector<uint8_t>(m_base + r.offset, m_base + r.offset + r.size);
+    }
+    ::std::vector<uint8_t>  rv(r.raw_size);
+    uLongf  len = r.raw_size;
+    int ret = uncompress(rv.data(), &len, m_base + r.offset, r.size);
+    if( ret != Z_OK || len != r.raw_size )
+        throw ::std::runtime_error("zlib uncompress failure");
+    return rv;
+}
+
 }   // namespace serialise
 }   // namespace HIR
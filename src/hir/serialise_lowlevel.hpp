@@ -9,7 +9,12 @@
 
 #include <vector>
 #include <string>
+#include <memory>
+#include <unordered_map>
+#include <stdexcept>
+#include <rc_string.hpp>
 #include <stddef.h>
+#include <stdint.h>
 #include <assert.h>
 
 namespace HIR {
@@ -18,17 +23,70 @@ namespace serialise {
 class WriterInner;
 class ReaderInner;
 
+/// Compression used for a metadata file (recorded in the file header)
+enum class Codec : uint8_t
+{
+    None = 0,
+    Deflate = 1,
+};
+
+/// Strings shorter than this are written once per stream and then referred to by index (see `Writer::write_string`)
+const size_t STRING_TABLE_MAX_LEN = 128;
+
+/// Location of a block in the data section of a metadata file
+/// - Blocks are compressed individually, so can be loaded on demand (e.g. MIR bodies)
+struct BlockRef
+{
+    uint64_t    offset; // Relative to the start of the data section
+    uint64_t    size;   // Stored (compressed) size
+    uint64_t    raw_size;   // Decompressed size
+};
+
+/// Random-access view of the data section of a metadata file (memory-mapped where supported)
+class BlockSource
+{
+    const uint8_t*  m_base;
+    uint64_t    m_size;
+    Codec   m_codec;
+    // Total decompressed size of blocks read (for benchmarking)
+    mutable uint64_t    m_bytes_read;
+
+    void*   m_map;
+    size_t  m_map_size;
+    ::std::vector<uint8_t>  m_fallback;
+public:
+    BlockSource(const ::std::string& path, Codec codec, uint64_t ofs, uint64_t size);
+    BlockSource(const BlockSource&) = delete;
+    ~BlockSource();
+
+    /// Decompress a block
+    ::std::vector<uint8_t> read_block(const BlockRef& r) const;
+    uint64_t bytes_read() const { return m_bytes_read; }
+};
+
 class Writer
 {
     WriterInner*    m_inner;
+    // Output buffer when writing to memory (`m_inner` is null)
+    ::std::vector<uint8_t>  m_mem;
+    // Strings already written to this stream, and their index in the reader's table
+    ::std::unordered_map< ::std::string, size_t>    m_strings;
 public:
-    Writer(const ::std::string& path);
+    /// Write to a file, `level` is the zlib compression level (for Codec::Deflate)
+    Writer(const ::std::string& path, Codec codec=Codec::Deflate, int level=9);
+    /// Write to memory, the result is obtained with `take_buffer`
+    Writer();
     Writer(const Writer&) = delete;
     Writer(Writer&&) = delete;
     ~Writer();
 
     void write(const void* data, size_t count);
 
+    /// Get the data written to an in-memory writer
+    ::std::vector<uint8_t> take_buffer();
+    /// Compress and append a block to the file's data section, returning its location
+    BlockRef write_block(const ::std::vector<uint8_t>& data);
+
     void write_u8(uint8_t v) {
         write(reinterpret_cast<const char*>(&v), 1);
     }
@@ -114,7 +172,24 @@ public:
             write_u16( static_cast<uint16_t>(c) );
         }
     }
+    // Strings (identifiers, path components, crate names) are interned per stream
+    // - A reference to an already-written string is its table index plus one
+    // - Otherwise a zero is written, followed by the string itself (which the reader then appends to its table)
     void write_string(const ::std::string& v) {
+        if( v.size() < STRING_TABLE_MAX_LEN )
+        {
+            auto it = m_strings.find(v);
+            if( it != m_strings.end() ) {
+                write_u64c(it->second + 1);
+                return ;
+            }
+            size_t idx = m_strings.size();
+            m_strings.insert( ::std::make_pair(v, idx) );
+        }
+        write_u64c(0);
+        write_string_raw(v);
+    }
+    void write_string_raw(const ::std::string& v) {
         if(v.size() < 128) {
             write_u8( static_cast<uint8_t>(v.size()) );
         }
@@ -134,9 +209,10 @@ public:
 class ReadBuffer
 {
     ::std::vector<uint8_t>  m_backing;
-    unsigned int    m_ofs;
+    size_t  m_ofs;
 public:
     ReadBuffer(size_t size);
+    ReadBuffer(::std::vector<uint8_t> data);
 
     size_t capacity() const { return m_backing.capacity(); }
     size_t read(void* dst, size_t len);
@@ -147,14 +223,25 @@ class Reader
 {
     ReaderInner*    m_inner;
     ReadBuffer  m_buffer;
+    // Strings seen so far in this stream (interned), see `Writer::write_string`
+    ::std::vector<RcString> m_strings;
 public:
     Reader(const ::std::string& path);
+    /// Read from an in-memory buffer (e.g. a block from `BlockSource::read_block`)
+    Reader(::std::vector<uint8_t> data);
     Reader(const Writer&) = delete;
     Reader(Writer&&) = delete;
     ~Reader();
 
     void read(void* dst, size_t count);
 
+    /// Get the data section of the file (shared, so lazily-loaded items can keep it alive)
+    ::std::shared_ptr<BlockSource> get_block_source();
+    /// Number of (decompressed) bytes read from the main stream
+    uint64_t stream_bytes() const;
+    /// Hash of the file contents, recorded when it was written (identifies this build of the crate)
+    uint64_t content_hash() const;
+
     uint8_t read_u8() {
         uint8_t v;
         read(&v, sizeof v);
@@ -250,6 +337,32 @@ public:
         }
     }
     ::std::string read_string() {
+        auto idx = read_u64c();
+        if( idx > 0 ) {
+            return get_table_string(idx).str();
+        }
+        auto rv = read_string_raw();
+        if( rv.size() < STRING_TABLE_MAX_LEN )
+            m_strings.push_back( RcString(rv) );
+        return rv;
+    }
+    /// Read a string as an interned string (only interns once per stream for repeated strings)
+    RcString read_istring() {
+        auto idx = read_u64c();
+        if( idx > 0 ) {
+            return get_table_string(idx);
+        }
+        RcString    rv = read_string_raw();
+        if( rv.size() < STRING_TABLE_MAX_LEN )
+            m_strings.push_back(rv);
+        return rv;
+    }
+    const RcString& get_table_string(uint64_t idx) const {
+        if( idx > m_strings.size() )
+            throw ::std::runtime_error("Reader::read_string - String index out of range");
+        return m_strings[idx-1];
+    }
+    ::std::string read_string_raw() {
         size_t len = read_u8();
         if( len < 128 ) {
         }
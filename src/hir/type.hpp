@@ -221,8 +221,12 @@ public:
         m_data( Data::make_Primitive(mv$(ct)) )
     {}
     TypeRef(::HIR::Path p, TypePathBinding pb=TypePathBinding()):
-        m_data( Data::make_Path( {mv$(p), mv$(pb)} ) )
-    {}
+        m_data( Data::make_Path( {::HIR::Path(::HIR::GenericPath()), TypePathBinding()} ) )
+    {
+        // NOTE: Assigned after construction, moving `p` through the temporary `Data_Path` trips -Wmaybe-uninitialized
+        m_data.as_Path().path = mv$(p);
+        m_data.as_Path().binding = mv$(pb);
+    }
 
     static TypeRef new_unit() {
         return TypeRef(Data::make_Tuple({}));
@@ -250,7 +254,7 @@ public:
         return TypeRef(Data::make_Array({box$(mv$(inner)), ::std::shared_ptr< ::HIR::ExprPtr>( new ::HIR::ExprPtr(mv$(size_expr)) ), ~0u}));
     }
     static TypeRef new_path(::HIR::Path path, TypePathBinding binding) {
-        return TypeRef(Data::make_Path({ mv$(path), mv$(binding) }));
+        return TypeRef(mv$(path), mv$(binding));
     }
     static TypeRef new_closure(::HIR::ExprNode_Closure* node_ptr, ::std::vector< ::HIR::TypeRef> args, ::HIR::TypeRef rv) {
         return TypeRef(Data::make_Closure({ node_ptr, box$(mv$(rv)), mv$(args) }));
@@ -3,6 +3,7 @@
 #include <hir/hir.hpp>
 #include <hir/expr.hpp>
 #include <hir/visitor.hpp>
+#include <thread_pool.hpp>
 #include "expr_visit.hpp"
 
 namespace {
@@ -17,6 +18,10 @@ namespace {
     {
         ::typeck::ModuleState m_ms;
     public:
+        /// Deferred typecheck of item bodies (run once the crate has been walked)
+        /// - Each job captures a copy of the module state (generics and in-scope traits)
+        ::std::vector< ::std::function<void()> >    m_jobs;
+
         OuterVisitor(::HIR::Crate& crate):
             m_ms(crate)
         {
@@ -97,7 +102,9 @@ namespace {
             if( item.m_code )
             {
                 DEBUG("Function code " << p);
-                Typecheck_Code( m_ms, item.m_args, item.m_return, item.m_code );
+                m_jobs.push_back([ms=m_ms, &item]() {
+                    Typecheck_Code( ms, item.m_args, item.m_return, item.m_code );
+                    });
             }
             else
             {
@@ -109,8 +116,10 @@ namespace {
             if( item.m_value )
             {
                 DEBUG("Static value " << p);
-                t_args  tmp;
-                Typecheck_Code(m_ms, tmp, item.m_type, item.m_value);
+                m_jobs.push_back([ms=m_ms, &item]() {
+                    t_args  tmp;
+                    Typecheck_Code(ms, tmp, item.m_type, item.m_value);
+                    });
             }
         }
         void visit_constant(::HIR::ItemPath p, ::HIR::Constant& item) override {
@@ -118,8 +127,10 @@ namespace {
             if( item.m_value )
             {
                 DEBUG("Const value " << p);
-                t_args  tmp;
-                Typecheck_Code(m_ms, tmp, item.m_type, item.m_value);
+                m_jobs.push_back([ms=m_ms, &item]() {
+                    t_args  tmp;
+                    Typecheck_Code(ms, tmp, item.m_type, item.m_value);
+                    });
             }
         }
         void visit_enum(::HIR::ItemPath p, ::HIR::Enum& item) override {
@@ -127,16 +138,17 @@ namespace {
 
             if( auto* e = item.m_data.opt_Value() )
             {
-                // TODO: Use a different type depding on repr()
-                auto enum_type = ::HIR::TypeRef(::HIR::CoreType::Isize);
-
                 for(auto& var : e->variants)
                 {
                     DEBUG("Enum value " << p << " - " << var.name);
                     if( var.expr )
                     {
-                        t_args  tmp;
-                        Typecheck_Code(m_ms, tmp, enum_type, var.expr);
+                        m_jobs.push_back([ms=m_ms, &var]() {
+                            // TODO: Use a different type depding on repr()
+                            auto enum_type = ::HIR::TypeRef(::HIR::CoreType::Isize);
+                            t_args  tmp;
+                            Typecheck_Code(ms, tmp, enum_type, var.expr);
+                            });
                     }
                 }
             }
@@ -148,4 +160,12 @@ void Typecheck_Expressions(::HIR::Crate& crate)
 {
     OuterVisitor    visitor { crate };
     visitor.visit_crate( crate );
+
+    // Each body has its own inference context and only reads shared crate state, so they can be checked in parallel.
+    // - Results are written back into the body itself, so the output doesn't depend on the order of completion.
+    auto jobs = mv$(visitor.m_jobs);
+    DEBUG(jobs.size() << " bodies to check");
+    ThreadPool_Run(jobs.size(), [&](size_t i) {
+        jobs[i]();
+        });
 }
@@ -6,6 +6,12 @@
  * - Typecheck helpers
  */
 #include "helpers.hpp"
+#include <mutex>
+
+namespace {
+    /// Guards the (shared) `TraitMarkings::auto_impls` caches against concurrent typecheck workers
+    ::std::mutex    g_auto_impls_lock;
+}
 
 // --------------------------------------------------------------------
 // HMTypeInferrence
@@ -2348,7 +2354,8 @@ bool TraitResolution::find_trait_impls_crate(const Span& sp,
     if( m_crate.get_trait_by_path(sp, trait).m_is_marker )
     {
         // Detect recursion and return true if detected
-        static ::std::vector< ::std::tuple< const ::HIR::SimplePath*, const ::HIR::PathParams*, const ::HIR::TypeRef*> >    stack;
+        // - Per-thread, as typecheck can run on multiple workers
+        static thread_local ::std::vector< ::std::tuple< const ::HIR::SimplePath*, const ::HIR::PathParams*, const ::HIR::TypeRef*> >    stack;
         for(const auto& ent : stack ) {
             if( *::std::get<0>(ent) != trait )
                 continue ;
@@ -2397,13 +2404,23 @@ bool TraitResolution::find_trait_impls_crate(const Span& sp,
         // - Cache populated after destructure
         if( markings )
         {
-            auto it = markings->auto_impls.find( trait );
-            if( it != markings->auto_impls.end() )
+            bool is_cached = false;
+            bool is_impled = false;
             {
-                if( ! it->second.conditions.empty() ) {
-                    TODO(sp, "Conditional auto trait impl");
+                ::std::lock_guard< ::std::mutex>    lh { g_auto_impls_lock };
+                auto it = markings->auto_impls.find( trait );
+                if( it != markings->auto_impls.end() )
+                {
+                    if( ! it->second.conditions.empty() ) {
+                        TODO(sp, "Conditional auto trait impl");
+                    }
+                    is_cached = true;
+                    is_impled = it->second.is_impled;
                 }
-                else if( it->second.is_impled ) {
+            }
+            if( is_cached )
+            {
+                if( is_impled ) {
                     return callback( ImplRef(&type, params_ptr, &null_assoc), ::HIR::Compare::Equal );
                 }
                 else {
@@ -2487,6 +2504,7 @@ bool TraitResolution::find_trait_impls_crate(const Span& sp,
         {
             if( markings ) {
                 ASSERT_BUG(sp, cmp == ::HIR::Compare::Equal, "Auto trait with no params returned a fuzzy match from destructure");
+                ::std::lock_guard< ::std::mutex>    lh { g_auto_impls_lock };
                 markings->auto_impls.insert( ::std::make_pair(trait, ::HIR::TraitMarkings::AutoMarking { {}, true }) );
             }
             return callback( ImplRef(&type, params_ptr, &null_assoc), cmp );
@@ -2494,6 +2512,7 @@ bool TraitResolution::find_trait_impls_crate(const Span& sp,
         else
         {
             if( markings ) {
+                ::std::lock_guard< ::std::mutex>    lh { g_auto_impls_lock };
                 markings->auto_impls.insert( ::std::make_pair(trait, ::HIR::TraitMarkings::AutoMarking { {}, false }) );
             }
             return false;
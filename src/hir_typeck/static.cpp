@@ -7,6 +7,13 @@
  */
 #include "static.hpp"
 #include <algorithm>
+#include <atomic>
+
+namespace {
+    // Totals for `StaticTraitResolve::m_impl_cache`, over all instances (and threads)
+    ::std::atomic<unsigned long long>   g_impl_cache_hits { 0 };
+    ::std::atomic<unsigned long long>   g_impl_cache_misses { 0 };
+}
 
 void StaticTraitResolve::prep_indexes()
 {
@@ -16,6 +23,7 @@ void StaticTraitResolve::prep_indexes()
     TRACE_FUNCTION_F("");
 
     m_copy_cache.clear();
+    m_impl_cache.clear();
 
     auto add_equality = [&](::HIR::TypeRef long_ty, ::HIR::TypeRef short_ty){
         DEBUG("[prep_indexes] ADD " << long_ty << " => " << short_ty);
@@ -369,7 +377,8 @@ bool StaticTraitResolve::find_impl(
             return rv;
 
         // Detect recursion and return true if detected
-        static ::std::vector< ::std::tuple< const ::HIR::SimplePath*, const ::HIR::PathParams*, const ::HIR::TypeRef*> >    stack;
+        // - Per-thread, as MIR passes can run on multiple workers
+        static thread_local ::std::vector< ::std::tuple< const ::HIR::SimplePath*, const ::HIR::PathParams*, const ::HIR::TypeRef*> >    stack;
         for(const auto& ent : stack ) {
             if( *::std::get<0>(ent) != trait_path )
                 continue ;
@@ -393,15 +402,100 @@ bool StaticTraitResolve::find_impl(
     }
     else
     {
-        // Search the crate for impls
-        ret = m_crate.find_trait_impls(trait_path, type, cb_ident, [&](const auto& impl) {
+        return this->find_impl__search_crate(sp, trait_path, trait_params, type, found_cb);
+    }
+}
+
+bool StaticTraitResolve::find_impl__search_crate(
+        const Span& sp,
+        const ::HIR::SimplePath& trait_path, const ::HIR::PathParams* trait_params,
+        const ::HIR::TypeRef& type,
+        t_cb_find_impl found_cb
+    ) const
+{
+    auto cb_ident = [](const ::HIR::TypeRef&ty)->const ::HIR::TypeRef& { return ty; };
+
+    // Queries involving inference variables or impl placeholders can't be cached (they're specific to one query)
+    auto is_uncachable = [](const ::HIR::TypeRef& ty)->bool {
+        return visit_ty_with(ty, [](const ::HIR::TypeRef& t) {
+            return t.m_data.is_Infer() || (t.m_data.is_Generic() && t.m_data.as_Generic().is_placeholder());
+            });
+        };
+    bool can_cache = !is_uncachable(type);
+    if( can_cache && trait_params )
+    {
+        for(const auto& ty : trait_params->m_types)
+            if( is_uncachable(ty) )
+                can_cache = false;
+    }
+    if( !can_cache )
+    {
+        return m_crate.find_trait_impls(trait_path, type, cb_ident, [&](const auto& impl) {
             return this->find_impl__check_crate(sp, trait_path, trait_params, type, found_cb,  impl);
             });
-        if(ret)
-            return true;
+    }
 
-        return false;
+    // Impl bounds can depend on the generics in scope, so discard the cache if they've changed
+    if( m_impl_cache_scope[0] != m_impl_generics || m_impl_cache_scope[1] != m_item_generics )
+    {
+        m_impl_cache.clear();
+        m_impl_cache_scope[0] = m_impl_generics;
+        m_impl_cache_scope[1] = m_item_generics;
+    }
+
+    ImplCacheKey    key { trait_path.clone(), trait_params != nullptr, trait_params ? trait_params->clone() : ::HIR::PathParams(), type.clone() };
+    // Impls already offered to `found_cb` (from a partial cache entry)
+    ::std::vector<const ::HIR::TraitImpl*>  matched;
+    auto it = m_impl_cache.find(key);
+    if( it != m_impl_cache.end() )
+    {
+        g_impl_cache_hits ++;
+        DEBUG("Cached - " << it->second.impls.size() << " impls" << (it->second.complete ? "" : " (partial)"));
+        // Re-check the impls to get fresh ImplRefs (they point into the query types)
+        for(const auto* impl : it->second.impls)
+        {
+            if( this->find_impl__check_crate(sp, trait_path, trait_params, type, found_cb,  *impl) )
+                return true;
+        }
+        if( it->second.complete )
+            return false;
+        // The search that populated this entry stopped early, continue it (skipping the impls already checked)
+        matched = it->second.impls;
     }
+    else
+    {
+        g_impl_cache_misses ++;
+    }
+
+    // Search until `found_cb` accepts an impl, recording all impls that matched
+    size_t  n_checked = matched.size();
+    bool rv = m_crate.find_trait_impls(trait_path, type, cb_ident, [&](const auto& impl) {
+        if( ::std::find(matched.begin(), matched.begin() + n_checked, &impl) != matched.begin() + n_checked )
+            return false;
+        bool is_match = false;
+        bool found = this->find_impl__check_crate(sp, trait_path, trait_params, type, [&](auto ir, bool is_fuzzed) {
+            is_match = true;
+            return found_cb(mv$(ir), is_fuzzed);
+            },  impl);
+        if( is_match )
+            matched.push_back(&impl);
+        return found;
+        });
+    // NOTE: Inserted after the search, as `found_cb` can recurse into this resolver
+    auto& ent = m_impl_cache[mv$(key)];
+    ent.impls = mv$(matched);
+    ent.complete = !rv;
+    return rv;
+}
+
+void StaticTraitResolve::print_cache_stats(::std::ostream& os)
+{
+    auto hits = g_impl_cache_hits.load();
+    auto misses = g_impl_cache_misses.load();
+    os << "Impl lookup cache: " << hits << " hits, " << misses << " misses";
+    if( hits + misses > 0 )
+        os << " (" << (hits * 100 / (hits + misses)) << "% hit rate)";
+    os << ::std::endl;
 }
 
 bool StaticTraitResolve::find_impl__check_bound(
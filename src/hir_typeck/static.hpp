@@ -35,6 +35,33 @@ public:
 private:
     mutable ::std::map< ::HIR::TypeRef, bool >  m_copy_cache;
 
+    /// Key for `m_impl_cache` - a `find_impl` query
+    struct ImplCacheKey
+    {
+        ::HIR::SimplePath   trait;
+        bool    has_params;
+        ::HIR::PathParams   params;
+        ::HIR::TypeRef  type;
+
+        bool operator<(const ImplCacheKey& x) const {
+            Ordering    rv;
+            if( (rv = trait.ord(x.trait)) != OrdEqual ) return rv == OrdLess;
+            if( (rv = ::ord(has_params, x.has_params)) != OrdEqual )    return rv == OrdLess;
+            if( (rv = params.ord(x.params)) != OrdEqual )   return rv == OrdLess;
+            return type.ord(x.type) == OrdLess;
+        }
+    };
+    /// Crate impls that matched a query, in search order
+    struct ImplCacheEnt
+    {
+        ::std::vector<const ::HIR::TraitImpl*>  impls;
+        // False if the search stopped at an accepted impl (so there may be more matching impls)
+        bool    complete;
+    };
+    /// Cache of crate impl searches (only valid for the generics that were in scope when populated)
+    mutable ::std::map< ImplCacheKey, ImplCacheEnt >  m_impl_cache;
+    mutable const ::HIR::GenericParams* m_impl_cache_scope[2] = { nullptr, nullptr };
+
 public:
     StaticTraitResolve(const ::HIR::Crate& crate):
         m_crate(crate),
@@ -52,6 +79,18 @@ public:
         m_lang_PhantomData = m_crate.get_lang_item_path_opt("phantom_data");
         prep_indexes();
     }
+    /// Construct with the generics for a specific item (e.g. when processing an item outside of a visitor)
+    StaticTraitResolve(const ::HIR::Crate& crate, ::HIR::GenericParams* impl_generics, ::HIR::GenericParams* item_generics):
+        StaticTraitResolve(crate)
+    {
+        m_impl_generics = impl_generics;
+        m_item_generics = item_generics;
+        if( m_impl_generics || m_item_generics )
+        {
+            m_type_equalities.clear();
+            prep_indexes();
+        }
+    }
 
 private:
     void prep_indexes();
@@ -134,6 +173,12 @@ private:
         t_cb_find_impl found_cb,
         const ::HIR::TraitImpl& impl
         ) const;
+    bool find_impl__search_crate(
+        const Span& sp,
+        const ::HIR::SimplePath& trait_path, const ::HIR::PathParams* trait_params,
+        const ::HIR::TypeRef& type,
+        t_cb_find_impl found_cb
+        ) const;
     bool find_impl__check_crate_raw(
         const Span& sp,
         const ::HIR::SimplePath& des_trait_path, const ::HIR::PathParams* des_trait_params, const ::HIR::TypeRef& des_type,
@@ -185,6 +230,9 @@ public:
     bool type_needs_drop_glue(const Span& sp, const ::HIR::TypeRef& ty) const;
 
     const ::HIR::TypeRef* is_type_owned_box(const ::HIR::TypeRef& ty) const;
+
+    /// Print the hit/miss counts for the impl lookup cache (summed over all instances)
+    static void print_cache_stats(::std::ostream& os);
     const ::HIR::TypeRef* is_type_phantom_data(const ::HIR::TypeRef& ty) const;
 
 
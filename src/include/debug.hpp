@@ -5,7 +5,7 @@
 #include <cassert>
 #include <functional>
 
-extern int g_debug_indent_level;
+extern thread_local int g_debug_indent_level;
 
 #ifndef DISABLE_DEBUG
 # define INDENT()    do { g_debug_indent_level += 1; assert(g_debug_indent_level<300); } while(0)
@@ -13,7 +13,8 @@ extern int g_debug_indent_level;
 # define DEBUG(ss)   do{ if(debug_enabled()) { debug_output(g_debug_indent_level, __FUNCTION__) << ss << ::std::endl; } } while(0)
 # define TRACE_FUNCTION  TraceLog _tf_(__func__)
 # define TRACE_FUNCTION_F(ss)    TraceLog _tf_(__func__, [&](::std::ostream&__os){ __os << ss; })
-# define TRACE_FUNCTION_FR(ss,ss2)    TraceLog _tf_(__func__, [&](::std::ostream&__os){ __os << ss; }, [&](::std::ostream&__os){ __os << ss2;})
+// NOTE: The return formatter is stored, so needs to be a named local (declared before, so destroyed after, the TraceLog)
+# define TRACE_FUNCTION_FR(ss,ss2)    auto _tf_ret_ = [&](::std::ostream&__os){ __os << ss2;}; TraceLog _tf_(__func__, [&](::std::ostream&__os){ __os << ss; }, _tf_ret_)
 #else
 # define INDENT()    do { } while(0)
 # define UNINDENT()    do {} while(0)
@@ -23,7 +24,11 @@ extern int g_debug_indent_level;
 # define TRACE_FUNCTION_FR(ss,ss2)  do{ if(false) (void)(::NullSink() << ss); if(false) (void)(::NullSink() << ss2); } while(0)
 #endif
 
-extern bool debug_enabled();
+/// Set when debug output is enabled for the current phase (decided once per phase)
+extern bool g_debug_enabled;
+static inline bool debug_enabled() {
+    return g_debug_enabled;
+}
 extern ::std::ostream& debug_output(int indent, const char* function);
 
 struct RepeatLitStr
@@ -48,15 +53,60 @@ public:
     const NullSink& operator<<(const T&) const { return *this;  }
 };
 
+/// Function entry/exit logging (see TRACE_FUNCTION*)
+/// - When debug output is disabled this only costs a flag check: the formatters are never converted to
+///   `std::function` or invoked, and the indent level is left alone.
 class TraceLog
 {
     const char* m_tag;
-    ::std::function<void(::std::ostream&)>  m_ret;
+    bool    m_enabled;
+    // Non-owning reference to the return formatter (if any)
+    const void* m_ret_obj;
+    void (*m_ret_fcn)(const void* , ::std::ostream& );
+
+    template<typename T>
+    static void call_fmt(const void* obj, ::std::ostream& os) {
+        (*static_cast<const T*>(obj))(os);
+    }
+
+    void enter(void (*info_fcn)(const void*, ::std::ostream&), const void* info_obj);
+    void leave();
 public:
-    TraceLog(const char* tag, ::std::function<void(::std::ostream&)> info_cb, ::std::function<void(::std::ostream&)> ret);
-    TraceLog(const char* tag, ::std::function<void(::std::ostream&)> info_cb);
-    TraceLog(const char* tag);
-    ~TraceLog();
+    template<typename Info, typename Ret>
+    TraceLog(const char* tag, const Info& info_cb, const Ret& ret_cb):
+        m_tag(tag),
+        m_enabled(debug_enabled()),
+        m_ret_obj(&ret_cb),
+        m_ret_fcn(&call_fmt<Ret>)
+    {
+        if( m_enabled )
+            enter(&call_fmt<Info>, &info_cb);
+    }
+    template<typename Info>
+    TraceLog(const char* tag, const Info& info_cb):
+        m_tag(tag),
+        m_enabled(debug_enabled()),
+        m_ret_obj(nullptr),
+        m_ret_fcn(nullptr)
+    {
+        if( m_enabled )
+            enter(&call_fmt<Info>, &info_cb);
+    }
+    TraceLog(const char* tag):
+        m_tag(tag),
+        m_enabled(debug_enabled()),
+        m_ret_obj(nullptr),
+        m_ret_fcn(nullptr)
+    {
+        if( m_enabled )
+            enter(nullptr, nullptr);
+    }
+    ~TraceLog() {
+        if( m_enabled )
+            leave();
+    }
+    TraceLog(const TraceLog&) = delete;
+    TraceLog& operator=(const TraceLog&) = delete;
 };
 
 struct FmtLambda
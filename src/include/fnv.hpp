@@ -0,0 +1,56 @@
+/*
+ * MRustC - Rust Compiler
+ * - By John Hodge (Mutabah/thePowersGang)
+ *
+ * include/fnv.hpp
+ * - 64-bit FNV-1a hash
+ */
+#pragma once
+#include <string>
+#include <fstream>
+#include <cstdint>
+#include <cstddef>
+
+/// 64-bit FNV-1a (fast, and stable between runs/hosts)
+///
+/// Used for string interning, metadata content hashes, and the cache/incremental fingerprints.
+struct Fnv64
+{
+    uint64_t    v = 0xcbf29ce484222325ull;
+
+    void feed(const void* data, size_t len) {
+        const auto* p = static_cast<const uint8_t*>(data);
+        for(size_t i = 0; i < len; i ++)
+        {
+            v ^= p[i];
+            v *= 0x100000001b3ull;
+        }
+    }
+    void feed(const ::std::string& s) {
+        feed(s.data(), s.size());
+        // Separator, so adjacent fields can't alias
+        feed("", 1);
+    }
+    /// Hash the contents of a file, returns false if it couldn't be opened
+    bool feed_file(const ::std::string& path) {
+        ::std::ifstream is(path, ::std::ios::binary);
+        if( !is.is_open() )
+            return false;
+        char    buf[64*1024];
+        while( is )
+        {
+            is.read(buf, sizeof(buf));
+            feed(buf, static_cast<size_t>(is.gcount()));
+        }
+        return true;
+    }
+
+    /// Hash as 16 hex digits
+    ::std::string str() const {
+        static const char DIGITS[] = "0123456789abcdef";
+        ::std::string   rv(16, '0');
+        for(int i = 0; i < 16; i ++)
+            rv[15 - i] = DIGITS[(v >> (i*4)) & 0xF];
+        return rv;
+    }
+};
@@ -13,6 +13,8 @@ namespace AST {
 
 /// Parse a crate from the given file
 extern AST::Crate Parse_Crate(::std::string mainfile);
+/// Repeatedly lex every source file of a crate and report the throughput (`-Z bench-lexer`)
+extern void Parse_LexerBenchmark(const ::std::string& mainfile, unsigned int iterations);
 
 
 extern void Expand(::AST::Crate& crate);
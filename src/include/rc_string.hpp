@@ -1,20 +1,43 @@
 /*
+ * MRustC - Rust Compiler
+ * - By John Hodge (Mutabah/thePowersGang)
+ *
+ * include/rc_string.hpp
+ * - Interned (process-wide, immutable) strings
  */
 #pragma once
 
 #include <cstring>
 #include <ostream>
+#include <string>
+#include <functional>   // std::hash
 
+/// Handle to an interned string
+///
+/// Every distinct string is stored once (for the life of the process), so copying a handle is a pointer copy,
+/// equality is a pointer comparison, and the hash is precomputed. Used for identifiers, path components, crate
+/// names and file names - i.e. a bounded set of strings that are copied and compared far more than created.
+///
+/// NOTE: `operator<` is a lexical comparison (so maps keyed by these still iterate in a stable order).
 class RcString
 {
-    unsigned int*   m_ptr;
-    unsigned int    m_len;
+    struct Inner
+    {
+        size_t  hash;
+        ::std::string   str;
+    };
+    // nullptr for the empty string
+    const Inner*    m_ptr;
+
+    static const Inner* intern(const char* s, size_t len);
+    static const ::std::string& empty_str();
 public:
     RcString():
-        m_ptr(nullptr),
-        m_len(0)
+        m_ptr(nullptr)
+    {}
+    RcString(const char* s, size_t len):
+        m_ptr(intern(s, len))
     {}
-    RcString(const char* s, unsigned int len);
     RcString(const char* s):
         RcString(s, ::std::strlen(s))
     {
@@ -24,60 +47,68 @@ public:
     {
     }
 
-    RcString(const RcString& x):
-        m_ptr(x.m_ptr),
-        m_len(x.m_len)
-    {
-        if( m_ptr ) *m_ptr += 1;
-    }
-    RcString(RcString&& x):
-        m_ptr(x.m_ptr),
-        m_len(x.m_len)
-    {
-        x.m_ptr = nullptr;
-        x.m_len = 0;
-    }
+    RcString(const RcString& x) = default;
+    RcString& operator=(const RcString& x) = default;
 
-    ~RcString();
+    /// Hash of the string contents (computed once, when the string was first interned)
+    static size_t hash_str(const char* s, size_t len);
 
-    RcString& operator=(const RcString& x)
-    {
-        if( &x != this )
-        {
-            this->~RcString();
-            m_ptr = x.m_ptr;
-            m_len = x.m_len;
-            if( m_ptr ) *m_ptr += 1;
-        }
-        return *this;
+    const ::std::string& str() const {
+        return m_ptr ? m_ptr->str : empty_str();
     }
-    RcString& operator=(RcString&& x)
-    {
-        if( &x != this )
-        {
-            this->~RcString();
-            m_ptr = x.m_ptr;
-            m_len = x.m_len;
-            x.m_ptr = nullptr;
-            x.m_len = 0;
-        }
-        return *this;
+    operator const ::std::string&() const {
+        return str();
     }
-
-
     const char* c_str() const {
-        if( m_len > 0 )
-        {
-            return reinterpret_cast<const char*>(m_ptr + 1);
-        }
-        else
-        {
-            return "";
-        }
+        return str().c_str();
     }
-    bool operator==(const RcString& s) const { return *this == s.c_str(); }
-    bool operator==(const char* s) const;
+    size_t size() const {
+        return m_ptr ? m_ptr->str.size() : 0;
+    }
+    bool empty() const {
+        return m_ptr == nullptr;
+    }
+    size_t hash() const {
+        return m_ptr ? m_ptr->hash : hash_str("", 0);
+    }
+
+    bool operator==(const RcString& s) const { return m_ptr == s.m_ptr; }
+    bool operator!=(const RcString& s) const { return m_ptr != s.m_ptr; }
+    bool operator==(const char* s) const { return str() == s; }
+    bool operator!=(const char* s) const { return str() != s; }
+    bool operator==(const ::std::string& s) const { return str() == s; }
+    bool operator!=(const ::std::string& s) const { return str() != s; }
+    friend bool operator==(const ::std::string& a, const RcString& b) { return b == a; }
+    friend bool operator!=(const ::std::string& a, const RcString& b) { return b != a; }
+    friend bool operator==(const char* a, const RcString& b) { return b == a; }
+    friend bool operator!=(const char* a, const RcString& b) { return b != a; }
+
+    bool operator<(const RcString& s) const { return m_ptr != s.m_ptr && str() < s.str(); }
+    bool operator>(const RcString& s) const { return s < *this; }
+    bool operator<=(const RcString& s) const { return !(s < *this); }
+    bool operator>=(const RcString& s) const { return !(*this < s); }
+    /// Three-way lexical comparison (with an equality fast-path)
+    int compare(const RcString& s) const { return m_ptr == s.m_ptr ? 0 : str().compare(s.str()); }
+
+    friend ::std::string operator+(const RcString& a, const ::std::string& b) { return a.str() + b; }
+    friend ::std::string operator+(const ::std::string& a, const RcString& b) { return a + b.str(); }
+    friend ::std::string operator+(const RcString& a, const char* b) { return a.str() + b; }
+    friend ::std::string operator+(const char* a, const RcString& b) { return a + b.str(); }
+
+    /// Replace with the interned concatenation
+    RcString& operator+=(const char* s) { return *this = RcString(str() + s); }
+
     friend ::std::ostream& operator<<(::std::ostream& os, const RcString& x) {
-        return os << x.c_str();
+        return os << x.str();
     }
+
+    /// Print the number of distinct strings and the number of lookups
+    static void print_stats(::std::ostream& os);
 };
+
+namespace std {
+    template<> struct hash<RcString>
+    {
+        size_t operator()(const RcString& x) const { return x.hash(); }
+    };
+}
@@ -0,0 +1,22 @@
+/*
+ * MRustC - Rust Compiler
+ * - By John Hodge (Mutabah/thePowersGang)
+ *
+ * include/thread_pool.hpp
+ * - Worker pool for running independent per-item jobs
+ */
+#pragma once
+#include <functional>
+#include <cstddef>
+
+/// Requested number of worker threads (`-j <N>`), zero/one runs everything on the calling thread
+extern unsigned int g_thread_count;
+
+/// Returns the number of workers that should be used for the current phase
+/// - Always 1 when debug output is enabled, so logs stay readable.
+extern unsigned int ThreadPool_WorkerCount();
+
+/// Run `fcn(i)` for every `i` in `0 .. count`, distributed over the worker threads
+/// - Blocks until every job has completed.
+/// - If any job throws, the exception from the lowest job index is re-thrown on the calling thread.
+extern void ThreadPool_Run(size_t count, ::std::function<void(size_t)> fcn);
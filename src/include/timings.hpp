@@ -0,0 +1,26 @@
+/*
+ * MRustC - Rust Compiler
+ * - By John Hodge (Mutabah/thePowersGang)
+ *
+ * include/timings.hpp
+ * - Machine-readable phase timing/memory report (`--timings=<path>`)
+ */
+#pragma once
+#include <string>
+
+/// Enable the report, which is written to `path` (as JSON) when the process exits (including by `abort`)
+extern void Timings_Enable(::std::string path, ::std::string input);
+extern bool Timings_IsEnabled();
+
+/// Records the wall time, CPU time, peak RSS and number of allocations between construction and destruction
+/// - Scopes nest, an inner scope is recorded as a child of the enclosing one (e.g. crates within `LoadCrates`)
+/// - Only for use on the main thread.
+class Timings_Scope
+{
+    bool    m_active;
+public:
+    Timings_Scope(::std::string name);
+    ~Timings_Scope();
+    Timings_Scope(const Timings_Scope&) = delete;
+    Timings_Scope& operator=(const Timings_Scope&) = delete;
+};
@@ -603,6 +603,7 @@ public:
     ::std::shared_ptr<Span> outerSpan() const override;
     Ident::Hygiene realGetHygiene() const override;
     Token realGetToken() override;
+    bool realGetTokenTree(Token& open, TokenTree& out) override;
 };
 
 void Macro_InitDefaults()
@@ -1844,11 +1845,35 @@ unsigned int Macro_InvokeRules_MatchPattern(const Span& sp, const MacroRules& ru
         TokenStreamRO   in_stream;
     };
 
+    // Only try the arms that can start with the first input token (all arms if there's no dispatch table)
+    const auto* candidates = rules.arms_for_first_token( TokenStreamRO(input).next() );
+    size_t n_candidates = candidates ? candidates->size() : rules.m_rules.size();
+
     ::std::vector<size_t>   matches;
-    for(size_t i = 0; i < rules.m_rules.size(); i ++)
+    for(size_t ci = 0; ci < n_candidates; ci ++)
     {
+        size_t i = candidates ? (*candidates)[ci] : ci;
+        const auto& pattern = rules.m_rules[i].m_pattern;
         auto lex = TokenStreamRO(input);
-        auto arm_stream = MacroPatternStream(rules.m_rules[i].m_pattern);
+
+        // Quick check of the arm's leading literal tokens (avoids setting up the pattern stream for most dead arms)
+        {
+            auto lc = lex.clone();
+            size_t j = 0;
+            for(; j < pattern.size() && pattern[j].type == MacroPatEnt::PAT_TOKEN; j ++)
+            {
+                if( lc.next_tok() != pattern[j].tok )
+                    break;
+                lc.consume();
+            }
+            if( j < pattern.size() && pattern[j].type == MacroPatEnt::PAT_TOKEN )
+            {
+                DEBUG(i << " FAILED (literal " << j << ")");
+                continue ;
+            }
+        }
+
+        auto arm_stream = MacroPatternStream(pattern);
 
         bool fail = false;
         for(;;)
@@ -1910,8 +1935,10 @@ unsigned int Macro_InvokeRules_MatchPattern(const Span& sp, const MacroRules& ru
 
         if( ! fail )
         {
+            // NOTE: The first matching arm is used, so there's no need to check the rest
             matches.push_back(i);
             DEBUG(i << " MATCHED");
+            break;
         }
         else
         {
@@ -2430,6 +2457,18 @@ Token MacroExpander::realGetToken()
     return Token(TOK_EOF);
 }
 
+bool MacroExpander::realGetTokenTree(Token& open, TokenTree& out)
+{
+    // Groups can only be passed through if the last token came from a substituted token tree
+    if( m_next_token.type() != TOK_NULL || !m_ttstream )
+        return false;
+    TokenStream&    inner = *m_ttstream;
+    if( !inner.realGetTokenTree(open, out) )
+        return false;
+    inner.m_hygiene = inner.realGetHygiene();
+    return true;
+}
+
 const MacroExpansionEnt* MacroExpandState::next_ent()
 {
     //DEBUG("ofs " << m_offsets << " < " << m_root_contents.size());
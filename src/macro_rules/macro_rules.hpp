@@ -147,12 +147,25 @@ public:
     /// Expansion rules
     ::std::vector<MacroRulesArm>  m_rules;
 
+    /// Arms that can match an input starting with a given token type (indexed by `eTokenType`, arms in definition order)
+    /// - Built by `build_dispatch` once `m_rules` is populated, not serialised (empty if not built)
+    ::std::vector< ::std::vector<unsigned int> >    m_first_token_arms;
+
     MacroRules()
     {
     }
     virtual ~MacroRules();
     MacroRules(MacroRules&&) = default;
 
+    /// Populate `m_first_token_arms` from the arm patterns
+    void build_dispatch();
+    /// Candidate arms for an input that starts with a token of type `first`
+    const ::std::vector<unsigned int>* arms_for_first_token(eTokenType first) const {
+        if( m_first_token_arms.empty() )
+            return nullptr;
+        return &m_first_token_arms[first];
+    }
+
     SERIALISABLE_PROTOTYPES();
 };
 
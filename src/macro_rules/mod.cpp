@@ -295,6 +295,111 @@ SERIALISE_TU(MacroExpansionEnt, "MacroExpansionEnt", e,
 MacroRules::~MacroRules()
 {
 }
+
+namespace {
+    const unsigned int N_TOKEN_TYPES = 0
+        #define _(t)    + 1
+        #include "../parse/eTokenType.enum.h"
+        #undef _
+        ;
+
+    /// Set of token types that can start the match of a pattern sequence
+    struct FirstTokens
+    {
+        ::std::vector<bool> types;
+        bool any = false;
+
+        FirstTokens():
+            types(N_TOKEN_TYPES)
+        {}
+
+        void add_frag(MacroPatEnt::Type type)
+        {
+            // NOTE: This must be a superset of what the (loose) fragment consumers in eval.cpp accept, so only the
+            // fragments that are known to consume at least one token of a fixed set are restricted here.
+            switch(type)
+            {
+            case MacroPatEnt::PAT_IDENT:
+                types[TOK_IDENT] = true;
+                for(unsigned int i = TOK_RWORD_PUB; i < N_TOKEN_TYPES; i ++)
+                    types[i] = true;
+                break;
+            case MacroPatEnt::PAT_BLOCK:
+                types[TOK_BRACE_OPEN] = true;
+                types[TOK_INTERPOLATED_BLOCK] = true;
+                break;
+            case MacroPatEnt::PAT_META:
+                types[TOK_IDENT] = true;
+                types[TOK_INTERPOLATED_META] = true;
+                break;
+            case MacroPatEnt::PAT_TT:
+                for(unsigned int i = 0; i < N_TOKEN_TYPES; i ++)
+                {
+                    switch(i)
+                    {
+                    case TOK_EOF:
+                    case TOK_PAREN_CLOSE:
+                    case TOK_BRACE_CLOSE:
+                    case TOK_SQUARE_CLOSE:
+                        break;
+                    default:
+                        types[i] = true;
+                        break;
+                    }
+                }
+                break;
+            default:
+                any = true;
+                break;
+            }
+        }
+
+        /// Add the possible first tokens of `ents[start..]`, returns true if the sequence can match nothing
+        bool add_seq(const ::std::vector<MacroPatEnt>& ents, size_t start=0)
+        {
+            for(size_t i = start; i < ents.size(); i ++)
+            {
+                const auto& ent = ents[i];
+                switch(ent.type)
+                {
+                case MacroPatEnt::PAT_TOKEN:
+                    types[ent.tok.type()] = true;
+                    return false;
+                case MacroPatEnt::PAT_LOOP:
+                    // A `*` loop can be skipped, and a `+` loop can be passed if its body can be empty
+                    if( !this->add_seq(ent.subpats) && ent.name == "+" )
+                        return false;
+                    break;
+                default:
+                    this->add_frag(ent.type);
+                    return false;
+                }
+            }
+            return true;
+        }
+    };
+}
+
+void MacroRules::build_dispatch()
+{
+    m_first_token_arms.clear();
+    // Single-arm macros don't need a table (the arm is always tried)
+    if( m_rules.size() < 2 )
+        return ;
+
+    m_first_token_arms.resize(N_TOKEN_TYPES);
+    for(unsigned int i = 0; i < m_rules.size(); i ++)
+    {
+        FirstTokens first;
+        if( first.add_seq(m_rules[i].m_pattern) )
+            first.types[TOK_EOF] = true;
+        for(unsigned int t = 0; t < N_TOKEN_TYPES; t ++)
+        {
+            if( first.any || first.types[t] )
+                m_first_token_arms[t].push_back(i);
+        }
+    }
+}
 SERIALISE_TYPE_S(MacroRules, {
     s.item( m_exported );
     s.item( m_rules );
@@ -7,6 +7,7 @@
  */
 #include <iostream>
 #include <iomanip>
+#include <fstream>
 #include <string>
 #include <set>
 #include "parse/lex.hpp"
@@ -15,11 +16,15 @@
 #include "ast/crate.hpp"
 #include <serialiser_texttree.hpp>
 #include <cstring>
+#include <cerrno>
 #include <main_bindings.hpp>
+#include <thread_pool.hpp>
+#include <timings.hpp>
 #include "resolve/main_bindings.hpp"
 #include "hir/main_bindings.hpp"
 #include "hir_conv/main_bindings.hpp"
 #include "hir_typeck/main_bindings.hpp"
+#include "hir_typeck/static.hpp"    // StaticTraitResolve::print_cache_stats
 #include "hir_expand/main_bindings.hpp"
 #include "mir/main_bindings.hpp"
 #include "trans/main_bindings.hpp"
@@ -56,7 +61,7 @@
 # error "Unable to detect a suitable default target"
 #endif
 
-int g_debug_indent_level = 0;
+thread_local int g_debug_indent_level = 0;
 bool g_debug_enabled = true;
 ::std::string g_cur_phase;
 ::std::set< ::std::string>    g_debug_disable_map;
@@ -136,10 +141,6 @@ bool debug_enabled_update() {
         return true;
     }
 }
-bool debug_enabled()
-{
-    return g_debug_enabled;
-}
 ::std::ostream& debug_output(int indent, const char* function)
 {
     return ::std::cout << g_cur_phase << "- " << RepeatLitStr { " ", indent } << function << ": ";
@@ -163,6 +164,8 @@ struct ProgramParams
     ::std::string   target = DEFAULT_TARGET_NAME;
 
     ::std::string   emit_depfile;
+    ::std::string   timings_path;
+    HIR_MetadataCompression metadata_compression = HIR_MetadataCompression::Best;
 
     ::AST::Crate::Type  crate_type = ::AST::Crate::Type::Unknown;
     ::std::string   crate_name;
@@ -171,6 +174,9 @@ struct ProgramParams
     unsigned opt_level = 0;
     bool emit_debug_info = false;
 
+    /// Number of worker threads for parallel phases
+    unsigned thread_count = 1;
+
     bool test_harness = false;
 
     ::std::vector<const char*> lib_search_dirs;
@@ -183,9 +189,15 @@ struct ProgramParams
         bool disable_mir_optimisations = false;
         bool full_validate = false;
         bool full_validate_early = false;
+        bool print_cache_stats = false;
+        unsigned int bench_metadata = 0;
+        unsigned int bench_lexer = 0;
     } debug;
     struct {
         ::std::string   emit_build_command;
+        unsigned int codegen_units = 1;
+        ::std::string   mono_cache_dir;
+        bool incremental = false;
     } codegen;
 
     ProgramParams(int argc, char *argv[]);
@@ -199,7 +211,10 @@ Rv CompilePhase(const char *name, Fcn f) {
     g_cur_phase = name;
     g_debug_enabled = debug_enabled_update();
     auto start = clock();
-    auto rv = f();
+    auto rv = [&]() {
+        Timings_Scope   ts(name);
+        return f();
+        }();
     auto end = clock();
     g_cur_phase = "";
     g_debug_enabled = debug_enabled_update();
@@ -219,6 +234,23 @@ int main(int argc, char *argv[])
 {
     init_debug_list();
     ProgramParams   params(argc, argv);
+    g_thread_count = params.thread_count;
+    if( params.timings_path != "" )
+    {
+        Timings_Enable(params.timings_path, params.infile);
+    }
+
+    // Report cache statistics on exit (including the early returns from `-Z stop-after`)
+    struct CacheStatsGuard {
+        bool enabled;
+        ~CacheStatsGuard() {
+            if( enabled )
+            {
+                StaticTraitResolve::print_cache_stats(::std::cout);
+                RcString::print_stats(::std::cout);
+            }
+        }
+    } cache_stats_guard { params.debug.print_cache_stats };
 
     // Set up cfg values
     Cfg_SetValue("rust_compiler", "mrustc");
@@ -235,6 +267,23 @@ int main(int argc, char *argv[])
 
     try
     {
+        if( params.debug.bench_metadata > 0 )
+        {
+            // Run as `LoadCrates` so debug output follows that phase's setting
+            CompilePhaseV("LoadCrates", [&]() {
+                HIR_DeserialiseBenchmark(params.infile, params.debug.bench_metadata);
+                });
+            return 0;
+        }
+        if( params.debug.bench_lexer > 0 )
+        {
+            // After the cfg setup, as `#[cfg]` on `mod` items controls which files are loaded
+            CompilePhaseV("Parse", [&]() {
+                Parse_LexerBenchmark(params.infile, params.debug.bench_lexer);
+                });
+            return 0;
+        }
+
         // Parse the crate into AST
         AST::Crate crate = CompilePhase<AST::Crate>("Parse", [&]() {
             return Parse_Crate(params.infile);
@@ -471,6 +520,8 @@ int main(int argc, char *argv[])
         // - Also inserts defaults in trait impls
         CompilePhaseV("Resolve Type Aliases", [&]() {
             ConvertHIR_ExpandAliases(*hir_crate);
+            // Inherent impl types are now final (at least their outer type), so can be indexed for method lookup
+            hir_crate->build_type_impl_index();
             });
         // Set up bindings and other useful information.
         CompilePhaseV("Resolve Bind", [&]() {
@@ -605,6 +656,9 @@ int main(int argc, char *argv[])
         TransOptions    trans_opt;
         trans_opt.build_command_file = params.codegen.emit_build_command;
         trans_opt.opt_level = params.opt_level;
+        trans_opt.codegen_units = params.codegen.codegen_units;
+        trans_opt.mono_cache_dir = params.codegen.mono_cache_dir;
+        trans_opt.incremental = params.codegen.incremental;
         for(const char* libdir : params.lib_search_dirs ) {
             // Store these paths for use in final linking.
             hir_crate->m_link_paths.push_back( libdir );
@@ -635,7 +689,7 @@ int main(int argc, char *argv[])
             // Save a loadable HIR dump
             CompilePhaseV("HIR Serialise", [&]() {
                 //HIR_Serialise(params.outfile + ".meta", *hir_crate);
-                HIR_Serialise(params.outfile, *hir_crate);
+                HIR_Serialise(params.outfile, *hir_crate, params.metadata_compression);
                 });
 
             // Link metatdata and object into a .rlib
@@ -647,7 +701,7 @@ int main(int argc, char *argv[])
             CompilePhaseV("Trans Codegen", [&]() { Trans_Codegen(params.outfile + ".o", trans_opt, *hir_crate, items, false); });
             #endif
             // Save a loadable HIR dump
-            CompilePhaseV("HIR Serialise", [&]() { HIR_Serialise(params.outfile, *hir_crate); });
+            CompilePhaseV("HIR Serialise", [&]() { HIR_Serialise(params.outfile, *hir_crate, params.metadata_compression); });
 
             // Generate a .so/.dll
             // TODO: Codegen and include the metadata in a non-loadable segment
@@ -666,7 +720,7 @@ int main(int argc, char *argv[])
             CompilePhaseV("Trans Codegen", [&]() { Trans_Codegen(params.outfile + "-plugin", trans_opt, *hir_crate, items2, true); });
 
             hir_crate->m_lang_items.clear();    // Make sure that we're not exporting any lang items
-            CompilePhaseV("HIR Serialise", [&]() { HIR_Serialise(params.outfile, *hir_crate); });
+            CompilePhaseV("HIR Serialise", [&]() { HIR_Serialise(params.outfile, *hir_crate, params.metadata_compression); });
             break; }
         case ::AST::Crate::Type::Executable:
             // Generate a binary
@@ -698,6 +752,22 @@ int main(int argc, char *argv[])
     return 0;
 }
 
+/// Parse the value of a numeric option, exiting with an error unless the entire value is a decimal number
+static unsigned long parse_count_arg(const char* flag, const char* val)
+{
+    char*   end = nullptr;
+    errno = 0;
+    unsigned long rv = 0;
+    // NOTE: `strtoul` skips leading whitespace and accepts a sign, so check the first character directly
+    if( '0' <= val[0] && val[0] <= '9' )
+        rv = ::std::strtoul(val, &end, 10);
+    if( end == nullptr || *end != '\0' || errno == ERANGE ) {
+        ::std::cerr << "Flag " << flag << " requires a numeric value, got '" << val << "'" << ::std::endl;
+        exit(1);
+    }
+    return rv;
+}
+
 ProgramParams::ProgramParams(int argc, char *argv[])
 {
     // Hacky command-line parsing
@@ -747,6 +817,22 @@ ProgramParams::ProgramParams(int argc, char *argv[])
                     this->libraries.push_back( arg+1 );
                 }
                 continue ;
+            case 'j':
+                if( arg[1] == '\0' ) {
+                    if( i == argc - 1 ) {
+                        ::std::cerr << "Option " << arg << " requires an argument" << ::std::endl;
+                        exit(1);
+                    }
+                    this->thread_count = parse_count_arg("-j", argv[++i]);
+                }
+                else {
+                    this->thread_count = parse_count_arg("-j", arg+1);
+                }
+                if( this->thread_count == 0 ) {
+                    ::std::cerr << "Option -j requires a positive thread count" << ::std::endl;
+                    exit(1);
+                }
+                continue ;
             case 'C': {
                 ::std::string optname;
                 ::std::string optval;
@@ -767,21 +853,37 @@ ProgramParams::ProgramParams(int argc, char *argv[])
                 }
                 auto get_optval = [&]() {
                     if( eq_pos == ::std::string::npos ) {
-                        ::std::cerr << "Flag -Z " << optname << " requires an argument" << ::std::endl;
+                        ::std::cerr << "Flag -C " << optname << " requires an argument" << ::std::endl;
+                        exit(1);
+                    }
+                    };
+                auto no_optval = [&]() {
+                    if(eq_pos != ::std::string::npos) {
+                        ::std::cerr << "Flag -C " << optname << " doesn't take an argument" << ::std::endl;
                         exit(1);
                     }
                     };
-                //auto no_optval = [&]() {
-                //    if(eq_pos != ::std::string::npos) {
-                //        ::std::cerr << "Flag -Z " << optname << " doesn't take an argument" << ::std::endl;
-                //        exit(1);
-                //    }
-                //    };
 
                 if( optname == "emit-build-command" ) {
                     get_optval();
                     this->codegen.emit_build_command = optval;
                 }
+                else if( optname == "codegen-units" ) {
+                    get_optval();
+                    this->codegen.codegen_units = parse_count_arg("-C codegen-units", optval.c_str());
+                    if( this->codegen.codegen_units == 0 ) {
+                        ::std::cerr << "Option -C codegen-units requires a positive count" << ::std::endl;
+                        exit(1);
+                    }
+                }
+                else if( optname == "mono-cache" ) {
+                    get_optval();
+                    this->codegen.mono_cache_dir = optval;
+                }
+                else if( optname == "incremental" ) {
+                    no_optval();
+                    this->codegen.incremental = true;
+                }
                 else if( optname == "emit-depfile" ) {
                     get_optval();
                     this->emit_depfile = optval;
@@ -834,6 +936,38 @@ ProgramParams::ProgramParams(int argc, char *argv[])
                     no_optval();
                     this->debug.full_validate_early = true;
                 }
+                else if( optname == "print-cache-stats" ) {
+                    no_optval();
+                    this->debug.print_cache_stats = true;
+                }
+                else if( optname == "bench-metadata" ) {
+                    // Input file is a .hir file, loaded this many times
+                    get_optval();
+                    this->debug.bench_metadata = parse_count_arg("-Z bench-metadata", optval.c_str());
+                    if( this->debug.bench_metadata == 0 ) {
+                        ::std::cerr << "-Z bench-metadata requires a non-zero iteration count" << ::std::endl;
+                        exit(1);
+                    }
+                }
+                else if( optname == "bench-lexer" ) {
+                    // Input file is a crate root, all of its source files are lexed this many times
+                    get_optval();
+                    this->debug.bench_lexer = parse_count_arg("-Z bench-lexer", optval.c_str());
+                    if( this->debug.bench_lexer == 0 ) {
+                        ::std::cerr << "-Z bench-lexer requires a non-zero iteration count" << ::std::endl;
+                        exit(1);
+                    }
+                }
+                else if( optname == "inline-threshold" ) {
+                    // Maximum (net) cost of a function that is inlined without an `#[inline]` hint
+                    get_optval();
+                    g_mir_inline_options.threshold = parse_count_arg("-Z inline-threshold", optval.c_str());
+                }
+                else if( optname == "inline-budget" ) {
+                    // Maximum total cost of the code inlined into a single function
+                    get_optval();
+                    g_mir_inline_options.budget = parse_count_arg("-Z inline-budget", optval.c_str());
+                }
                 else if( optname == "stop-after" ) {
                     get_optval();
                     if( optval == "parse" )
@@ -1006,6 +1140,39 @@ ProgramParams::ProgramParams(int argc, char *argv[])
             else if( strcmp(arg, "--test") == 0 ) {
                 this->test_harness = true;
             }
+            // `--metadata-compression=<none|fast|best>`
+            else if( strncmp(arg, "--metadata-compression=", 23) == 0 ) {
+                const char* val = arg + 23;
+                if( strcmp(val, "none") == 0 ) {
+                    this->metadata_compression = HIR_MetadataCompression::None;
+                }
+                else if( strcmp(val, "fast") == 0 ) {
+                    this->metadata_compression = HIR_MetadataCompression::Fast;
+                }
+                else if( strcmp(val, "best") == 0 ) {
+                    this->metadata_compression = HIR_MetadataCompression::Best;
+                }
+                else {
+                    ::std::cerr << "Unknown value for --metadata-compression, expected none, fast, or best" << ::std::endl;
+                    exit(1);
+                }
+            }
+            // `--mir-opt-stats[=<n>]` - Print per-pass MIR optimisation statistics (and the `n` slowest functions)
+            else if( strcmp(arg, "--mir-opt-stats") == 0 || strncmp(arg, "--mir-opt-stats=", 16) == 0 ) {
+                g_mir_opt_stats_options.enabled = true;
+                if( arg[15] == '=' ) {
+                    // Zero is valid (only the per-pass table is printed)
+                    g_mir_opt_stats_options.top_functions = parse_count_arg("--mir-opt-stats", arg + 16);
+                }
+            }
+            // `--timings=<path>`   - Write per-phase timing and memory usage to a JSON file
+            else if( strncmp(arg, "--timings=", 10) == 0 ) {
+                this->timings_path = arg + 10;
+                if( this->timings_path == "" ) {
+                    ::std::cerr << "Flag --timings requires a path" << ::std::endl;
+                    exit(1);
+                }
+            }
             else {
                 ::std::cerr << "Unknown option '" << arg << "'" << ::std::endl;
                 exit(1);
@@ -1018,6 +1185,11 @@ ProgramParams::ProgramParams(int argc, char *argv[])
         ::std::cerr << "No input file passed" << ::std::endl;
         exit(1);
     }
+    // Incremental rebuilds work per codegen unit, and a single unit is always rebuilt
+    if( this->codegen.incremental && this->codegen.codegen_units == 1 )
+    {
+        ::std::cerr << "warning: -C incremental has no effect with a single codegen unit (set -C codegen-units)" << ::std::endl;
+    }
 }
 void ProgramParams::show_help() const
 {
@@ -1029,6 +1201,7 @@ void ProgramParams::show_help() const
         "-o <filename>      : Write compiler output (library or executable) to this file\n"
         "-O                 : Enable optimistion\n"
         "-g                 : Emit debugging information\n"
+        "-j <count>         : Use this many worker threads for parallel phases\n"
         "--out-dir <dir>    : Specify the output directory (alternative to `-o`)\n"
         "--extern <crate>=<path>\n"
         "                   : Specify the path for a given crate (instead of searching for it)\n"
@@ -1039,7 +1212,16 @@ void ProgramParams::show_help() const
         "--cfg flag=\"val\"   : Set a string #[cfg]/cfg! flag\n"
         "--target <name>    : Compile code for the given target\n"
         "--test             : Generate a unit test executable\n"
+        "--timings=<path>   : Write per-phase timing and memory usage (as JSON) to this file\n"
+        "--mir-opt-stats[=<n>]\n"
+        "                   : Print time and changes for each MIR optimisation pass, and the n (default 10) slowest functions\n"
+        "--metadata-compression=<none|fast|best>\n"
+        "                   : Compression for crate metadata (default best)\n"
         "-C <option>        : Code-generation options\n"
+        "   codegen-units=<n> : Split generated C code into this many files, compiled in parallel\n"
+        "   mono-cache=<dir>  : Cache code for monomorphised upstream generics in this (existing) directory\n"
+        "   incremental       : Skip the C compile of codegen units whose code (and the declarations it uses) is\n"
+        "                       unchanged since the last build. Everything up to generating C still runs (see codegen-units)\n"
         "-Z <option>        : Debugging/experiemental options\n"
         ;
 }
@@ -1203,9 +1203,8 @@ void MIR_Cleanup(const StaticTraitResolve& resolve, const ::HIR::ItemPath& path,
 
 void MIR_CleanupCrate(::HIR::Crate& crate)
 {
-    ::MIR::OuterVisitor    ov { crate, [&](const auto& res, const auto& p, auto& expr_ptr, const auto& args, const auto& ty){
+    ::MIR::visit_crate_mir_parallel(crate, [&](const auto& res, const auto& p, auto& expr_ptr, const auto& args, const auto& ty){
             MIR_Cleanup(res, p, *expr_ptr.m_mir, args, ty);
-        } };
-    ov.visit_crate(crate);
+        });
 }
 
@@ -0,0 +1,884 @@
+/*
+ * MRustC - Rust Compiler
+ * - By John Hodge (Mutabah/thePowersGang)
+ *
+ * mir/dataflow.cpp
+ * - Worklist dataflow solver over MIR blocks, and the common analyses built on it
+ */
+#include "dataflow.hpp"
+#include <debug.hpp>
+#include <common.hpp>
+#include <algorithm>
+#include <deque>
+
+namespace MIR {
+namespace dataflow {
+
+// --------------------------------------------------------------------
+// BitSet
+// --------------------------------------------------------------------
+BitSet::BitSet(size_t size, bool fill):
+    m_size(size),
+    m_words((size + 63) / 64, fill ? ~uint64_t(0) : 0)
+{
+    if( fill && size % 64 != 0 )
+        m_words.back() = (uint64_t(1) << (size % 64)) - 1;
+}
+void BitSet::set_all()
+{
+    *this = BitSet(m_size, true);
+}
+void BitSet::clear()
+{
+    ::std::fill(m_words.begin(), m_words.end(), 0);
+}
+bool BitSet::any() const
+{
+    for(auto w : m_words)
+        if( w != 0 )
+            return true;
+    return false;
+}
+bool BitSet::union_with(const BitSet& x)
+{
+    assert(m_size == x.m_size);
+    bool rv = false;
+    for(size_t i = 0; i < m_words.size(); i ++)
+    {
+        auto v = m_words[i] | x.m_words[i];
+        rv |= (v != m_words[i]);
+        m_words[i] = v;
+    }
+    return rv;
+}
+bool BitSet::intersect_with(const BitSet& x)
+{
+    assert(m_size == x.m_size);
+    bool rv = false;
+    for(size_t i = 0; i < m_words.size(); i ++)
+    {
+        auto v = m_words[i] & x.m_words[i];
+        rv |= (v != m_words[i]);
+        m_words[i] = v;
+    }
+    return rv;
+}
+void BitSet::subtract(const BitSet& x)
+{
+    assert(m_size == x.m_size);
+    for(size_t i = 0; i < m_words.size(); i ++)
+        m_words[i] &= ~x.m_words[i];
+}
+
+// --------------------------------------------------------------------
+// Block graph and solver
+// --------------------------------------------------------------------
+BlockGraph::BlockGraph(const ::MIR::Function& fcn):
+    succs(fcn.blocks.size()),
+    preds(fcn.blocks.size()),
+    reachable(fcn.blocks.size())
+{
+    for(size_t i = 0; i < fcn.blocks.size(); i ++)
+    {
+        auto& s = succs[i];
+        TU_MATCHA( (fcn.blocks[i].terminator), (te),
+        (Incomplete, ),
+        (Return, ),
+        (Diverge, ),
+        (Goto,
+            s.push_back(te);
+            ),
+        (Panic,
+            s.push_back(te.dst);
+            ),
+        (If,
+            s.push_back(te.bb0);
+            s.push_back(te.bb1);
+            ),
+        (Switch,
+            s.insert(s.end(), te.targets.begin(), te.targets.end());
+            ),
+        (SwitchValue,
+            s.insert(s.end(), te.targets.begin(), te.targets.end());
+            s.push_back(te.def_target);
+            ),
+        (Call,
+            s.push_back(te.ret_block);
+            s.push_back(te.panic_block);
+            )
+        )
+        ::std::sort(s.begin(), s.end());
+        s.erase(::std::unique(s.begin(), s.end()), s.end());
+        for(auto t : s)
+            preds[t].push_back(i);
+    }
+
+    if( fcn.blocks.empty() )
+        return ;
+    // Iterative DFS, recording the post-order
+    ::std::vector<BasicBlockId> post_order;
+    ::std::vector< ::std::pair<BasicBlockId, size_t> >    stack;
+    stack.push_back(::std::make_pair(0, 0));
+    reachable[0] = true;
+    while( !stack.empty() )
+    {
+        auto& top = stack.back();
+        const auto& s = succs[top.first];
+        if( top.second < s.size() )
+        {
+            auto t = s[top.second ++];
+            if( !reachable[t] )
+            {
+                reachable[t] = true;
+                stack.push_back(::std::make_pair(t, 0));
+            }
+        }
+        else
+        {
+            post_order.push_back(top.first);
+            stack.pop_back();
+        }
+    }
+    rpo.assign(post_order.rbegin(), post_order.rend());
+}
+
+const BasicBlockId DominatorTree::NONE;
+
+// Cooper, Harvey & Kennedy's iterative algorithm ("A Simple, Fast Dominance Algorithm")
+DominatorTree::DominatorTree(const BlockGraph& graph):
+    idom(graph.succs.size(), NONE),
+    children(graph.succs.size())
+{
+    if( graph.rpo.empty() )
+        return ;
+    ::std::vector<unsigned> order(graph.succs.size(), NONE);
+    for(size_t i = 0; i < graph.rpo.size(); i ++)
+        order[graph.rpo[i]] = i;
+
+    auto intersect = [&](BasicBlockId a, BasicBlockId b) {
+        while( a != b )
+        {
+            while( order[a] > order[b] )
+                a = idom[a];
+            while( order[b] > order[a] )
+                b = idom[b];
+        }
+        return a;
+        };
+
+    idom[graph.rpo[0]] = graph.rpo[0];
+    for(bool changed = true; changed; )
+    {
+        changed = false;
+        for(size_t i = 1; i < graph.rpo.size(); i ++)
+        {
+            auto bb = graph.rpo[i];
+            auto new_idom = NONE;
+            for(auto p : graph.preds[bb])
+            {
+                // Skip unreachable and not yet visited predecessors
+                if( idom[p] == NONE )
+                    continue ;
+                new_idom = (new_idom == NONE ? p : intersect(p, new_idom));
+            }
+            if( idom[bb] != new_idom )
+            {
+                idom[bb] = new_idom;
+                changed = true;
+            }
+        }
+    }
+
+    for(size_t i = 1; i < graph.rpo.size(); i ++)
+        children[idom[graph.rpo[i]]].push_back(graph.rpo[i]);
+}
+bool DominatorTree::dominates(BasicBlockId a, BasicBlockId b) const
+{
+    if( idom[b] == NONE )
+        return false;
+    for(;;)
+    {
+        if( a == b )
+            return true;
+        if( idom[b] == b )
+            return false;
+        b = idom[b];
+    }
+}
+
+Solution solve(const BlockGraph& graph, const Problem& problem)
+{
+    const size_t n_blocks = graph.succs.size();
+    const size_t n_bits = problem.boundary.size();
+    const bool is_fwd = (problem.dir == Direction::Forward);
+    const bool is_union = (problem.meet == Meet::Union);
+
+    Solution    rv;
+    // Optimistic initial state (empty for union, full for intersection)
+    rv.entry.assign(n_blocks, BitSet(n_bits, !is_union));
+    rv.exit.assign(n_blocks, BitSet(n_bits, !is_union));
+    auto& ins  = is_fwd ? rv.entry : rv.exit;
+    auto& outs = is_fwd ? rv.exit : rv.entry;
+    const auto& sources = is_fwd ? graph.preds : graph.succs;
+    const auto& dependents = is_fwd ? graph.succs : graph.preds;
+
+    // Initial visit order: reverse post-order (forwards), post-order (backwards)
+    // - Backwards problems also visit unreachable blocks (they're cheap, and it keeps the result conservative)
+    ::std::deque<BasicBlockId>  worklist;
+    ::std::vector<bool> queued(n_blocks);
+    if( is_fwd ) {
+        worklist.assign(graph.rpo.begin(), graph.rpo.end());
+    }
+    else {
+        worklist.assign(graph.rpo.rbegin(), graph.rpo.rend());
+        for(size_t i = 0; i < n_blocks; i ++)
+            if( !graph.reachable[i] )
+                worklist.push_back(i);
+    }
+    for(auto bb : worklist)
+        queued[bb] = true;
+
+    size_t  n_visits = 0;
+    while( !worklist.empty() )
+    {
+        auto bb = worklist.front();
+        worklist.pop_front();
+        queued[bb] = false;
+        n_visits ++;
+
+        // Meet over the sources (and the boundary)
+        auto& in = ins[bb];
+        bool is_boundary = is_fwd ? bb == 0 : sources[bb].empty();
+        bool first = true;
+        auto meet = [&](const BitSet& v) {
+            if( first )
+                in = v;
+            else if( is_union )
+                in.union_with(v);
+            else
+                in.intersect_with(v);
+            first = false;
+            };
+        if( is_boundary )
+            meet(problem.boundary);
+        for(auto src : sources[bb])
+        {
+            if( is_fwd && !graph.reachable[src] )
+                continue ;
+            meet(outs[src]);
+        }
+        if( first )
+            in = BitSet(n_bits);
+
+        // Transfer
+        auto out = in;
+        out.subtract(problem.kill[bb]);
+        out.union_with(problem.gen[bb]);
+        if( out != outs[bb] )
+        {
+            outs[bb] = mv$(out);
+            for(auto d : dependents[bb])
+            {
+                if( is_fwd && !graph.reachable[d] )
+                    continue ;
+                if( !queued[d] )
+                {
+                    queued[d] = true;
+                    worklist.push_back(d);
+                }
+            }
+        }
+    }
+    if( is_fwd )
+    {
+        for(size_t i = 0; i < n_blocks; i ++)
+        {
+            if( !graph.reachable[i] ) {
+                rv.entry[i] = BitSet(n_bits);
+                rv.exit[i] = BitSet(n_bits);
+            }
+        }
+    }
+    DEBUG(n_blocks << " blocks, " << n_visits << " visits");
+    return rv;
+}
+
+namespace {
+    const unsigned SLOT_MEMORY = ~0u;
+
+    /// Storage slot of a root lvalue: locals, then the return value, then arguments (statics are `SLOT_MEMORY`)
+    unsigned get_slot(const ::MIR::LValue& root, size_t n_locals)
+    {
+        TU_MATCH_DEF( ::MIR::LValue, (root), (e),
+        (
+            BUG(Span(), "Non-root lvalue " << root);
+            ),
+        (Local,
+            return e;
+            ),
+        (Return,
+            return n_locals;
+            ),
+        (Argument,
+            return n_locals + 1 + e.idx;
+            ),
+        (Static,
+            return SLOT_MEMORY;
+            )
+        )
+    }
+    /// Root of the storage accessed by a lvalue, `through_ptr` is set if the access is through a pointer
+    const ::MIR::LValue& get_root(const ::MIR::LValue& lv, bool& through_ptr)
+    {
+        TU_MATCH_DEF( ::MIR::LValue, (lv), (e),
+        (
+            return lv;
+            ),
+        (Field,
+            return get_root(*e.val, through_ptr);
+            ),
+        (Downcast,
+            return get_root(*e.val, through_ptr);
+            ),
+        (Index,
+            return get_root(*e.val, through_ptr);
+            ),
+        (Deref,
+            through_ptr = true;
+            return get_root(*e.val, through_ptr);
+            )
+        )
+    }
+    /// Visit all of the root lvalues used by a lvalue (the accessed value, index values, and dereferenced pointers)
+    template<typename Cb>
+    void for_each_leaf(const ::MIR::LValue& lv, Cb& cb)
+    {
+        TU_MATCH_DEF( ::MIR::LValue, (lv), (e),
+        (
+            cb(lv);
+            ),
+        (Field,
+            for_each_leaf(*e.val, cb);
+            ),
+        (Downcast,
+            for_each_leaf(*e.val, cb);
+            ),
+        (Deref,
+            for_each_leaf(*e.val, cb);
+            ),
+        (Index,
+            for_each_leaf(*e.val, cb);
+            for_each_leaf(*e.idx, cb);
+            )
+        )
+    }
+    template<typename Cb>
+    void for_each_param_leaf(const ::MIR::Param& p, Cb& cb)
+    {
+        if( const auto* e = p.opt_LValue() )
+            for_each_leaf(*e, cb);
+    }
+
+    /// Visit each lvalue used by a statement (all accesses are reads, except for the `dst` of an assignment)
+    template<typename Cb>
+    void for_each_rvalue_lvalue(const ::MIR::RValue& rv, Cb& cb)
+    {
+        auto p = [&](const ::MIR::Param& p) { if( const auto* e = p.opt_LValue() ) cb(*e); };
+        TU_MATCHA( (rv), (se),
+        (Use, cb(se); ),
+        (Constant, ),
+        (SizedArray, p(se.val); ),
+        (Borrow, cb(se.val); ),
+        (Cast, cb(se.val); ),
+        (BinOp, p(se.val_l); p(se.val_r); ),
+        (UniOp, cb(se.val); ),
+        (DstMeta, cb(se.val); ),
+        (DstPtr, cb(se.val); ),
+        (MakeDst, p(se.ptr_val); p(se.meta_val); ),
+        (Tuple, for(const auto& v : se.vals) p(v); ),
+        (Array, for(const auto& v : se.vals) p(v); ),
+        (Variant, p(se.val); ),
+        (Struct, for(const auto& v : se.vals) p(v); )
+        )
+    }
+
+    size_t count_slots(const ::MIR::Function& fcn)
+    {
+        unsigned n_args = 0;
+        auto cb = [&](const ::MIR::LValue& lv) {
+            if( const auto* e = lv.opt_Argument() )
+                n_args = ::std::max(n_args, e->idx + 1);
+            };
+        auto cb_lv = [&](const ::MIR::LValue& lv) { for_each_leaf(lv, cb); };
+        for(const auto& bb : fcn.blocks)
+        {
+            for(const auto& stmt : bb.statements)
+            {
+                TU_MATCHA( (stmt), (se),
+                (Assign,
+                    cb_lv(se.dst);
+                    for_each_rvalue_lvalue(se.src, cb_lv);
+                    ),
+                (Asm,
+                    for(const auto& v : se.inputs)
+                        cb_lv(v.second);
+                    for(const auto& v : se.outputs)
+                        cb_lv(v.second);
+                    ),
+                (SetDropFlag, ),
+                (Drop,
+                    cb_lv(se.slot);
+                    ),
+                (ScopeEnd, )
+                )
+            }
+            TU_MATCH_DEF( ::MIR::Terminator, (bb.terminator), (te),
+            (
+                ),
+            (If, cb_lv(te.cond); ),
+            (Switch, cb_lv(te.val); ),
+            (SwitchValue, cb_lv(te.val); ),
+            (Call,
+                if( te.fcn.is_Value() )
+                    cb_lv(te.fcn.as_Value());
+                for(const auto& a : te.args)
+                    for_each_param_leaf(a, cb);
+                cb_lv(te.ret_val);
+                )
+            )
+        }
+        return fcn.locals.size() + 1 + n_args;
+    }
+    /// Determine the slots that are borrowed (directly, not through a pointer) anywhere in the function
+    BitSet get_borrowed(const ::MIR::Function& fcn, size_t n_slots)
+    {
+        BitSet  rv(n_slots);
+        for(const auto& bb : fcn.blocks)
+        {
+            for(const auto& stmt : bb.statements)
+            {
+                if( const auto* se = stmt.opt_Assign() )
+                {
+                    if( const auto* be = se->src.opt_Borrow() )
+                    {
+                        bool through_ptr = false;
+                        const auto& root = get_root(be->val, through_ptr);
+                        auto slot = get_slot(root, fcn.locals.size());
+                        if( !through_ptr && slot != SLOT_MEMORY )
+                            rv.set(slot);
+                    }
+                }
+            }
+        }
+        return rv;
+    }
+
+    // ----------------------------------------------------------------
+    // Liveness helpers
+    // ----------------------------------------------------------------
+    /// Call `use` for each local read by the statement, and `def` for a local that it entirely overwrites
+    template<typename Use, typename Def>
+    void statement_use_def(const ::MIR::Statement& stmt, Use& use, Def& def)
+    {
+        auto cb = [&](const ::MIR::LValue& lv) { if( lv.is_Local() ) use(lv.as_Local()); };
+        auto cb_lv = [&](const ::MIR::LValue& lv) { for_each_leaf(lv, cb); };
+        TU_MATCHA( (stmt), (se),
+        (Assign,
+            // NOTE: The caller must apply the def before the uses
+            if( se.dst.is_Local() )
+                def(se.dst.as_Local());
+            else
+                cb_lv(se.dst);
+            for_each_rvalue_lvalue(se.src, cb_lv);
+            ),
+        (Asm,
+            for(const auto& v : se.inputs)
+                cb_lv(v.second);
+            // Outputs may also be inputs (e.g. `+r`), so treat them as uses
+            for(const auto& v : se.outputs)
+                cb_lv(v.second);
+            ),
+        (SetDropFlag,
+            ),
+        (Drop,
+            cb_lv(se.slot);
+            ),
+        (ScopeEnd,
+            )
+        )
+    }
+    template<typename Use>
+    void terminator_uses(const ::MIR::Terminator& term, Use& use)
+    {
+        auto cb = [&](const ::MIR::LValue& lv) { if( lv.is_Local() ) use(lv.as_Local()); };
+        TU_MATCH_DEF( ::MIR::Terminator, (term), (te),
+        (
+            ),
+        (If, for_each_leaf(te.cond, cb); ),
+        (Switch, for_each_leaf(te.val, cb); ),
+        (SwitchValue, for_each_leaf(te.val, cb); ),
+        (Call,
+            if( te.fcn.is_Value() )
+                for_each_leaf(te.fcn.as_Value(), cb);
+            for(const auto& a : te.args)
+                for_each_param_leaf(a, cb);
+            // The return value isn't written if the call panics, so isn't a definition. A partial write is a use.
+            if( !te.ret_val.is_Local() )
+                for_each_leaf(te.ret_val, cb);
+            )
+        )
+    }
+
+    // ----------------------------------------------------------------
+    // Copy invalidation events
+    // ----------------------------------------------------------------
+    /// Report the slot changed by an access to `lv`: `cb(slot, is_write)`
+    /// - Moves only invalidate copies that read the slot, writes (and borrows) also invalidate copies into it.
+    template<typename Cb>
+    void lvalue_invalidates(const ::MIR::LValue& lv, bool is_write, size_t n_locals, const BitSet& borrowed, Cb& cb)
+    {
+        bool through_ptr = false;
+        const auto& root = get_root(lv, through_ptr);
+        auto slot = get_slot(root, n_locals);
+        if( through_ptr || slot == SLOT_MEMORY )
+        {
+            cb(SLOT_MEMORY, true);
+        }
+        else
+        {
+            cb(slot, is_write);
+            // The slot may be read through a pointer
+            if( borrowed.test(slot) )
+                cb(SLOT_MEMORY, true);
+        }
+    }
+    template<typename Cb>
+    void statement_invalidates(const ::MIR::Statement& stmt, size_t n_locals, const BitSet& borrowed, Cb& cb)
+    {
+        auto mv = [&](const ::MIR::Param& p) { if( const auto* e = p.opt_LValue() ) lvalue_invalidates(*e, false, n_locals, borrowed, cb); };
+        TU_MATCHA( (stmt), (se),
+        (Assign,
+            TU_MATCH_DEF( ::MIR::RValue, (se.src), (re),
+            (
+                ),
+            (Use,
+                lvalue_invalidates(re, false, n_locals, borrowed, cb);
+                ),
+            (Borrow,
+                // Borrows are treated as writes, as the value can be changed through the borrow
+                lvalue_invalidates(re.val, true, n_locals, borrowed, cb);
+                ),
+            (MakeDst,
+                mv(re.ptr_val);
+                ),
+            (Tuple,
+                for(const auto& v : re.vals)
+                    mv(v);
+                ),
+            (Array,
+                for(const auto& v : re.vals)
+                    mv(v);
+                ),
+            (Variant,
+                mv(re.val);
+                ),
+            (Struct,
+                for(const auto& v : re.vals)
+                    mv(v);
+                )
+            )
+            lvalue_invalidates(se.dst, true, n_locals, borrowed, cb);
+            ),
+        (Asm,
+            for(const auto& v : se.outputs)
+                lvalue_invalidates(v.second, true, n_locals, borrowed, cb);
+            cb(SLOT_MEMORY, true);
+            ),
+        (SetDropFlag,
+            ),
+        (Drop,
+            lvalue_invalidates(se.slot, true, n_locals, borrowed, cb);
+            cb(SLOT_MEMORY, true);
+            ),
+        (ScopeEnd,
+            )
+        )
+    }
+    template<typename Cb>
+    void terminator_invalidates(const ::MIR::Terminator& term, size_t n_locals, const BitSet& borrowed, Cb& cb)
+    {
+        if( const auto* te = term.opt_Call() )
+        {
+            for(const auto& a : te->args)
+                if( const auto* e = a.opt_LValue() )
+                    lvalue_invalidates(*e, false, n_locals, borrowed, cb);
+            lvalue_invalidates(te->ret_val, true, n_locals, borrowed, cb);
+        }
+    }
+}
+
+// --------------------------------------------------------------------
+// Liveness
+// --------------------------------------------------------------------
+Liveness::Liveness(const ::MIR::Function& fcn, const BlockGraph& graph)
+{
+    auto n_locals = fcn.locals.size();
+    {
+        auto b = get_borrowed(fcn, count_slots(fcn));
+        borrowed = BitSet(n_locals);
+        for(size_t i = 0; i < n_locals; i ++)
+            if( b.test(i) )
+                borrowed.set(i);
+    }
+
+    Problem p;
+    p.dir = Direction::Backward;
+    p.meet = Meet::Union;
+    p.boundary = BitSet(n_locals);
+    p.gen.reserve(fcn.blocks.size());
+    p.kill.reserve(fcn.blocks.size());
+    for(const auto& bb : fcn.blocks)
+    {
+        // Walk backwards, `gen` is the set of locals used before being defined
+        BitSet  gen(n_locals);
+        BitSet  kill(n_locals);
+        auto use = [&](unsigned l) { gen.set(l); };
+        auto def = [&](unsigned l) { gen.reset(l); kill.set(l); };
+        terminator_uses(bb.terminator, use);
+        for(size_t i = bb.statements.size(); i --; )
+            statement_use_def(bb.statements[i], use, def);
+        p.gen.push_back(mv$(gen));
+        p.kill.push_back(mv$(kill));
+    }
+    sol = solve(graph, p);
+}
+void Liveness::step_back(const ::MIR::Statement& stmt, BitSet& live) const
+{
+    auto use = [&](unsigned l) { live.set(l); };
+    auto def = [&](unsigned l) { live.reset(l); };
+    statement_use_def(stmt, use, def);
+}
+void Liveness::step_back(const ::MIR::Terminator& term, BitSet& live) const
+{
+    auto use = [&](unsigned l) { live.set(l); };
+    terminator_uses(term, use);
+}
+
+// --------------------------------------------------------------------
+// Copy tracking
+// --------------------------------------------------------------------
+CopyTracker::CopyTracker(const ::MIR::Function& fcn, const BitSet& borrowed):
+    m_borrowed(borrowed),
+    m_by_dst(fcn.locals.size()),
+    m_by_slot(borrowed.size())
+{
+}
+void CopyTracker::add(unsigned dst, const ::MIR::LValue& src, unsigned tag)
+{
+    auto idx = static_cast<unsigned>(m_entries.size());
+    if( m_by_dst[dst] != 0 )
+        m_entries[m_by_dst[dst]-1].live = false;
+    m_entries.push_back(Entry { dst, &src, tag, true });
+    m_by_dst[dst] = idx + 1;
+
+    bool reads_memory = false;
+    auto n_locals = m_by_dst.size();
+    auto cb = [&](const ::MIR::LValue& lv) {
+        auto slot = get_slot(lv, n_locals);
+        if( slot == SLOT_MEMORY || m_borrowed.test(slot) )
+            reads_memory = true;
+        if( slot != SLOT_MEMORY )
+        {
+            if( m_by_slot[slot].empty() )
+                m_touched_slots.push_back(slot);
+            m_by_slot[slot].push_back(idx);
+        }
+        };
+    for_each_leaf(src, cb);
+    bool through_ptr = false;
+    get_root(src, through_ptr);
+    if( reads_memory || through_ptr )
+        m_memory.push_back(idx);
+}
+void CopyTracker::remove(unsigned local)
+{
+    if( m_by_dst[local] != 0 )
+    {
+        m_entries[m_by_dst[local]-1].live = false;
+        m_by_dst[local] = 0;
+    }
+}
+void CopyTracker::clear()
+{
+    for(const auto& e : m_entries)
+        m_by_dst[e.dst] = 0;
+    m_entries.clear();
+    for(auto s : m_touched_slots)
+        m_by_slot[s].clear();
+    m_touched_slots.clear();
+    m_memory.clear();
+}
+void CopyTracker::kill_slot(unsigned slot, bool is_write)
+{
+    auto kill = [&](::std::vector<unsigned>& list) {
+        for(auto i : list)
+        {
+            auto& e = m_entries[i];
+            if( e.live )
+            {
+                e.live = false;
+                m_by_dst[e.dst] = 0;
+            }
+        }
+        list.clear();
+        };
+    if( slot == SLOT_MEMORY )
+    {
+        kill(m_memory);
+    }
+    else
+    {
+        kill(m_by_slot[slot]);
+        if( is_write && slot < m_by_dst.size() )
+            remove(slot);
+    }
+}
+void CopyTracker::invalidate(const ::MIR::Statement& stmt)
+{
+    auto cb = [&](unsigned slot, bool is_write) { this->kill_slot(slot, is_write); };
+    statement_invalidates(stmt, m_by_dst.size(), m_borrowed, cb);
+}
+void CopyTracker::invalidate(const ::MIR::Terminator& term)
+{
+    auto cb = [&](unsigned slot, bool is_write) { this->kill_slot(slot, is_write); };
+    terminator_invalidates(term, m_by_dst.size(), m_borrowed, cb);
+}
+void CopyTracker::clobber_memory()
+{
+    kill_slot(SLOT_MEMORY, true);
+}
+
+// --------------------------------------------------------------------
+// Available copies
+// --------------------------------------------------------------------
+bool AvailableCopies::is_copy(const ::MIR::Statement& stmt)
+{
+    const auto* se = stmt.opt_Assign();
+    if( !se || !se->dst.is_Local() || !se->src.is_Use() )
+        return false;
+    // Self-referential copies (e.g. `a = a.0`) can't be propagated
+    bool self_ref = false;
+    auto cb = [&](const ::MIR::LValue& lv) { self_ref |= (lv == se->dst); };
+    for_each_leaf(se->src.as_Use(), cb);
+    return !self_ref;
+}
+
+AvailableCopies::AvailableCopies(const ::MIR::Function& fcn, const BlockGraph& graph)
+{
+    auto n_locals = fcn.locals.size();
+    auto n_slots = count_slots(fcn);
+    borrowed = get_borrowed(fcn, n_slots);
+
+    for(unsigned bb_idx = 0; bb_idx < fcn.blocks.size(); bb_idx ++)
+    {
+        const auto& bb = fcn.blocks[bb_idx];
+        for(unsigned i = 0; i < bb.statements.size(); i ++)
+        {
+            if( is_copy(bb.statements[i]) )
+            {
+                const auto& se = bb.statements[i].as_Assign();
+                copies.push_back(Copy { bb_idx, i, se.dst.as_Local(), se.src.as_Use().clone() });
+            }
+        }
+    }
+
+    // Index the copies by the slots that invalidate them
+    ::std::vector< ::std::vector<unsigned> >  by_dst(n_locals);
+    ::std::vector< ::std::vector<unsigned> >  by_slot(n_slots);
+    ::std::vector<unsigned> by_memory;
+    for(unsigned i = 0; i < copies.size(); i ++)
+    {
+        const auto& c = copies[i];
+        by_dst[c.dst].push_back(i);
+        bool reads_memory = false;
+        auto cb = [&](const ::MIR::LValue& lv) {
+            auto slot = get_slot(lv, n_locals);
+            if( slot == SLOT_MEMORY || borrowed.test(slot) )
+                reads_memory = true;
+            if( slot != SLOT_MEMORY && (by_slot[slot].empty() || by_slot[slot].back() != i) )
+                by_slot[slot].push_back(i);
+            };
+        for_each_leaf(c.src, cb);
+        bool through_ptr = false;
+        get_root(c.src, through_ptr);
+        if( reads_memory || through_ptr )
+            by_memory.push_back(i);
+    }
+
+    Problem p;
+    p.dir = Direction::Forward;
+    p.meet = Meet::Intersect;
+    p.boundary = BitSet(copies.size());
+    p.gen.reserve(fcn.blocks.size());
+    p.kill.reserve(fcn.blocks.size());
+    CopyTracker tracker(fcn, borrowed);
+    // Last block that reported each slot (so each block only applies each slot's kills once)
+    ::std::vector<unsigned> slot_seen(n_slots, ~0u);
+    ::std::vector<unsigned> dst_seen(n_locals, ~0u);
+    unsigned copy_idx = 0;
+    for(unsigned bb_idx = 0; bb_idx < fcn.blocks.size(); bb_idx ++)
+    {
+        const auto& bb = fcn.blocks[bb_idx];
+        BitSet  kill(copies.size());
+        bool memory_seen = false;
+        auto cb = [&](unsigned slot, bool is_write) {
+            if( slot == SLOT_MEMORY ) {
+                if( !memory_seen )
+                    for(auto i : by_memory)
+                        kill.set(i);
+                memory_seen = true;
+                return ;
+            }
+            if( slot_seen[slot] != bb_idx ) {
+                for(auto i : by_slot[slot])
+                    kill.set(i);
+                slot_seen[slot] = bb_idx;
+            }
+            if( is_write && slot < n_locals && dst_seen[slot] != bb_idx ) {
+                for(auto i : by_dst[slot])
+                    kill.set(i);
+                dst_seen[slot] = bb_idx;
+            }
+            };
+
+        // Generated copies are the ones still live in a tracker run over just this block
+        tracker.clear();
+        for(unsigned i = 0; i < bb.statements.size(); i ++)
+        {
+            const auto& stmt = bb.statements[i];
+            statement_invalidates(stmt, n_locals, borrowed, cb);
+            tracker.invalidate(stmt);
+            if( copy_idx < copies.size() && copies[copy_idx].bb == bb_idx && copies[copy_idx].stmt_idx == i )
+            {
+                tracker.add(copies[copy_idx].dst, copies[copy_idx].src, copy_idx);
+                copy_idx ++;
+            }
+        }
+        terminator_invalidates(bb.terminator, n_locals, borrowed, cb);
+        tracker.invalidate(bb.terminator);
+        if( bb.terminator.is_Call() ) {
+            cb(SLOT_MEMORY, true);
+            tracker.clobber_memory();
+        }
+
+        BitSet  gen(copies.size());
+        tracker.for_each_live([&](const CopyTracker::Entry& e) { gen.set(e.tag); });
+        p.gen.push_back(mv$(gen));
+        p.kill.push_back(mv$(kill));
+    }
+    assert(copy_idx == copies.size());
+    sol = solve(graph, p);
+}
+
+}   // namespace dataflow
+}   // namespace MIR
@@ -0,0 +1,213 @@
+/*
+ * MRustC - Rust Compiler
+ * - By John Hodge (Mutabah/thePowersGang)
+ *
+ * mir/dataflow.hpp
+ * - Worklist dataflow solver over MIR blocks, and the common analyses built on it
+ */
+#pragma once
+#include "mir.hpp"
+#include <vector>
+#include <cstdint>
+
+namespace MIR {
+namespace dataflow {
+
+/// Fixed-size set of small integers (locals, definition sites, ...)
+class BitSet
+{
+    size_t  m_size;
+    ::std::vector<uint64_t> m_words;
+public:
+    BitSet():
+        m_size(0)
+    {}
+    explicit BitSet(size_t size, bool fill=false);
+
+    size_t size() const { return m_size; }
+    bool test(size_t i) const {
+        return (m_words[i / 64] >> (i % 64)) & 1;
+    }
+    void set(size_t i) {
+        m_words[i / 64] |= uint64_t(1) << (i % 64);
+    }
+    void reset(size_t i) {
+        m_words[i / 64] &= ~(uint64_t(1) << (i % 64));
+    }
+    void set_all();
+    void clear();
+    bool any() const;
+
+    /// Union with `x`, returns true if any bits were added
+    bool union_with(const BitSet& x);
+    /// Intersection with `x`, returns true if any bits were removed
+    bool intersect_with(const BitSet& x);
+    /// Remove all bits set in `x`
+    void subtract(const BitSet& x);
+
+    bool operator==(const BitSet& x) const { return m_words == x.m_words; }
+    bool operator!=(const BitSet& x) const { return m_words != x.m_words; }
+
+    template<typename Cb>
+    void for_each(Cb cb) const {
+        for(size_t w = 0; w < m_words.size(); w ++)
+        {
+            for(uint64_t v = m_words[w], i = w * 64; v != 0; v >>= 1, i ++)
+            {
+                if( v & 1 )
+                    cb(static_cast<size_t>(i));
+            }
+        }
+    }
+};
+
+/// Control-flow edges between the blocks of a function
+struct BlockGraph
+{
+    ::std::vector< ::std::vector<BasicBlockId> >    succs;
+    ::std::vector< ::std::vector<BasicBlockId> >    preds;
+    /// Blocks reachable from the entry, in reverse post-order
+    ::std::vector<BasicBlockId> rpo;
+    ::std::vector<bool> reachable;
+
+    BlockGraph(const ::MIR::Function& fcn);
+};
+
+/// Immediate dominators of the reachable blocks
+struct DominatorTree
+{
+    static const BasicBlockId NONE = ~0u;
+    /// Immediate dominator of each block (the entry block is its own, unreachable blocks have `NONE`)
+    ::std::vector<BasicBlockId> idom;
+    /// Blocks immediately dominated by each block
+    ::std::vector< ::std::vector<BasicBlockId> >    children;
+
+    DominatorTree(const BlockGraph& graph);
+
+    /// Returns true if every path from the entry to `b` passes through `a` (including `a == b`)
+    bool dominates(BasicBlockId a, BasicBlockId b) const;
+};
+
+enum class Direction {
+    Forward,
+    Backward,
+};
+enum class Meet {
+    Union,  // "May" analyses (e.g. liveness)
+    Intersect,  // "Must" analyses (e.g. available values)
+};
+
+/// A gen/kill dataflow problem, each block's transfer function is `out = gen | (in & ~kill)`
+/// (where `in`/`out` are in the direction of the analysis)
+struct Problem
+{
+    Direction   dir;
+    Meet    meet;
+    /// State at the function entry (forward), or after any exiting block (backward)
+    BitSet  boundary;
+    ::std::vector<BitSet>   gen;
+    ::std::vector<BitSet>   kill;
+};
+/// Solved state at block boundaries, in execution order (`entry` is the state before the first statement)
+/// - For forward problems, unreachable blocks have an empty state
+struct Solution
+{
+    ::std::vector<BitSet>   entry;
+    ::std::vector<BitSet>   exit;
+};
+
+/// Solve a gen/kill problem (each block is re-visited only when its input changes)
+extern Solution solve(const BlockGraph& graph, const Problem& problem);
+
+
+/// Liveness of locals (backwards, union)
+/// - A local is only killed by an assignment of the entire local, partial writes count as uses.
+/// - Locals that are borrowed anywhere in the function are never considered dead, as the borrow may be used later.
+class Liveness
+{
+public:
+    BitSet  borrowed;
+    Solution    sol;
+
+    Liveness(const ::MIR::Function& fcn, const BlockGraph& graph);
+
+    bool is_live(const BitSet& live, unsigned local) const {
+        return borrowed.test(local) || live.test(local);
+    }
+    /// Update `live` from the state after the statement/terminator to the state before it
+    void step_back(const ::MIR::Statement& stmt, BitSet& live) const;
+    void step_back(const ::MIR::Terminator& term, BitSet& live) const;
+};
+
+/// Tracks `Local(N) = Use(lv)` copies through a sequence of statements, dropping entries when either side changes
+/// - Reads through pointers (and of statics or borrowed locals) are invalidated by anything that may write memory
+class CopyTracker
+{
+public:
+    struct Entry {
+        unsigned    dst;
+        const ::MIR::LValue*    src;
+        unsigned    tag;
+        bool    live;
+    };
+private:
+    const BitSet&   m_borrowed;
+    ::std::vector<Entry>    m_entries;
+    ::std::vector<unsigned> m_by_dst;   // local -> entry index + 1
+    ::std::vector< ::std::vector<unsigned> > m_by_slot;   // slot -> entries with a source that reads that slot
+    ::std::vector<unsigned> m_memory;   // entries with a source that reads memory
+    ::std::vector<unsigned> m_touched_slots;
+public:
+    CopyTracker(const ::MIR::Function& fcn, const BitSet& borrowed);
+
+    /// Record a copy (the `src` pointer must remain valid while the entry is live)
+    void add(unsigned dst, const ::MIR::LValue& src, unsigned tag);
+    /// Live entry for the given local (nullptr if there isn't one)
+    const Entry* get(unsigned local) const {
+        auto i = local < m_by_dst.size() ? m_by_dst[local] : 0;
+        return i == 0 ? nullptr : &m_entries[i-1];
+    }
+    void remove(unsigned local);
+    template<typename Cb>
+    void for_each_live(Cb cb) const {
+        for(const auto& e : m_entries)
+            if( e.live )
+                cb(e);
+    }
+    /// Remove all entries
+    void clear();
+
+    /// Apply the invalidations from a statement (before its own value is recorded)
+    void invalidate(const ::MIR::Statement& stmt);
+    /// Apply the invalidations from a terminator's operands (excluding the call's effect on memory)
+    void invalidate(const ::MIR::Terminator& term);
+    /// Invalidate all entries that read memory (e.g. after a call)
+    void clobber_memory();
+private:
+    void kill_slot(unsigned slot, bool is_write);
+};
+
+/// Copies (`Local(N) = Use(lv)`) that are valid on all paths to each block boundary (forwards, intersection)
+class AvailableCopies
+{
+public:
+    struct Copy {
+        BasicBlockId    bb;
+        unsigned    stmt_idx;
+        unsigned    dst;
+        /// The copied value, as it was when the analysis was done (the statement may be modified later)
+        ::MIR::LValue   src;
+    };
+    ::std::vector<Copy> copies;
+    /// Locals that are borrowed anywhere in the function (reads of these are treated as reads of memory)
+    BitSet  borrowed;
+    Solution    sol;
+
+    AvailableCopies(const ::MIR::Function& fcn, const BlockGraph& graph);
+
+    /// Returns true if the statement is a copy that would be recorded
+    static bool is_copy(const ::MIR::Statement& stmt);
+};
+
+}   // namespace dataflow
+}   // namespace MIR
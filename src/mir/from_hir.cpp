@@ -2411,9 +2411,8 @@ namespace {
 
 void HIR_GenerateMIR(::HIR::Crate& crate)
 {
-    ::MIR::OuterVisitor    ov { crate, [&](const auto& res, const auto& p, auto& expr_ptr, const auto& args, const auto& ty){
+    ::MIR::visit_crate_mir_parallel(crate, [&](const auto& res, const auto& p, auto& expr_ptr, const auto& args, const auto& ty){
             expr_ptr.m_mir = LowerMIR(res, p, expr_ptr, ty, args);
-        } };
-    ov.visit_crate(crate);
+        });
 }
 
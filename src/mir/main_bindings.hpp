@@ -19,3 +19,22 @@ extern void MIR_CheckCrate_Full(/*const*/ ::HIR::Crate& crate);
 
 extern void MIR_CleanupCrate(::HIR::Crate& crate);
 extern void MIR_OptimiseCrate(::HIR::Crate& crate, bool minimal_optimisations);
+
+/// Limits for the MIR inliner (costs are roughly lines of generated C)
+struct MIR_InlineOptions
+{
+    // Largest callee that will be inlined (after subtracting the cost of the call), doubled for `#[inline]`
+    unsigned int threshold = 25;
+    // Total cost that can be inlined into a single function
+    unsigned int budget = 300;
+};
+extern MIR_InlineOptions    g_mir_inline_options;
+
+/// `--mir-opt-stats`: Collect per-pass statistics in MIR_OptimiseCrate (printed when it completes)
+struct MIR_OptStatsOptions
+{
+    bool enabled = false;
+    // Number of slowest functions listed
+    unsigned int top_functions = 10;
+};
+extern MIR_OptStatsOptions  g_mir_opt_stats_options;
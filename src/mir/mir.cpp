@@ -6,6 +6,87 @@
  * - MIR (Middle Intermediate Representation) definitions
  */
 #include <mir/mir.hpp>
+#include <mutex>
+#include <cstddef>  // max_align_t
+
+namespace {
+    // Pool allocator for boxed LValue nodes
+    // - Every Field/Deref/Index/Downcast owns a heap-allocated inner LValue, and MIR lowering/optimisation
+    //   creates and destroys millions of them. Nodes are carved from large slabs (which are never released) and
+    //   recycled through a per-thread free list, so these don't go through malloc.
+    // - A thread's free list is handed back to a shared list when the thread exits (workers are short-lived)
+    struct LValuePoolEnt {
+        LValuePoolEnt*  next;
+    };
+    const size_t LVALUE_POOL_SLAB_SIZE = 1024;
+    const size_t LVALUE_POOL_ENT_SIZE = sizeof(::MIR::LValue) > sizeof(LValuePoolEnt) ? sizeof(::MIR::LValue) : sizeof(LValuePoolEnt);
+
+    ::std::mutex    g_lvalue_pool_lock;
+    LValuePoolEnt*  g_lvalue_pool_head = nullptr;
+
+    struct LValuePool
+    {
+        LValuePoolEnt*  head = nullptr;
+        LValuePoolEnt*  tail = nullptr;
+
+        ~LValuePool() {
+            if( head )
+            {
+                ::std::lock_guard< ::std::mutex>    lh { g_lvalue_pool_lock };
+                tail->next = g_lvalue_pool_head;
+                g_lvalue_pool_head = head;
+            }
+        }
+
+        void push(LValuePoolEnt* e) {
+            e->next = head;
+            if( !head )
+                tail = e;
+            head = e;
+        }
+        void* pop() {
+            if( !head )
+                refill();
+            auto* rv = head;
+            head = rv->next;
+            return rv;
+        }
+        void refill() {
+            {
+                ::std::lock_guard< ::std::mutex>    lh { g_lvalue_pool_lock };
+                head = g_lvalue_pool_head;
+                g_lvalue_pool_head = nullptr;
+            }
+            if( head )
+            {
+                // `tail` isn't tracked for the shared list, find it
+                tail = head;
+                while( tail->next )
+                    tail = tail->next;
+                return ;
+            }
+            // Allocate a new slab, intentionally never freed (nodes can outlive the allocating thread)
+            static_assert(alignof(::MIR::LValue) <= alignof(::std::max_align_t), "LValue is over-aligned");
+            auto* slab = static_cast<char*>( ::operator new(LVALUE_POOL_ENT_SIZE * LVALUE_POOL_SLAB_SIZE) );
+            for(size_t i = LVALUE_POOL_SLAB_SIZE; i --; )
+                push( reinterpret_cast<LValuePoolEnt*>(slab + i * LVALUE_POOL_ENT_SIZE) );
+        }
+    };
+    thread_local LValuePool t_lvalue_pool;
+}
+
+void* MIR::LValue::operator new(size_t size)
+{
+    assert(size == sizeof(LValue));
+    return t_lvalue_pool.pop();
+}
+void MIR::LValue::operator delete(void* ptr, size_t size)
+{
+    if( !ptr )
+        return ;
+    assert(size == sizeof(LValue));
+    t_lvalue_pool.push( static_cast<LValuePoolEnt*>(ptr) );
+}
 
 namespace MIR {
     ::std::ostream& operator<<(::std::ostream& os, const Constant& v) {
@@ -50,6 +50,12 @@ TAGGED_UNION_EX(LValue, (), Return, (
         })
     ), (),(), (
         LValue clone() const;
+
+        // Inner nodes (the targets of the `unique_ptr`s above) are allocated from a pool, see mir.cpp
+        static void* operator new(size_t size);
+        static void operator delete(void* ptr, size_t size);
+        // Placement new (used by the tagged unions that contain a LValue) is hidden by the above
+        static void* operator new(size_t , void* ptr) { return ptr; }
     )
     );
 extern ::std::ostream& operator<<(::std::ostream& os, const LValue& x);
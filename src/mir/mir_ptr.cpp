@@ -7,13 +7,36 @@
  */
 #include "mir_ptr.hpp"
 #include "mir.hpp"
+#include <mutex>
 
+namespace {
+    // Lazy loads are rare, so a single lock is enough
+    ::std::mutex    g_mir_load_lock;
+}
 
 void ::MIR::FunctionPointer::reset()
 {
-    if( this->ptr ) {
-        delete this->ptr;
+    if( auto* p = this->ptr.load() ) {
+        delete p;
         this->ptr = nullptr;
     }
+    if( m_loader ) {
+        delete m_loader;
+        m_loader = nullptr;
+    }
 }
 
+::MIR::Function* ::MIR::FunctionPointer::load() const
+{
+    ::std::lock_guard< ::std::mutex>    lh { g_mir_load_lock };
+    // Another thread may have got here first
+    auto* rv = ptr.load();
+    if( !rv )
+    {
+        rv = m_loader->load();
+        if( m_loader->m_on_load )
+            m_loader->m_on_load(*rv);
+        ptr.store(rv, ::std::memory_order_release);
+    }
+    return rv;
+}
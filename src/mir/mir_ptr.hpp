@@ -6,38 +6,79 @@
  * - Pointer to a blob of MIR
  */
 #pragma once
+#include <atomic>
+#include <functional>
 
 
 namespace MIR {
 
 class Function;
 
+/// Deferred source of a MIR body (e.g. a function from crate metadata that hasn't been used yet)
+class FunctionLoader
+{
+public:
+    /// Run on the function after it has been loaded (e.g. to bind paths in it)
+    ::std::function<void(::MIR::Function&)>   m_on_load;
+
+    virtual ~FunctionLoader() {}
+    virtual ::MIR::Function* load() = 0;
+};
+
 class FunctionPointer
 {
-    ::MIR::Function*    ptr;
+    mutable ::std::atomic< ::MIR::Function*>    ptr;
+    // If non-null, `ptr` is populated from this on first access
+    ::MIR::FunctionLoader*  m_loader;
+
+    ::MIR::Function* get() const {
+        auto* rv = ptr.load(::std::memory_order_acquire);
+        if( !rv && m_loader )
+            rv = load();
+        return rv;
+    }
+    ::MIR::Function* load() const;
 public:
-    FunctionPointer(): ptr(nullptr) {}
-    FunctionPointer(::MIR::Function* p): ptr(p) {}
-    FunctionPointer(FunctionPointer&& x): ptr(x.ptr) { x.ptr = nullptr; }
+    FunctionPointer(): ptr(nullptr), m_loader(nullptr) {}
+    FunctionPointer(::MIR::Function* p): ptr(p), m_loader(nullptr) {}
+    FunctionPointer(::MIR::FunctionLoader* loader): ptr(nullptr), m_loader(loader) {}
+    FunctionPointer(FunctionPointer&& x): ptr(x.ptr.load()), m_loader(x.m_loader) { x.ptr = nullptr; x.m_loader = nullptr; }
 
     ~FunctionPointer() {
         reset();
     }
     FunctionPointer& operator=(FunctionPointer&& x) {
         reset();
-        ptr = x.ptr;
+        ptr = x.ptr.load();
+        m_loader = x.m_loader;
         x.ptr = nullptr;
+        x.m_loader = nullptr;
         return *this;
     }
 
     void reset();
+    /// Take ownership of the (loaded) function
+    ::MIR::Function* release() {
+        auto* rv = get();
+        ptr = nullptr;
+        reset();
+        return rv;
+    }
+
+    /// True if the function is present without having to load it
+    bool is_loaded() const { return ptr.load(::std::memory_order_acquire) != nullptr; }
+    /// Set a callback to run when a not-yet-loaded function is loaded
+    void set_on_load(::std::function<void(::MIR::Function&)> cb) {
+        if( m_loader )
+            m_loader->m_on_load = ::std::move(cb);
+    }
 
-    ::MIR::Function* operator->() { return ptr; }
-    ::MIR::Function& operator*() { return *ptr; }
-    const ::MIR::Function* operator->() const { return ptr; }
-    const ::MIR::Function& operator*() const { return *ptr; }
+    ::MIR::Function* operator->() { return get(); }
+    ::MIR::Function& operator*() { return *get(); }
+    const ::MIR::Function* operator->() const { return get(); }
+    const ::MIR::Function& operator*() const { return *get(); }
 
-    operator bool() const { return ptr != nullptr; }
+    operator bool() const { return ptr.load(::std::memory_order_relaxed) != nullptr || m_loader != nullptr; }
 };
 
 }
@@ -16,6 +16,8 @@ extern void MIR_Validate_Full(const StaticTraitResolve& resolve, const ::HIR::It
 extern void MIR_Cleanup(const StaticTraitResolve& resolve, const ::HIR::ItemPath& path, ::MIR::Function& fcn, const ::HIR::Function::args_t& args, const ::HIR::TypeRef& ret_type);
 // Optimise the MIR
 extern void MIR_Optimise(const StaticTraitResolve& resolve, const ::HIR::ItemPath& path, ::MIR::Function& fcn, const ::HIR::Function::args_t& args, const ::HIR::TypeRef& ret_type);
+// Print (and reset) the statistics collected by MIR_Optimise, if enabled by `--mir-opt-stats`
+extern void MIR_OptimiseStats_Print(::std::ostream& os, const char* title);
 extern void MIR_SortBlocks(const StaticTraitResolve& resolve, const ::HIR::ItemPath& path, ::MIR::Function& fcn);
 
 extern void MIR_Dump_Fcn(::std::ostream& sink, const ::MIR::Function& fcn, unsigned int il=0);
@@ -13,9 +13,14 @@
 #include <mir/helpers.hpp>
 #include <mir/operations.hpp>
 #include <mir/visit_crate_mir.hpp>
+#include <mir/dataflow.hpp>
 #include <algorithm>
 #include <iomanip>
+#include <unordered_map>
+#include <chrono>
+#include <mutex>
 #include <trans/target.hpp>
+#include <thread_pool.hpp>
 
 #include <hir/expr.hpp> // HACK
 
@@ -29,7 +34,79 @@
 #define DUMP_AFTER_DONE     0
 #define CHECK_AFTER_DONE    2   // 1 = Check before GC, 2 = check before and after GC
 
+MIR_InlineOptions   g_mir_inline_options;
+MIR_OptStatsOptions g_mir_opt_stats_options;
+
 namespace {
+    /// While `MIR_OptimiseCrate` runs: functions that are not yet fully optimised (and may be being modified by
+    /// another worker), so must not be inlined.
+    const ::std::set<const ::MIR::Function*>* g_pending_mir = nullptr;
+    /// While `MIR_OptimiseCrate` runs: functions that are part of a cycle in the crate's call graph
+    const ::std::set<const ::MIR::Function*>* g_recursive_mir = nullptr;
+
+    // Inlining cost model (units are roughly "lines of C")
+    const unsigned int INLINE_COST_CALL = 5;
+    const unsigned int INLINE_BONUS_CONST_ARG = 2;
+    // Maximum number of rounds of inlining into a single function (limits the depth of nested inlining)
+    const unsigned int INLINE_MAX_ROUNDS = 8;
+
+    /// Approximate size of a function's generated code, used to decide if it's worth inlining
+    unsigned int MIR_InlineCost(const ::MIR::Function& fcn)
+    {
+        unsigned int rv = 0;
+        for(const auto& bb : fcn.blocks)
+        {
+            for(const auto& stmt : bb.statements)
+            {
+                TU_MATCHA( (stmt), (se),
+                (Assign,
+                    rv += 1;
+                    // Large aggregates are more than one line
+                    if( const auto* e = se.src.opt_Struct() )
+                        rv += e->vals.size() / 4;
+                    else if( const auto* e = se.src.opt_Tuple() )
+                        rv += e->vals.size() / 4;
+                    else if( const auto* e = se.src.opt_Array() )
+                        rv += e->vals.size() / 4;
+                    ),
+                (Asm,
+                    rv += 10;
+                    ),
+                (SetDropFlag,
+                    ),
+                (Drop,
+                    rv += 2;
+                    ),
+                (ScopeEnd,
+                    )
+                )
+            }
+            TU_MATCHA( (bb.terminator), (te),
+            (Incomplete, ),
+            (Return, ),
+            (Diverge, ),
+            (Goto, ),
+            (Panic,
+                rv += 1;
+                ),
+            (If,
+                rv += 1;
+                ),
+            (Switch,
+                rv += 1 + te.targets.size() / 2;
+                ),
+            (SwitchValue,
+                rv += 1 + te.targets.size() / 2;
+                ),
+            (Call,
+                // Intrinsics become a single expression
+                rv += te.fcn.is_Intrinsic() ? 1 : INLINE_COST_CALL;
+                )
+            )
+        }
+        return rv;
+    }
+
     ::MIR::BasicBlockId get_new_target(const ::MIR::TypeResolve& state, ::MIR::BasicBlockId bb)
     {
         const auto& target = state.get_block(bb);
@@ -281,7 +358,8 @@ namespace {
             return monomorphise_type_get_cb(sp, self_ty, &impl_params, fcn_params, nullptr);
         }
     };
-    const ::MIR::Function* get_called_mir(const ::MIR::TypeResolve& state, const ::HIR::Path& path, ParamsSet& params)
+    // Locate the MIR for a called function (if available), `out_fcn` is set to the function's HIR definition
+    const ::MIR::Function* get_called_mir(const ::MIR::TypeResolve& state, const ::HIR::Path& path, ParamsSet& params, const ::HIR::Function** out_fcn=nullptr)
     {
         TU_MATCHA( (path.m_data), (pe),
         (Generic,
@@ -289,6 +367,7 @@ namespace {
             if( fcn.m_code.m_mir )
             {
                 params.fcn_params = &pe.m_params;
+                if(out_fcn) *out_fcn = &fcn;
                 return &*fcn.m_code.m_mir;
             }
             ),
@@ -362,13 +441,19 @@ namespace {
                 params.impl_params.m_types = mv$(best_impl_params);
                 DEBUG("Found impl" << impl.m_params.fmt_args() << " " << impl.m_type);
                 if( fit->second.data.m_code.m_mir )
+                {
+                    if(out_fcn) *out_fcn = &fit->second.data;
                     return &*fit->second.data.m_code.m_mir;
+                }
             }
             else
             {
                 params.impl_params = pe.trait.m_params.clone();
                 if( ve.m_code.m_mir )
+                {
+                    if(out_fcn) *out_fcn = &ve;
                     return &*ve.m_code.m_mir;
+                }
             }
             return nullptr;
             ),
@@ -393,6 +478,7 @@ namespace {
                 params.self_ty = &*pe.type;
                 params.fcn_params = &pe.params;
                 params.impl_params = pe.impl_params.clone();
+                if(out_fcn) *out_fcn = &fit->second.data;
                 return &*fit->second.data.m_code.m_mir;
             }
             return nullptr;
@@ -492,14 +578,234 @@ namespace {
     }
 }
 
+// --------------------------------------------------------------------
+// `--mir-opt-stats` - Per-pass timing and change counts
+// --------------------------------------------------------------------
+namespace {
+    enum class OptPass {
+        BlockSimplify,
+        ConstPropagate,
+        ValueNumbering,
+        DeTemporary,
+        SplitAggregates,
+        PropagateKnownValues,
+        PropagateSingleAssignments,
+        CommonStatements,
+        UnifyBlocks,
+        DeadDropFlags,
+        DeadAssignments,
+        Inlining,
+        Cleanup,    // MIR_Cleanup after inlining
+        GarbageCollect_Partial,
+        UnifyTemporaries,
+        GarbageCollect,
+        SortBlocks,
+        Validate,
+    };
+    const char* const OPT_PASS_NAMES[] = {
+        "BlockSimplify",
+        "ConstPropagate",
+        "ValueNumbering",
+        "DeTemporary",
+        "SplitAggregates",
+        "PropagateKnownValues",
+        "PropagateSingleAssignments",
+        "CommonStatements",
+        "UnifyBlocks",
+        "DeadDropFlags",
+        "DeadAssignments",
+        "Inlining",
+        "Cleanup",
+        "GarbageCollect_Partial",
+        "UnifyTemporaries",
+        "GarbageCollect",
+        "SortBlocks",
+        "Validate",
+    };
+    const size_t NUM_OPT_PASSES = sizeof(OPT_PASS_NAMES) / sizeof(OPT_PASS_NAMES[0]);
+
+    struct PassStats
+    {
+        double  time_s = 0;
+        size_t  runs = 0;
+        size_t  changes = 0;
+        // Net counts (negative if the pass added blocks/statements, e.g. inlining)
+        long long   blocks_removed = 0;
+        long long   stmts_removed = 0;
+
+        void add(const PassStats& x) {
+            time_s += x.time_s;
+            runs += x.runs;
+            changes += x.changes;
+            blocks_removed += x.blocks_removed;
+            stmts_removed += x.stmts_removed;
+        }
+    };
+    struct FunctionStats
+    {
+        double  time_s;
+        unsigned int    iterations;
+        size_t  blocks_before;
+        size_t  blocks_after;
+        ::std::string   name;
+    };
+    struct {
+        ::std::mutex    lock;
+        PassStats   passes[NUM_OPT_PASSES];
+        ::std::vector<FunctionStats>    functions;
+    } g_opt_stats;
+
+    /// Statistics for the optimisation of a single function, merged into `g_opt_stats` by `finish`
+    /// - Does nothing (other than calling the pass) if `--mir-opt-stats` wasn't passed
+    class OptStatsCollector
+    {
+        typedef ::std::chrono::steady_clock clock;
+
+        const ::MIR::Function&  m_fcn;
+        bool    m_enabled;
+        clock::time_point   m_start;
+        size_t  m_blocks_before = 0;
+        PassStats   m_passes[NUM_OPT_PASSES];
+    public:
+        unsigned int iterations = 0;
+
+        OptStatsCollector(const ::MIR::Function& fcn):
+            m_fcn(fcn),
+            m_enabled(g_mir_opt_stats_options.enabled)
+        {
+            if( m_enabled )
+            {
+                m_start = clock::now();
+                m_blocks_before = count_blocks();
+            }
+        }
+
+        /// Run a pass, recording the time taken and the change in the function's size
+        template<typename Fcn>
+        bool run(OptPass pass, Fcn f)
+        {
+            if( !m_enabled )
+                return f();
+            auto blocks = count_blocks();
+            auto stmts = count_statements();
+            auto start = clock::now();
+            bool rv = f();
+            auto& ps = m_passes[static_cast<int>(pass)];
+            ps.time_s += ::std::chrono::duration<double>(clock::now() - start).count();
+            ps.runs += 1;
+            ps.changes += (rv ? 1 : 0);
+            ps.blocks_removed += static_cast<long long>(blocks) - static_cast<long long>(count_blocks());
+            ps.stmts_removed += static_cast<long long>(stmts) - static_cast<long long>(count_statements());
+            return rv;
+        }
+
+        void finish(const ::HIR::ItemPath& path)
+        {
+            if( !m_enabled )
+                return ;
+            FunctionStats   fs {
+                ::std::chrono::duration<double>(clock::now() - m_start).count(),
+                iterations,
+                m_blocks_before,
+                count_blocks(),
+                FMT(path)
+                };
+            ::std::lock_guard< ::std::mutex>    lh { g_opt_stats.lock };
+            for(size_t i = 0; i < NUM_OPT_PASSES; i ++)
+                g_opt_stats.passes[i].add(m_passes[i]);
+            g_opt_stats.functions.push_back( mv$(fs) );
+        }
+    private:
+        size_t count_blocks() const {
+            size_t rv = 0;
+            for(const auto& bb : m_fcn.blocks)
+                if( bb.terminator.tag() != ::MIR::Terminator::TAGDEAD && !bb.terminator.is_Incomplete() )
+                    rv += 1;
+            return rv;
+        }
+        size_t count_statements() const {
+            size_t rv = 0;
+            for(const auto& bb : m_fcn.blocks)
+                rv += bb.statements.size();
+            return rv;
+        }
+    };
+
+}
+
+void MIR_OptimiseStats_Print(::std::ostream& os, const char* title)
+{
+    if( !g_mir_opt_stats_options.enabled )
+        return ;
+    ::std::lock_guard< ::std::mutex>    lh { g_opt_stats.lock };
+    auto& functions = g_opt_stats.functions;
+    if( functions.empty() )
+        return ;
+    auto saved_flags = os.flags();
+    auto saved_precision = os.precision();
+
+    double  total_time = 0;
+    unsigned int    max_iterations = 0;
+    ::std::map<unsigned int, size_t>    iteration_counts;
+    for(const auto& f : functions)
+    {
+        total_time += f.time_s;
+        max_iterations = ::std::max(max_iterations, f.iterations);
+        iteration_counts[f.iterations] += 1;
+    }
+    os << title << ": " << functions.size() << " functions, "
+        << ::std::fixed << ::std::setprecision(3) << total_time << " s (summed over all threads)" << ::std::endl;
+    os << "Fixpoint iterations: max " << max_iterations << " -";
+    for(const auto& ic : iteration_counts)
+        os << " " << ic.first << ":" << ic.second;
+    os << ::std::endl;
+
+    // Passes, slowest first
+    ::std::vector<size_t>   order;
+    for(size_t i = 0; i < NUM_OPT_PASSES; i ++)
+        if( g_opt_stats.passes[i].runs > 0 )
+            order.push_back(i);
+    ::std::sort(order.begin(), order.end(), [&](size_t a, size_t b){ return g_opt_stats.passes[a].time_s > g_opt_stats.passes[b].time_s; });
+    os << ::std::left << ::std::setw(28) << "Pass" << ::std::right
+        << ::std::setw(10) << "Time (s)" << ::std::setw(10) << "Runs" << ::std::setw(10) << "Changes"
+        << ::std::setw(12) << "Blocks -" << ::std::setw(12) << "Stmts -" << ::std::endl;
+    for(auto i : order)
+    {
+        const auto& ps = g_opt_stats.passes[i];
+        os << ::std::left << ::std::setw(28) << OPT_PASS_NAMES[i] << ::std::right
+            << ::std::setw(10) << ps.time_s << ::std::setw(10) << ps.runs << ::std::setw(10) << ps.changes
+            << ::std::setw(12) << ps.blocks_removed << ::std::setw(12) << ps.stmts_removed << ::std::endl;
+    }
+
+    // Slowest functions
+    size_t n_top = ::std::min(functions.size(), static_cast<size_t>(g_mir_opt_stats_options.top_functions));
+    ::std::partial_sort(functions.begin(), functions.begin() + n_top, functions.end(), [](const FunctionStats& a, const FunctionStats& b){ return a.time_s > b.time_s; });
+    if( n_top > 0 )
+        os << "Slowest functions:" << ::std::endl;
+    for(size_t i = 0; i < n_top; i ++)
+    {
+        const auto& f = functions[i];
+        os << ::std::setw(10) << f.time_s << " s " << ::std::setw(4) << f.iterations << " iterations "
+            << ::std::setw(6) << f.blocks_before << " -> " << ::std::left << ::std::setw(6) << f.blocks_after << ::std::right << " blocks  "
+            << f.name << ::std::endl;
+    }
+    os.flags(saved_flags);
+    os.precision(saved_precision);
+
+    for(auto& ps : g_opt_stats.passes)
+        ps = PassStats();
+    functions.clear();
+}
+
 bool MIR_Optimise_BlockSimplify(::MIR::TypeResolve& state, ::MIR::Function& fcn);
-bool MIR_Optimise_Inlining(::MIR::TypeResolve& state, ::MIR::Function& fcn, bool minimal);
+bool MIR_Optimise_Inlining(::MIR::TypeResolve& state, ::MIR::Function& fcn, bool minimal, unsigned int& budget);
 bool MIR_Optimise_SplitAggregates(::MIR::TypeResolve& state, ::MIR::Function& fcn);
 bool MIR_Optimise_PropagateSingleAssignments(::MIR::TypeResolve& state, ::MIR::Function& fcn);
 bool MIR_Optimise_PropagateKnownValues(::MIR::TypeResolve& state, ::MIR::Function& fcn);
 bool MIR_Optimise_DeTemporary(::MIR::TypeResolve& state, ::MIR::Function& fcn); // Eliminate useless temporaries
 bool MIR_Optimise_UnifyTemporaries(::MIR::TypeResolve& state, ::MIR::Function& fcn);
 bool MIR_Optimise_CommonStatements(::MIR::TypeResolve& state, ::MIR::Function& fcn);
+bool MIR_Optimise_ValueNumbering(::MIR::TypeResolve& state, ::MIR::Function& fcn);
 bool MIR_Optimise_UnifyBlocks(::MIR::TypeResolve& state, ::MIR::Function& fcn);
 bool MIR_Optimise_ConstPropagte(::MIR::TypeResolve& state, ::MIR::Function& fcn);
 bool MIR_Optimise_DeadDropFlags(::MIR::TypeResolve& state, ::MIR::Function& fcn);
@@ -508,7 +814,6 @@ bool MIR_Optimise_GarbageCollect_Partial(::MIR::TypeResolve& state, ::MIR::Funct
 bool MIR_Optimise_GarbageCollect(::MIR::TypeResolve& state, ::MIR::Function& fcn);
 
 /// A minimum set of optimisations:
-/// - Inlines `#[inline(always)]` functions
 /// - Simplifies the call graph (by removing chained gotos)
 /// - Sorts blocks into a rough flow order
 void MIR_OptimiseMin(const StaticTraitResolve& resolve, const ::HIR::ItemPath& path, ::MIR::Function& fcn, const ::HIR::Function::args_t& args, const ::HIR::TypeRef& ret_type)
@@ -516,28 +821,32 @@ void MIR_OptimiseMin(const StaticTraitResolve& resolve, const ::HIR::ItemPath& p
     static Span sp;
     TRACE_FUNCTION_F(path);
     ::MIR::TypeResolve   state { sp, resolve, FMT_CB(ss, ss << path;), ret_type, args, fcn };
+    OptStatsCollector   stats { fcn };
+    auto validate = [&]() { stats.run(OptPass::Validate, [&]{ MIR_Validate(resolve, path, fcn, args, ret_type); return false; }); };
 
-    while( MIR_Optimise_Inlining(state, fcn, true) )
+    unsigned int inline_budget = g_mir_inline_options.budget;
+    for(unsigned int round = 0; round < INLINE_MAX_ROUNDS && stats.run(OptPass::Inlining, [&]{ return MIR_Optimise_Inlining(state, fcn, true, inline_budget); }); round ++)
     {
-        MIR_Cleanup(resolve, path, fcn, args, ret_type);
+        stats.run(OptPass::Cleanup, [&]{ MIR_Cleanup(resolve, path, fcn, args, ret_type); return false; });
         //MIR_Dump_Fcn(::std::cout, fcn);
         #if CHECK_AFTER_ALL
-        MIR_Validate(resolve, path, fcn, args, ret_type);
+        validate();
         #endif
     }
 
-    MIR_Optimise_BlockSimplify(state, fcn);
-    MIR_Optimise_UnifyBlocks(state, fcn);
+    stats.run(OptPass::BlockSimplify, [&]{ return MIR_Optimise_BlockSimplify(state, fcn); });
+    stats.run(OptPass::UnifyBlocks, [&]{ return MIR_Optimise_UnifyBlocks(state, fcn); });
 
     //MIR_Optimise_GarbageCollect_Partial(state, fcn);
 
-    MIR_Optimise_GarbageCollect(state, fcn);
+    stats.run(OptPass::GarbageCollect, [&]{ return MIR_Optimise_GarbageCollect(state, fcn); });
     //MIR_Validate_Full(resolve, path, fcn, args, ret_type);
-    MIR_SortBlocks(resolve, path, fcn);
+    stats.run(OptPass::SortBlocks, [&]{ MIR_SortBlocks(resolve, path, fcn); return false; });
 
 #if CHECK_AFTER_DONE > 1
-    MIR_Validate(resolve, path, fcn, args, ret_type);
+    validate();
 #endif
+    stats.finish(path);
     return ;
 }
 void MIR_Optimise(const StaticTraitResolve& resolve, const ::HIR::ItemPath& path, ::MIR::Function& fcn, const ::HIR::Function::args_t& args, const ::HIR::TypeRef& ret_type)
@@ -545,9 +854,14 @@ void MIR_Optimise(const StaticTraitResolve& resolve, const ::HIR::ItemPath& path
     static Span sp;
     TRACE_FUNCTION_F(path);
     ::MIR::TypeResolve   state { sp, resolve, FMT_CB(ss, ss << path;), ret_type, args, fcn };
+    OptStatsCollector   stats { fcn };
+    auto validate = [&]() { stats.run(OptPass::Validate, [&]{ MIR_Validate(resolve, path, fcn, args, ret_type); return false; }); };
+    #define RUN_PASS(name, ...) stats.run(OptPass::name, [&]{ return MIR_Optimise_##name(__VA_ARGS__); })
 
     bool change_happened;
     unsigned int pass_num = 0;
+    unsigned int inline_budget = g_mir_inline_options.budget;
+    unsigned int inline_rounds = 0;
     do
     {
         MIR_ASSERT(state, pass_num < 100, "Too many MIR optimisation iterations");
@@ -556,32 +870,38 @@ void MIR_Optimise(const StaticTraitResolve& resolve, const ::HIR::ItemPath& path
         TRACE_FUNCTION_FR("Pass " << pass_num, change_happened);
 
         // >> Simplify call graph (removes gotos to blocks with a single use)
-        MIR_Optimise_BlockSimplify(state, fcn);
+        RUN_PASS(BlockSimplify, state, fcn);
 
         // >> Apply known constants
-        change_happened |= MIR_Optimise_ConstPropagte(state, fcn);
+        change_happened |= stats.run(OptPass::ConstPropagate, [&]{ return MIR_Optimise_ConstPropagte(state, fcn); });
         #if CHECK_AFTER_ALL
-        MIR_Validate(resolve, path, fcn, args, ret_type);
+        validate();
+        #endif
+
+        // >> Replace repeated computations with the earlier result
+        change_happened |= RUN_PASS(ValueNumbering, state, fcn);
+        #if CHECK_AFTER_ALL
+        validate();
         #endif
 
         // Attempt to remove useless temporaries
-        while( MIR_Optimise_DeTemporary(state, fcn) )
+        while( RUN_PASS(DeTemporary, state, fcn) )
         {
             change_happened = true;
         }
 #if CHECK_AFTER_ALL
-        MIR_Validate(resolve, path, fcn, args, ret_type);
+        validate();
 #endif
 
         // TODO: Split apart aggregates (just tuples?) where it's never used
         // as an aggregate. (Written once, never used directly)
-        change_happened |= MIR_Optimise_SplitAggregates(state, fcn);
+        change_happened |= RUN_PASS(SplitAggregates, state, fcn);
 
         // >> Replace values from composites if they're known
         //   - Undoes the inefficiencies from the `match (a, b) { ... }` pattern
-        change_happened |= MIR_Optimise_PropagateKnownValues(state, fcn);
+        change_happened |= RUN_PASS(PropagateKnownValues, state, fcn);
 #if CHECK_AFTER_ALL
-        MIR_Validate(resolve, path, fcn, args, ret_type);
+        validate();
 #endif
 
         // TODO: Convert `&mut *mut_foo` into `mut_foo` if the source is movable and not used afterwards
@@ -590,39 +910,40 @@ void MIR_Optimise(const StaticTraitResolve& resolve, const ::HIR::ItemPath& path
         if( debug_enabled() ) MIR_Dump_Fcn(::std::cout, fcn);
 #endif
         // >> Propagate/remove dead assignments
-        while( MIR_Optimise_PropagateSingleAssignments(state, fcn) )
+        while( RUN_PASS(PropagateSingleAssignments, state, fcn) )
             change_happened = true;
 #if CHECK_AFTER_ALL
-        MIR_Validate(resolve, path, fcn, args, ret_type);
+        validate();
 #endif
 
         // >> Move common statements (assignments) across gotos.
-        change_happened |= MIR_Optimise_CommonStatements(state, fcn);
+        change_happened |= RUN_PASS(CommonStatements, state, fcn);
 
         // >> Combine Duplicate Blocks
-        change_happened |= MIR_Optimise_UnifyBlocks(state, fcn);
+        change_happened |= RUN_PASS(UnifyBlocks, state, fcn);
         // >> Remove assignments of unsed drop flags
-        change_happened |= MIR_Optimise_DeadDropFlags(state, fcn);
+        change_happened |= RUN_PASS(DeadDropFlags, state, fcn);
         // >> Remove assignments that are never read
-        change_happened |= MIR_Optimise_DeadAssignments(state, fcn);
+        change_happened |= RUN_PASS(DeadAssignments, state, fcn);
 
         #if CHECK_AFTER_ALL
-        MIR_Validate(resolve, path, fcn, args, ret_type);
+        validate();
         #endif
 
         // >> Inline short functions
-        if( !change_happened )
+        if( !change_happened && inline_rounds < INLINE_MAX_ROUNDS )
         {
-            bool inline_happened = MIR_Optimise_Inlining(state, fcn, false);
+            inline_rounds += 1;
+            bool inline_happened = RUN_PASS(Inlining, state, fcn, false, inline_budget);
             if( inline_happened )
             {
                 // Apply cleanup again (as monomorpisation in inlining may have exposed a vtable call)
-                MIR_Cleanup(resolve, path, fcn, args, ret_type);
+                stats.run(OptPass::Cleanup, [&]{ MIR_Cleanup(resolve, path, fcn, args, ret_type); return false; });
                 //MIR_Dump_Fcn(::std::cout, fcn);
                 change_happened = true;
             }
             #if CHECK_AFTER_ALL
-            MIR_Validate(resolve, path, fcn, args, ret_type);
+            validate();
             #endif
         }
 
@@ -634,22 +955,23 @@ void MIR_Optimise(const StaticTraitResolve& resolve, const ::HIR::ItemPath& path
             }
             #endif
             #if CHECK_AFTER_PASS && !CHECK_AFTER_ALL
-            MIR_Validate(resolve, path, fcn, args, ret_type);
+            validate();
             #endif
         }
 
-        MIR_Optimise_GarbageCollect_Partial(state, fcn);
+        RUN_PASS(GarbageCollect_Partial, state, fcn);
         pass_num += 1;
     } while( change_happened );
+    stats.iterations = pass_num;
 
     // Run UnifyTemporaries last, then unify blocks, then run some
     // optimisations that might be affected
-    if(MIR_Optimise_UnifyTemporaries(state, fcn))
+    if( RUN_PASS(UnifyTemporaries, state, fcn) )
     {
 #if CHECK_AFTER_ALL
-        MIR_Validate(resolve, path, fcn, args, ret_type);
+        validate();
 #endif
-        MIR_Optimise_UnifyBlocks(state, fcn);
+        RUN_PASS(UnifyBlocks, state, fcn);
         //MIR_Optimise_ConstPropagte(state, fcn);
     }
 
@@ -661,18 +983,20 @@ void MIR_Optimise(const StaticTraitResolve& resolve, const ::HIR::ItemPath& path
     #endif
     #if CHECK_AFTER_DONE
     // DEFENCE: Run validation _before_ GC (so validation errors refer to the pre-gc numbers)
-    MIR_Validate(resolve, path, fcn, args, ret_type);
+    validate();
     #endif
     // GC pass on blocks and variables
     // - Find unused blocks, then delete and rewrite all references.
-    MIR_Optimise_GarbageCollect(state, fcn);
+    RUN_PASS(GarbageCollect, state, fcn);
 
     //MIR_Validate_Full(resolve, path, fcn, args, ret_type);
 
-    MIR_SortBlocks(resolve, path, fcn);
+    stats.run(OptPass::SortBlocks, [&]{ MIR_SortBlocks(resolve, path, fcn); return false; });
 #if CHECK_AFTER_DONE > 1
-    MIR_Validate(resolve, path, fcn, args, ret_type);
+    validate();
 #endif
+    stats.finish(path);
+    #undef RUN_PASS
 }
 
 // --------------------------------------------------------------------
@@ -768,70 +1092,62 @@ bool MIR_Optimise_BlockSimplify(::MIR::TypeResolve& state, ::MIR::Function& fcn)
 
 
 // --------------------------------------------------------------------
-// If two temporaries don't overlap in lifetime (blocks in which they're valid), unify the two
+// Inline calls to small (or `#[inline(always)]`) functions
+// - `minimal` disables inlining
+// - `budget` is the remaining amount of code (see `MIR_InlineCost`) that can be inlined into this function
 // --------------------------------------------------------------------
-bool MIR_Optimise_Inlining(::MIR::TypeResolve& state, ::MIR::Function& fcn, bool minimal)
+bool MIR_Optimise_Inlining(::MIR::TypeResolve& state, ::MIR::Function& fcn, bool minimal, unsigned int& budget)
 {
     bool inline_happened = false;
     TRACE_FUNCTION_FR("", inline_happened);
 
-    struct H
-    {
-        static bool can_inline(const ::HIR::Path& path, const ::MIR::Function& fcn, bool minimal)
+    // Decide if a call should be inlined, returns the cost to charge against the budget
+    auto should_inline = [&](const ::MIR::Terminator::Data_Call& te, const ::HIR::Function* hir_fcn, const ::MIR::Function& callee, unsigned int& out_cost)->bool {
+        if( minimal )
+            return false;
+        auto hint = hir_fcn ? hir_fcn->m_inline : ::HIR::Function::InlineHint::None;
+        if( hint == ::HIR::Function::InlineHint::Never )
         {
-            // TODO: If the function is marked as `inline(always)`, then inline it regardless of the contents
-
-            if( minimal ) {
+            DEBUG("#[inline(never)]");
+            return false;
+        }
+        // Recursive functions are never inlined (would just produce a copy of the call), even if `#[inline(always)]`
+        if( g_recursive_mir && g_recursive_mir->count(&callee) )
+        {
+            DEBUG("Recursive");
+            return false;
+        }
+        if( hint == ::HIR::Function::InlineHint::Always )
+        {
+            // Ignores the size threshold, but not the budget (which also bounds recursion that isn't known above)
+            auto cost = MIR_InlineCost(callee);
+            DEBUG("#[inline(always)] cost=" << cost << ", budget=" << budget);
+            if( cost > budget )
                 return false;
-            }
+            out_cost = cost;
+            return true;
+        }
 
-            // TODO: If the function is marked as `inline(never)`, then don't inline
+        // Cost model: The callee's size, less the call that it replaces, less a bonus for each constant argument
+        // (which are likely to be propagated into the inlined code, e.g. the ordering argument to atomic wrappers)
+        auto cost = MIR_InlineCost(callee);
+        unsigned int benefit = INLINE_COST_CALL;
+        for(const auto& a : te.args)
+            if( a.is_Constant() )
+                benefit += INLINE_BONUS_CONST_ARG;
+        auto net = cost > benefit ? cost - benefit : 0;
+        auto threshold = g_mir_inline_options.threshold;
+        if( hint == ::HIR::Function::InlineHint::Hint )
+            threshold *= 2;
+        DEBUG("cost=" << cost << ", net=" << net << ", threshold=" << threshold << ", budget=" << budget);
+        if( net > threshold )
+            return false;
+        if( cost > budget )
+            return false;
+        out_cost = cost;
+        return true;
+        };
 
-            // TODO: Allow functions that are just a switch on an input.
-            if( fcn.blocks.size() == 1 )
-            {
-                return fcn.blocks[0].statements.size() < 10 && ! fcn.blocks[0].terminator.is_Goto();
-            }
-            else if( fcn.blocks.size() == 3 && fcn.blocks[0].terminator.is_Call() )
-            {
-                const auto& blk0_te = fcn.blocks[0].terminator.as_Call();
-                if( !(fcn.blocks[1].terminator.is_Diverge() || fcn.blocks[1].terminator.is_Return()) )
-                    return false;
-                if( !(fcn.blocks[2].terminator.is_Diverge() || fcn.blocks[2].terminator.is_Return()) )
-                    return false;
-                if( fcn.blocks[0].statements.size() + fcn.blocks[1].statements.size() + fcn.blocks[2].statements.size() > 10 )
-                    return false;
-                // Detect and avoid simple recursion.
-                // - This won't detect mutual recursion - that also needs prevention.
-                if( blk0_te.fcn.is_Path() && blk0_te.fcn.as_Path() == path )
-                    return false;
-                return true;
-            }
-            else if( fcn.blocks.size() > 1 && fcn.blocks[0].terminator.is_Switch() )
-            {
-                // Setup + Arms + Return + Panic
-                // - Handles the atomit wrappers
-                if( fcn.blocks.size() != fcn.blocks[0].terminator.as_Switch().targets.size()+3 )
-                    return false;
-                // TODO: Check for the parameter being a Constant?
-                for(size_t i = 1; i < fcn.blocks.size(); i ++)
-                {
-                    if( fcn.blocks[i].terminator.is_Call() )
-                    {
-                        const auto& te = fcn.blocks[i].terminator.as_Call();
-                        // Recursion, don't inline.
-                        if( te.fcn.is_Path() && te.fcn.as_Path() == path )
-                            return false;
-                    }
-                }
-                return true;
-            }
-            else
-            {
-                return false;
-            }
-        }
-    };
     struct Cloner
     {
         const Span& sp;
@@ -1189,7 +1505,8 @@ bool MIR_Optimise_Inlining(::MIR::TypeResolve& state, ::MIR::Function& fcn, bool
             const auto& path = te->fcn.as_Path();
 
             Cloner  cloner { state.sp, state.m_resolve, *te };
-            const auto* called_mir = get_called_mir(state, path,  cloner.params);
+            const ::HIR::Function*  called_fcn = nullptr;
+            const auto* called_mir = get_called_mir(state, path,  cloner.params, &called_fcn);
             if( !called_mir )
                 continue ;
             if( called_mir == &fcn )
@@ -1197,16 +1514,19 @@ bool MIR_Optimise_Inlining(::MIR::TypeResolve& state, ::MIR::Function& fcn, bool
                 DEBUG("Can't inline - recursion");
                 continue ;
             }
+            if( g_pending_mir && g_pending_mir->count(called_mir) )
+            {
+                DEBUG("Can't inline - not yet optimised");
+                continue ;
+            }
 
-            // Check the size of the target function.
-            // Inline IF:
-            // - First BB ends with a call and total count is 3
-            // - Statement count smaller than 10
-            if( ! H::can_inline(path, *called_mir, minimal) )
+            unsigned int cost = 0;
+            if( ! should_inline(*te, called_fcn, *called_mir, cost) )
             {
-                DEBUG("Can't inline " << path);
+                DEBUG("Not inlining " << path);
                 continue ;
             }
+            budget -= cost;
             DEBUG(state << fcn.blocks[i].terminator);
             TRACE_FUNCTION_F("Inline " << path);
 
@@ -1288,69 +1608,25 @@ bool MIR_Optimise_DeTemporary(::MIR::TypeResolve& state, ::MIR::Function& fcn)
     bool changed = false;
     TRACE_FUNCTION_FR("", changed);
 
+    // Copies (`Local(N) = Use(...)`) that are still valid at the start of each block
+    ::MIR::dataflow::BlockGraph graph(fcn);
+    ::MIR::dataflow::AvailableCopies    available(fcn, graph);
+    ::MIR::dataflow::CopyTracker    tracker(fcn, available.borrowed);
+    // Entries recorded from other blocks, which can only be used for Copy values (as the assignment must stay)
+    const unsigned TAG_OTHER_BLOCK = ~0u;
+
     for(unsigned int bb_idx = 0; bb_idx < fcn.blocks.size(); bb_idx ++)
     {
         auto& bb = fcn.blocks[bb_idx];
-        ::std::map<unsigned,unsigned>   local_assignments;  // Local number -> statement index
         ::std::vector<unsigned> statements_to_remove;   // List of statements that have to be removed
 
-        // ----- Helper closures -----
-        // > Check if a recorded assignment is no longer valid.
-        auto cb_check_invalidate = [&](const ::MIR::LValue& lv, ValUsage vu) {
-                for(auto it = local_assignments.begin(); it != local_assignments.end(); )
-                {
-                    bool invalidated = false;
-                    const auto& src_rvalue = bb.statements[it->second].as_Assign().src;
-
-                    // Destination invalidated?
-                    if( lv.is_Local() && it->first == lv.as_Local() )
-                    {
-                        switch(vu)
-                        {
-                        case ValUsage::Borrow:
-                        case ValUsage::Write:
-                            DEBUG(state << "> Mutate/Borrowed " << lv);
-                            invalidated = true;
-                            break;
-                        default:
-                            break;
-                        }
-                    }
-                    // Source invalidated?
-                    else
-                    {
-                        switch(vu)
-                        {
-                        case ValUsage::Borrow:  // Borrows are annoying, assume they invalidate anything used
-                        case ValUsage::Write:   // Mutated? It's invalidated
-                        case ValUsage::Move:    // Moved? Now invalid
-                            visit_mir_lvalues(src_rvalue, [&](const auto& s_lv, auto /*s_vu*/) {
-                                if( s_lv == lv )
-                                {
-                                    DEBUG(state << "> Invalidates source of Local(" << it->first << ") - " << src_rvalue);
-                                    invalidated = true;
-                                    return true;
-                                }
-                                return false;
-                                });
-                            break;
-                        case ValUsage::Read:    // Read is Ok
-                            break;
-                        }
-                    }
+        tracker.clear();
+        available.sol.entry[bb_idx].for_each([&](size_t i) {
+            const auto& c = available.copies[i];
+            tracker.add(c.dst, c.src, TAG_OTHER_BLOCK);
+            });
 
-                    if( invalidated )
-                    {
-                        it = local_assignments.erase(it);
-                    }
-                    else
-                    {
-                        ++ it;
-                    }
-                }
-                return false;
-            };
-            // ^^^ Check for invalidations
+        // ----- Helper closures -----
         auto cb_apply_replacements = [&](auto& top_lv, auto top_usage) {
             // NOTE: Visits only the top-level LValues
             // - The inner `visit_mir_lvalue_mut` handles sub-values
@@ -1363,29 +1639,31 @@ bool MIR_Optimise_DeTemporary(::MIR::TypeResolve& state, ::MIR::Function& fcn)
             visit_mir_lvalue_mut(top_lv, top_usage, [&](auto& ilv, auto /*i_usage*/) {
                 if( ilv.is_Local() )
                 {
-                    auto it = local_assignments.find(ilv.as_Local());
-                    if( it != local_assignments.end() )
+                    const auto* ent = tracker.get(ilv.as_Local());
+                    if( ent )
                     {
+                        auto local = ilv.as_Local();
                         // - Copy? All is good.
                         if( state.lvalue_is_copy(ilv) )
                         {
-                            ilv = bb.statements[it->second].as_Assign().src.as_Use().clone();
-                            DEBUG(state << "> Replace (and keep) Local(" << it->first << ") with " << ilv);
+                            ilv = ent->src->clone();
+                            DEBUG(state << "> Replace (and keep) Local(" << local << ") with " << ilv);
                         }
                         // - Top-level (directly used) also good.
-                        else if( top_level && top_usage == ValUsage::Move )
+                        else if( top_level && top_usage == ValUsage::Move && ent->tag != TAG_OTHER_BLOCK )
                         {
                             // TODO: DstMeta/DstPtr _doesn't_ move, so shouldn't trigger this.
-                            ilv = bb.statements[it->second].as_Assign().src.as_Use().clone();
-                            DEBUG(state << "> Replace (and remove) Local(" << it->first << ") with " << ilv);
-                            statements_to_remove.push_back( it->second );
-                            local_assignments.erase(it);
+                            auto stmt_idx = ent->tag;
+                            ilv = ent->src->clone();
+                            DEBUG(state << "> Replace (and remove) Local(" << local << ") with " << ilv);
+                            statements_to_remove.push_back( stmt_idx );
+                            tracker.remove(local);
                         }
                         // - Otherwise, remove the record.
                         else
                         {
-                            DEBUG(state << "> Non-copy value used within a LValue, remove record of Local(" << it->first << ")");
-                            local_assignments.erase(it);
+                            DEBUG(state << "> Non-copy value used within a LValue, remove record of Local(" << local << ")");
+                            tracker.remove(local);
                         }
                     }
                 }
@@ -1410,25 +1688,16 @@ bool MIR_Optimise_DeTemporary(::MIR::TypeResolve& state, ::MIR::Function& fcn)
             //  > (meaning that the slot isn't a temporary)
             // - Check if this statement mutates or moves the source
             //  > (thus making it invalid to move the source forwards)
-            visit_mir_lvalues(stmt, cb_check_invalidate);
+            tracker.invalidate(stmt);
 
             // - Apply known relacements
             visit_mir_lvalues_mut(stmt, cb_apply_replacements);
 
             // - Check if this is a new assignment
-            if( stmt.is_Assign() && stmt.as_Assign().dst.is_Local() && stmt.as_Assign().src.is_Use() )
+            if( ::MIR::dataflow::AvailableCopies::is_copy(stmt) )
             {
-                if( visit_mir_lvalue(stmt.as_Assign().src.as_Use(), ValUsage::Read, [&](const auto& lv, auto /*vu*/) {
-                        return lv == stmt.as_Assign().dst;
-                        }) )
-                {
-                    DEBUG(state << "> Don't record, self-referrential");
-                }
-                else
-                {
-                    local_assignments.insert(::std::make_pair( stmt.as_Assign().dst.as_Local(), stmt_idx ));
-                    DEBUG(state << "> Record assignment");
-                }
+                tracker.add(stmt.as_Assign().dst.as_Local(), stmt.as_Assign().src.as_Use(), stmt_idx);
+                DEBUG(state << "> Record assignment");
             }
         } // for(stmt in bb.statements)
 
@@ -1436,7 +1705,7 @@ bool MIR_Optimise_DeTemporary(::MIR::TypeResolve& state, ::MIR::Function& fcn)
         state.set_cur_stmt_term(bb_idx);
         DEBUG(state << bb.terminator);
         // > Check for invalidations (e.g. move of a source value)
-        visit_mir_lvalues(bb.terminator, cb_check_invalidate);
+        tracker.invalidate(bb.terminator);
         // > THEN check for replacements
         if( ! bb.terminator.is_Switch() )
         {
@@ -1471,59 +1740,465 @@ bool MIR_Optimise_CommonStatements(::MIR::TypeResolve& state, ::MIR::Function& f
     {
         state.set_cur_stmt(bb_idx, 0);
 
-        bool skip = false;
-        ::std::vector<size_t>   sources;
-        // Find source blocks
-        for(size_t bb2_idx = 0; bb2_idx < fcn.blocks.size(); bb2_idx ++)
+        bool skip = false;
+        ::std::vector<size_t>   sources;
+        // Find source blocks
+        for(size_t bb2_idx = 0; bb2_idx < fcn.blocks.size(); bb2_idx ++)
+        {
+            const auto& blk = fcn.blocks[bb2_idx];
+            // TODO: Handle non-Goto branches? (e.g. calls)
+            if( blk.terminator.is_Goto() && blk.terminator.as_Goto() == bb_idx )
+            {
+                if( blk.statements.empty() )
+                {
+                    DEBUG(state << " BB" << bb2_idx << " empty");
+                    skip = true;
+                    break ;
+                }
+                if( !sources.empty() )
+                {
+                    if( blk.statements.back() != fcn.blocks[sources.front()].statements.back() )
+                    {
+                        DEBUG(state << " BB" << bb2_idx << " doesn't end with " << fcn.blocks[sources.front()].statements.back() << " instead " << blk.statements.back());
+                        skip = true;
+                        break;
+                    }
+                }
+                sources.push_back(bb2_idx);
+            }
+            else
+            {
+                visit_terminator_target(blk.terminator, [&](const auto& dst_idx) {
+                    if( dst_idx == bb_idx ) {
+                        DEBUG(state << " BB" << bb2_idx << " doesn't end Goto - instead " << blk.terminator);
+                        skip = true;
+                    }
+                });
+            }
+        }
+
+        if( !skip && sources.size() > 1 )
+        {
+            // Found a common assignment, add to the start and remove from sources.
+            auto stmt = ::std::move(fcn.blocks[sources.front()].statements.back());
+            MIR_DEBUG(state, "Move common final statements from " << sources << " to " << bb_idx << " - " << stmt);
+            for(auto idx : sources)
+            {
+                fcn.blocks[idx].statements.pop_back();
+            }
+            fcn.blocks[bb_idx].statements.insert(fcn.blocks[bb_idx].statements.begin(), ::std::move(stmt));
+        }
+    }
+    return changed;
+}
+
+
+// --------------------------------------------------------------------
+// Global value numbering: replace re-computations of a value with a copy of an earlier (dominating) result
+// --------------------------------------------------------------------
+namespace {
+    void gvn_hash_combine(size_t& h, size_t v)
+    {
+        h ^= v + 0x9e3779b9 + (h << 6) + (h >> 2);
+    }
+    size_t gvn_hash_lvalue(const ::MIR::LValue& lv)
+    {
+        size_t  h = static_cast<size_t>(lv.tag());
+        TU_MATCHA( (lv), (e),
+        (Return,
+            ),
+        (Argument,
+            gvn_hash_combine(h, e.idx);
+            ),
+        (Local,
+            gvn_hash_combine(h, e);
+            ),
+        (Static,
+            ),
+        (Field,
+            gvn_hash_combine(h, gvn_hash_lvalue(*e.val));
+            gvn_hash_combine(h, e.field_index);
+            ),
+        (Deref,
+            gvn_hash_combine(h, gvn_hash_lvalue(*e.val));
+            ),
+        (Index,
+            gvn_hash_combine(h, gvn_hash_lvalue(*e.val));
+            gvn_hash_combine(h, gvn_hash_lvalue(*e.idx));
+            ),
+        (Downcast,
+            gvn_hash_combine(h, gvn_hash_lvalue(*e.val));
+            gvn_hash_combine(h, e.variant_index);
+            )
+        )
+        return h;
+    }
+    size_t gvn_hash_param(const ::MIR::Param& p)
+    {
+        if( const auto* lv = p.opt_LValue() )
+            return gvn_hash_lvalue(*lv);
+        const auto& c = p.as_Constant();
+        size_t  h = 0x100 + static_cast<size_t>(c.tag());
+        TU_MATCH_DEF(::MIR::Constant, (c), (ce),
+        (
+            ),
+        (Int,
+            gvn_hash_combine(h, static_cast<size_t>(ce.v));
+            ),
+        (Uint,
+            gvn_hash_combine(h, static_cast<size_t>(ce.v));
+            ),
+        (Bool,
+            gvn_hash_combine(h, ce.v);
+            )
+        )
+        return h;
+    }
+    // NOTE: Only hashes the rvalues that are considered for numbering (and the type of a cast is left to the equality check)
+    size_t gvn_hash_rvalue(const ::MIR::RValue& rv)
+    {
+        size_t  h = static_cast<size_t>(rv.tag());
+        TU_MATCH_DEF(::MIR::RValue, (rv), (e),
+        (
+            ),
+        (Borrow,
+            gvn_hash_combine(h, static_cast<size_t>(e.type));
+            gvn_hash_combine(h, gvn_hash_lvalue(e.val));
+            ),
+        (Cast,
+            gvn_hash_combine(h, gvn_hash_lvalue(e.val));
+            ),
+        (BinOp,
+            gvn_hash_combine(h, static_cast<size_t>(e.op));
+            gvn_hash_combine(h, gvn_hash_param(e.val_l));
+            gvn_hash_combine(h, gvn_hash_param(e.val_r));
+            ),
+        (UniOp,
+            gvn_hash_combine(h, static_cast<size_t>(e.op));
+            gvn_hash_combine(h, gvn_hash_lvalue(e.val));
+            ),
+        (DstMeta,
+            gvn_hash_combine(h, gvn_hash_lvalue(e.val));
+            ),
+        (DstPtr,
+            gvn_hash_combine(h, gvn_hash_lvalue(e.val));
+            ),
+        (MakeDst,
+            gvn_hash_combine(h, gvn_hash_param(e.ptr_val));
+            gvn_hash_combine(h, gvn_hash_param(e.meta_val));
+            )
+        )
+        return h;
+    }
+    // Total order on parameters (constants first), used to canonicalise commutative operations
+    bool gvn_param_lt(const ::MIR::Param& a, const ::MIR::Param& b)
+    {
+        if( a.tag() != b.tag() )
+            return a.is_Constant();
+        if( a.is_LValue() )
+            return a.as_LValue() < b.as_LValue();
+        return a.as_Constant().ord(b.as_Constant()) == OrdLess;
+    }
+}
+// - Only values computed from locals that are assigned exactly once (and never borrowed) are numbered. The single
+//   assignment dominates all reads of such a local, so a result computed from them is still valid anywhere that
+//   the computation dominates.
+// - Copies between such locals share a value number, so `b = a; x = b + 1; y = a + 1;` finds `y = x`
+bool MIR_Optimise_ValueNumbering(::MIR::TypeResolve& state, ::MIR::Function& fcn)
+{
+    bool changed = false;
+    TRACE_FUNCTION_FR("", changed);
+    static const unsigned NONE = ~0u;
+
+    // Slots are locals then arguments
+    const unsigned n_locals = fcn.locals.size();
+    const unsigned n_slots = n_locals + state.m_args.size();
+    auto get_slot = [&](const ::MIR::LValue& lv)->unsigned {
+        if( lv.is_Local() )
+            return lv.as_Local();
+        if( lv.is_Argument() )
+            return n_locals + lv.as_Argument().idx;
+        return NONE;
+        };
+    auto slot_lvalue = [&](unsigned slot)->::MIR::LValue {
+        if( slot < n_locals )
+            return ::MIR::LValue::make_Local(slot);
+        return ::MIR::LValue::make_Argument({ slot - n_locals });
+        };
+
+    // 1. Find slots that hold a single value for their entire lifetime
+    // - Arguments that are never written, and locals that are only written once (as a whole)
+    // - Neither can be borrowed (writes through the borrow wouldn't be seen)
+    ::std::vector<unsigned> n_writes(n_slots);
+    ::std::vector<bool> is_single(n_slots);
+    {
+        ::std::vector<bool> borrowed(n_slots);
+        ::std::function<void(const ::MIR::LValue&, ValUsage)> use_lvalue = [&](const ::MIR::LValue& lv, ValUsage u) {
+            bool whole = true;
+            const auto* p = &lv;
+            for(;;)
+            {
+                if( const auto* e = p->opt_Field() ) {
+                    p = &*e->val;
+                }
+                else if( const auto* e = p->opt_Downcast() ) {
+                    p = &*e->val;
+                }
+                else if( const auto* e = p->opt_Index() ) {
+                    use_lvalue(*e->idx, ValUsage::Read);
+                    p = &*e->val;
+                }
+                else if( const auto* e = p->opt_Deref() ) {
+                    // The pointer itself is only read
+                    use_lvalue(*e->val, ValUsage::Read);
+                    return ;
+                }
+                else {
+                    break;
+                }
+                whole = false;
+            }
+            auto slot = get_slot(*p);
+            if( slot == NONE )
+                return ;
+            if( u == ValUsage::Write )
+                n_writes[slot] += (whole ? 1 : 2);
+            if( u == ValUsage::Borrow )
+                borrowed[slot] = true;
+            };
+        visit_mir_lvalues(state, fcn, [&](const auto& lv, auto u){ use_lvalue(lv, u); return true; });
+        for(unsigned i = 0; i < n_slots; i ++)
+            is_single[i] = !borrowed[i] && n_writes[i] == (i < n_locals ? 1 : 0);
+    }
+
+    // A value read from single-assignment slots (fields and indexing included)
+    auto value_ok = [&](const ::MIR::LValue& lv)->bool {
+        const auto* p = &lv;
+        for(;;)
+        {
+            if( const auto* e = p->opt_Field() ) {
+                p = &*e->val;
+            }
+            else if( const auto* e = p->opt_Downcast() ) {
+                p = &*e->val;
+            }
+            else if( const auto* e = p->opt_Index() ) {
+                auto idx_slot = get_slot(*e->idx);
+                if( idx_slot == NONE || !is_single[idx_slot] )
+                    return false;
+                p = &*e->val;
+            }
+            else {
+                break;
+            }
+        }
+        auto slot = get_slot(*p);
+        return slot != NONE && is_single[slot];
+        };
+    auto param_ok = [&](const ::MIR::Param& p)->bool {
+        return p.is_Constant() || value_ok(p.as_LValue());
+        };
+    // An address computed from a single-assignment pointer (e.g. `&(*self).field`)
+    // - Borrows of locals aren't numbered, as that would extend the span in which the local is borrowed
+    auto address_ok = [&](const ::MIR::LValue& lv)->bool {
+        const auto* p = &lv;
+        for(;;)
+        {
+            if( const auto* e = p->opt_Field() ) {
+                p = &*e->val;
+            }
+            else if( const auto* e = p->opt_Downcast() ) {
+                p = &*e->val;
+            }
+            else if( const auto* e = p->opt_Index() ) {
+                auto idx_slot = get_slot(*e->idx);
+                if( idx_slot == NONE || !is_single[idx_slot] )
+                    return false;
+                p = &*e->val;
+            }
+            else if( const auto* e = p->opt_Deref() ) {
+                return value_ok(*e->val);
+            }
+            else {
+                return false;
+            }
+        }
+        };
+    auto is_candidate = [&](const ::MIR::Statement::Data_Assign& se)->bool {
+        TU_MATCH_DEF(::MIR::RValue, (se.src), (e),
+        (
+            return false;
+            ),
+        (Borrow,
+            return e.type == ::HIR::BorrowType::Shared && address_ok(e.val);
+            ),
+        (Cast,
+            return value_ok(e.val);
+            ),
+        (BinOp,
+            switch(e.op)
+            {
+            case ::MIR::eBinOp::ADD_OV:
+            case ::MIR::eBinOp::SUB_OV:
+            case ::MIR::eBinOp::MUL_OV:
+            case ::MIR::eBinOp::DIV_OV:
+                return false;
+            default:
+                break;
+            }
+            return param_ok(e.val_l) && param_ok(e.val_r);
+            ),
+        (UniOp,
+            return value_ok(e.val);
+            ),
+        (DstMeta,
+            return value_ok(e.val);
+            ),
+        (DstPtr,
+            return value_ok(e.val);
+            ),
+        (MakeDst,
+            if( !param_ok(e.ptr_val) || !param_ok(e.meta_val) )
+                return false;
+            // Could be a `&mut`, which can't be duplicated
+            ::HIR::TypeRef  tmp;
+            return state.m_resolve.type_is_copy(state.sp, state.get_lvalue_type(tmp, se.dst));
+            )
+        )
+        throw "";
+        };
+
+    // Value number of each slot (the first slot that held the value)
+    ::std::vector<unsigned> leader(n_slots);
+    for(unsigned i = 0; i < n_slots; i ++)
+        leader[i] = i;
+    // Rewrite the rvalue in terms of value numbers, with a stable operand order for commutative operations
+    auto canonicalise = [&](const ::MIR::RValue& rv)->::MIR::RValue {
+        auto key = rv.clone();
+        visit_mir_lvalues_mut(key, [&](::MIR::LValue& lv, ValUsage ) {
+            auto slot = get_slot(lv);
+            if( slot != NONE && leader[slot] != slot )
+                lv = slot_lvalue(leader[slot]);
+            return false;
+            });
+        if( auto* e = key.opt_Borrow() )
+        {
+            e->region = 0;
+        }
+        else if( auto* e = key.opt_BinOp() )
+        {
+            switch(e->op)
+            {
+            case ::MIR::eBinOp::ADD:
+            case ::MIR::eBinOp::MUL:
+            case ::MIR::eBinOp::BIT_OR:
+            case ::MIR::eBinOp::BIT_AND:
+            case ::MIR::eBinOp::BIT_XOR:
+            case ::MIR::eBinOp::EQ:
+            case ::MIR::eBinOp::NE:
+                if( gvn_param_lt(e->val_r, e->val_l) )
+                    ::std::swap(e->val_l, e->val_r);
+                break;
+            default:
+                break;
+            }
+        }
+        return key;
+        };
+
+    // 2. Walk the dominator tree, with a table of the values computed by the dominating statements
+    struct Entry {
+        ::MIR::RValue   key;
+        unsigned    slot;
+    };
+    ::std::unordered_map<size_t, ::std::vector<Entry>>  table;
+    ::std::vector<size_t>   scope_hashes;   // Hashes of the table entries added by the blocks on the current path
+
+    ::MIR::dataflow::BlockGraph graph(fcn);
+    ::MIR::dataflow::DominatorTree  dom(graph);
+    if( graph.rpo.empty() )
+        return false;
+    struct StackEnt {
+        ::MIR::BasicBlockId bb;
+        unsigned    next_child;
+        size_t  scope_start;
+    };
+    ::std::vector<StackEnt> stack;
+    stack.push_back(StackEnt { 0, 0, 0 });
+    for(bool enter = true; !stack.empty(); )
+    {
+        auto& top = stack.back();
+        if( enter )
         {
-            const auto& blk = fcn.blocks[bb2_idx];
-            // TODO: Handle non-Goto branches? (e.g. calls)
-            if( blk.terminator.is_Goto() && blk.terminator.as_Goto() == bb_idx )
+            auto bb = top.bb;
+            auto& block = fcn.blocks[bb];
+            for(auto& stmt : block.statements)
             {
-                if( blk.statements.empty() )
+                state.set_cur_stmt(bb, &stmt - &block.statements.front());
+                if( !stmt.is_Assign() )
+                    continue ;
+                auto& se = stmt.as_Assign();
+                auto dst_slot = get_slot(se.dst);
+                bool dst_single = dst_slot != NONE && is_single[dst_slot];
+
+                // A copy between single-assignment slots shares the value number
+                if( se.src.is_Use() )
                 {
-                    DEBUG(state << " BB" << bb2_idx << " empty");
-                    skip = true;
-                    break ;
+                    auto src_slot = get_slot(se.src.as_Use());
+                    if( dst_single && src_slot != NONE && is_single[src_slot] )
+                        leader[dst_slot] = leader[src_slot];
+                    continue ;
                 }
-                if( !sources.empty() )
+                if( !is_candidate(se) )
+                    continue ;
+
+                auto key = canonicalise(se.src);
+                auto h = gvn_hash_rvalue(key);
+                auto& bucket = table[h];
+                auto it = ::std::find_if(bucket.begin(), bucket.end(), [&](const Entry& e){ return e.key == key; });
+                if( it != bucket.end() )
                 {
-                    if( blk.statements.back() != fcn.blocks[sources.front()].statements.back() )
+                    if( it->slot != dst_slot )
                     {
-                        DEBUG(state << " BB" << bb2_idx << " doesn't end with " << fcn.blocks[sources.front()].statements.back() << " instead " << blk.statements.back());
-                        skip = true;
-                        break;
+                        auto src_lv = slot_lvalue(it->slot);
+                        DEBUG(state << se.dst << " = " << se.src << " - Already in " << src_lv);
+                        se.src = ::MIR::RValue::make_Use(mv$(src_lv));
+                        if( dst_single )
+                            leader[dst_slot] = leader[it->slot];
+                        changed = true;
                     }
                 }
-                sources.push_back(bb2_idx);
-            }
-            else
-            {
-                visit_terminator_target(blk.terminator, [&](const auto& dst_idx) {
-                    if( dst_idx == bb_idx ) {
-                        DEBUG(state << " BB" << bb2_idx << " doesn't end Goto - instead " << blk.terminator);
-                        skip = true;
-                    }
-                });
+                else if( dst_single )
+                {
+                    bucket.push_back(Entry { mv$(key), dst_slot });
+                    scope_hashes.push_back(h);
+                }
             }
+            enter = false;
         }
 
-        if( !skip && sources.size() > 1 )
+        const auto& children = dom.children[top.bb];
+        if( top.next_child < children.size() )
         {
-            // Found a common assignment, add to the start and remove from sources.
-            auto stmt = ::std::move(fcn.blocks[sources.front()].statements.back());
-            MIR_DEBUG(state, "Move common final statements from " << sources << " to " << bb_idx << " - " << stmt);
-            for(auto idx : sources)
+            auto child = children[top.next_child ++];
+            stack.push_back(StackEnt { child, 0, scope_hashes.size() });
+            enter = true;
+        }
+        else
+        {
+            // Leaving this block, remove its entries (they're the most recent in their buckets)
+            while( scope_hashes.size() > top.scope_start )
             {
-                fcn.blocks[idx].statements.pop_back();
+                table[scope_hashes.back()].pop_back();
+                scope_hashes.pop_back();
             }
-            fcn.blocks[bb_idx].statements.insert(fcn.blocks[bb_idx].statements.begin(), ::std::move(stmt));
+            stack.pop_back();
         }
     }
+
     return changed;
 }
 
-
 // --------------------------------------------------------------------
 // If two temporaries don't overlap in lifetime (blocks in which they're valid), unify the two
 // --------------------------------------------------------------------
@@ -2042,6 +2717,22 @@ bool MIR_Optimise_ConstPropagte(::MIR::TypeResolve& state, ::MIR::Function& fcn)
     //   > NOTE: No need to locally stitch blocks, next pass will do that
     // TODO: Use ValState to do full constant propagation across blocks
 
+    // Locals that are borrowed anywhere can be changed through that borrow (e.g. by inlined code writing via a
+    // `&mut`), so their values are never tracked.
+    ::std::set<unsigned>    borrowed_locals;
+    for(const auto& bb : fcn.blocks)
+    {
+        for(const auto& stmt : bb.statements)
+        {
+            visit_mir_lvalues(stmt, [&borrowed_locals](const ::MIR::LValue& lv, ValUsage vu)->bool {
+                if( vu == ValUsage::Borrow && lv.is_Local() ) {
+                    borrowed_locals.insert(lv.as_Local());
+                }
+                return false;
+                });
+        }
+    }
+
     // Remove redundant temporaries and evaluate known binops
     for(auto& bb : fcn.blocks)
     {
@@ -2288,7 +2979,7 @@ bool MIR_Optimise_ConstPropagte(::MIR::TypeResolve& state, ::MIR::Function& fcn)
             // - Locate `temp = SOME_CONST` and record value
             if( const auto* e = stmt.opt_Assign() )
             {
-                if( e->dst.is_Local() )
+                if( e->dst.is_Local() && borrowed_locals.count(e->dst.as_Local()) == 0 )
                 {
                     if( const auto* ce = e->src.opt_Constant() )
                     {
@@ -2585,15 +3276,102 @@ bool MIR_Optimise_PropagateSingleAssignments(::MIR::TypeResolve& state, ::MIR::F
     // > Replace usage with the inner of the original `Use`
     {
         // 1. Assignments (forward propagate)
+        // - Single pass over each block, tracking the candidates that haven't yet been used (or invalidated)
         ::std::map< ::MIR::LValue, ::MIR::RValue>    replacements;
+        ::std::map<unsigned, unsigned>  pending;    // Candidate local -> statement index
+        ::std::map<unsigned, ::std::vector<unsigned>>  pending_by_src;  // Source local -> candidates
+        ::std::vector<unsigned> mentioned;
         for(const auto& block : fcn.blocks)
         {
             if( block.terminator.tag() == ::MIR::Terminator::TAGDEAD )
                 continue ;
+            pending.clear();
+            pending_by_src.clear();
+
+            auto schedule = [&](unsigned local) {
+                auto it = pending.find(local);
+                const auto& e = block.statements[it->second].as_Assign();
+                DEBUG("> Replace " << e.dst << " with " << e.src.as_Use());
+                replacements.insert( ::std::make_pair(e.dst.clone(), e.src.clone()) );
+                pending.erase(it);
+                };
+            auto get_mentioned = [&](const ::MIR::LValue& lv, auto ) {
+                if( lv.is_Local() )
+                    mentioned.push_back(lv.as_Local());
+                return false;
+                };
 
             for(unsigned int stmt_idx = 0; stmt_idx < block.statements.size(); stmt_idx ++)
             {
                 const auto& stmt = block.statements[stmt_idx];
+                if( !pending.empty() )
+                {
+                    DEBUG("[find usage] " << stmt);
+                    mentioned.clear();
+                    visit_mir_lvalues(stmt, get_mentioned);
+                    // Usage found.
+                    for(auto l : mentioned)
+                    {
+                        if( pending.count(l) )
+                            schedule(l);
+                    }
+                    // Stop if any value mentioned in the source is used (over-cautious, any access of the root counts)
+                    for(auto l : mentioned)
+                    {
+                        auto it = pending_by_src.find(l);
+                        if( it == pending_by_src.end() )
+                            continue ;
+                        for(auto c : it->second)
+                        {
+                            if( pending.erase(c) )
+                                DEBUG("- Single-write/read Local(" << c << ") not replaced - source used");
+                        }
+                        pending_by_src.erase(it);
+                    }
+                    // Stop if the source is borrowed and this may write through a pointer
+                    bool writes_memory = false;
+                    TU_MATCH_DEF(::MIR::Statement, (stmt), (se),
+                    (
+                        writes_memory = true;
+                        ),
+                    (Assign,
+                        const auto* lv = &se.dst;
+                        for(;;)
+                        {
+                            if( lv->is_Field() )
+                                lv = &*lv->as_Field().val;
+                            else if( lv->is_Downcast() )
+                                lv = &*lv->as_Downcast().val;
+                            else if( lv->is_Index() )
+                                lv = &*lv->as_Index().val;
+                            else
+                                break;
+                        }
+                        writes_memory = lv->is_Deref();
+                        ),
+                    (SetDropFlag,
+                        ),
+                    (ScopeEnd,
+                        )
+                    )
+                    if( writes_memory )
+                    {
+                        for(auto it = pending_by_src.begin(); it != pending_by_src.end(); )
+                        {
+                            if( val_uses.local_uses[it->first].borrow == 0 ) {
+                                ++ it;
+                                continue ;
+                            }
+                            for(auto c : it->second)
+                            {
+                                if( pending.erase(c) )
+                                    DEBUG("- Single-write/read Local(" << c << ") not replaced - borrowed source may be written");
+                            }
+                            it = pending_by_src.erase(it);
+                        }
+                    }
+                }
+
                 // > Assignment
                 if( ! stmt.is_Assign() )
                     continue ;
@@ -2613,130 +3391,67 @@ bool MIR_Optimise_PropagateSingleAssignments(::MIR::TypeResolve& state, ::MIR::F
                     continue ;
                 }
                 DEBUG(e.dst << " = " << e.src);
-                if( e.src.is_Use() )
-                {
-                    // Keep the complexity down
-                    const auto* srcp = &e.src.as_Use();
-                    while( srcp->is_Field() )
-                        srcp = &*srcp->as_Field().val;
-                    if( !srcp->is_Local() )
-                        continue ;
-
-                    if( replacements.find(*srcp) != replacements.end() )
-                    {
-                        DEBUG("> Can't replace, source has pending replacement");
-                        continue;
-                    }
-                }
                 // TODO: Allow any rvalue, but that currently breaks due to chaining
-                //else if( e.src.is_Borrow() )
-                //{
-                //}
-                else
-                {
+                if( !e.src.is_Use() )
                     continue ;
+                // Keep the complexity down
+                const auto* srcp = &e.src.as_Use();
+                while( srcp->is_Field() )
+                    srcp = &*srcp->as_Field().val;
+                if( !srcp->is_Local() )
+                    continue ;
+                if( replacements.find(*srcp) != replacements.end() )
+                {
+                    DEBUG("> Can't replace, source has pending replacement");
+                    continue;
                 }
-                bool src_is_lvalue = e.src.is_Use();
-
-                auto is_lvalue_usage = [&](const auto& lv, auto ){ return lv == e.dst; };
-
-                // Returns `true` if the passed lvalue is used as a part of the source
-                auto is_lvalue_in_val = [&](const auto& lv) {
-                    return visit_mir_lvalues(e.src, [&](const auto& slv, auto ) { return lv == slv; });
-                    };
-                // Eligable for replacement
-                // Find where this value is used
+                // Eligable for replacement, find where this value is used
                 // - Stop on a conditional block terminator
                 // - Stop if any value mentioned in the source is mutated/invalidated
-                bool stop = false;
-                bool found = false;
-                for(unsigned int si2 = stmt_idx+1; si2 < block.statements.size(); si2 ++)
-                {
-                    const auto& stmt2 = block.statements[si2];
-                    DEBUG("[find usage] " << stmt2);
-
-                    // Usage found.
-                    if( visit_mir_lvalues(stmt2, is_lvalue_usage) )
-                    {
-                        // If the source isn't a Use, ensure that this is a Use
-                        if( !src_is_lvalue )
-                        {
-                            if( stmt2.is_Assign() && stmt2.as_Assign().src.is_Use() ) {
-                                // Good
-                            }
-                            else {
-                                // Bad, this has to stay a temporary
-                                stop = true;
-                                break;
-                            }
-                        }
-                        found = true;
-                        stop = true;
-                        break;
-                    }
+                pending[e.dst.as_Local()] = stmt_idx;
+                pending_by_src[srcp->as_Local()].push_back(e.dst.as_Local());
+            }   // for(stmt : block.statements)
 
-                    // Determine if source is mutated.
-                    // > Assume that any mutating access of the root value counts (over-cautious)
-                    if( visit_mir_lvalues(stmt2, [&](const auto& lv, auto vu){ return /*vu == ValUsage::Write &&*/ is_lvalue_in_val(lv); }) )
-                    {
-                        stop = true;
-                        break;
-                    }
-                }
-                if( !stop )
-                {
-                    DEBUG("[find usage] " << block.terminator);
-                    TU_MATCHA( (block.terminator), (e),
-                    (Incomplete,
-                        ),
-                    (Return,
-                        ),
-                    (Diverge,
-                        ),
-                    (Goto,
-                        DEBUG("TODO: Chain");
-                        ),
-                    (Panic,
-                        ),
-                    (If,
-                        if( src_is_lvalue && visit_mir_lvalue(e.cond, ValUsage::Read, is_lvalue_usage) )
-                            found = true;
-                        stop = true;
-                        ),
-                    (Switch,
-                        if( src_is_lvalue && visit_mir_lvalue(e.val, ValUsage::Read, is_lvalue_usage) )
-                            found = true;
-                        stop = true;
-                        ),
-                    (SwitchValue,
-                        if( src_is_lvalue && visit_mir_lvalue(e.val, ValUsage::Read, is_lvalue_usage) )
-                            found = true;
-                        stop = true;
-                        ),
-                    (Call,
-                        if( e.fcn.is_Value() )
-                            if( src_is_lvalue && visit_mir_lvalue(e.fcn.as_Value(), ValUsage::Read, is_lvalue_usage) )
-                                found = true;
-                        for(const auto& v : e.args)
-                        {
-                            if( src_is_lvalue && visit_mir_lvalue(v, ValUsage::Read, is_lvalue_usage) )
-                                found = true;
-                        }
-                        stop = true;
-                        )
+            if( !pending.empty() )
+            {
+                DEBUG("[find usage] " << block.terminator);
+                mentioned.clear();
+                TU_MATCHA( (block.terminator), (e),
+                (Incomplete,
+                    ),
+                (Return,
+                    ),
+                (Diverge,
+                    ),
+                (Goto,
+                    DEBUG("TODO: Chain");
+                    ),
+                (Panic,
+                    ),
+                (If,
+                    visit_mir_lvalue(e.cond, ValUsage::Read, get_mentioned);
+                    ),
+                (Switch,
+                    visit_mir_lvalue(e.val, ValUsage::Read, get_mentioned);
+                    ),
+                (SwitchValue,
+                    visit_mir_lvalue(e.val, ValUsage::Read, get_mentioned);
+                    ),
+                (Call,
+                    if( e.fcn.is_Value() )
+                        visit_mir_lvalue(e.fcn.as_Value(), ValUsage::Read, get_mentioned);
+                    for(const auto& v : e.args)
+                        visit_mir_lvalue(v, ValUsage::Read, get_mentioned);
                     )
-                }
-                // Schedule a replacement in a future pass
-                if( found )
-                {
-                    DEBUG("> Replace " << e.dst << " with " << e.src.as_Use());
-                    replacements.insert( ::std::make_pair(e.dst.clone(), e.src.clone()) );
-                }
-                else
+                )
+                for(auto l : mentioned)
                 {
-                    DEBUG("- Single-write/read " << e.dst << " not replaced - couldn't find usage");
+                    if( pending.count(l) )
+                        schedule(l);
                 }
-            }   // for(stmt : block.statements)
+                for(const auto& c : pending)
+                    DEBUG("- Single-write/read Local(" << c.first << ") not replaced - couldn't find usage");
+            }
         }
 
         // Apply replacements within replacements
@@ -2831,79 +3546,80 @@ bool MIR_Optimise_PropagateSingleAssignments(::MIR::TypeResolve& state, ::MIR::F
     // --- Eliminate `... = Use(tmp)` (propagate lvalues upwards)
     {
         DEBUG("- Move upwards");
+        auto is_one_to_one = [&](unsigned local) {
+            const auto& vu = val_uses.local_uses[local];
+            return vu.read == 1 && vu.write == 1 && vu.borrow == 0;
+            };
+        // Index of the last statement that mentioned each local (and the return value, as the final entry)
+        const size_t NEVER = SIZE_MAX;
+        ::std::vector<size_t>   last_mention(fcn.locals.size() + 1);
+        ::std::map<unsigned, size_t>    pending;    // `tmp[1:1] = some_rvalue` : tmp -> statement index
         for(auto& block : fcn.blocks)
         {
-            for(auto it = block.statements.begin(); it != block.statements.end(); ++it)
+            ::std::fill(last_mention.begin(), last_mention.end(), NEVER);
+            pending.clear();
+            ::std::vector<bool> to_remove(block.statements.size());
+            bool any_removed = false;
+            for(size_t i = 0; i < block.statements.size(); i ++)
             {
-                state.set_cur_stmt(&block - &fcn.blocks.front(), it - block.statements.begin());
-                if( !it->is_Assign() )
-                    continue;
-                if( it->as_Assign().src.tag() == ::MIR::RValue::TAGDEAD )
-                    continue ;
-                auto& to_replace_lval = it->as_Assign().dst;
-                if( const auto* e = to_replace_lval.opt_Local() ) {
-                    const auto& vu = val_uses.local_uses[*e];
-                    if( !( vu.read == 1 && vu.write == 1 && vu.borrow == 0 ) )
-                        continue ;
-                }
-                else {
-                    continue;
-                }
-                // ^^^  `tmp[1:1] = some_rvalue`
-
-                // Find where it's used
-                for(auto it2 = it+1; it2 != block.statements.end(); ++it2)
+                auto& stmt = block.statements[i];
+                state.set_cur_stmt(&block - &fcn.blocks.front(), i);
+                if( stmt.is_Assign() && stmt.as_Assign().src.tag() != ::MIR::RValue::TAGDEAD && stmt.as_Assign().src.is_Use() && stmt.as_Assign().src.as_Use().is_Local() )
                 {
-                    if( !it2->is_Assign() )
-                        continue ;
-                    if( it2->as_Assign().src.tag() == ::MIR::RValue::TAGDEAD )
-                        continue ;
-                    if( !it2->as_Assign().src.is_Use() )
-                        continue ;
-                    if( it2->as_Assign().src.as_Use() != to_replace_lval )
-                        continue ;
-                    const auto& new_dst_lval = it2->as_Assign().dst;
                     // `... = Use(to_replace_lval)`
-
-                    // TODO: Ensure that the target isn't borrowed.
-                    if( const auto* e = new_dst_lval.opt_Local() ) {
-                        const auto& vu = val_uses.local_uses[*e];
-                        if( !( vu.read == 1 && vu.write == 1 && vu.borrow == 0 ) )
-                            break ;
-                    }
-                    else if( new_dst_lval.is_Return() ) {
-                        // Return, can't be borrowed?
-                    }
-                    else {
-                        break;
-                    }
-
-                    // Ensure that the target doesn't change in the intervening time.
-                    bool was_invalidated = false;
-                    for(auto it3 = it+1; it3 != it2; it3++)
+                    auto it = pending.find(stmt.as_Assign().src.as_Use().as_Local());
+                    if( it != pending.end() )
                     {
-                        // Closure returns `true` if the passed lvalue is a component of `new_dst_lval`
-                        auto is_lvalue_in_val = [&](const auto& lv) {
-                            return visit_mir_lvalue(new_dst_lval, ValUsage::Write, [&](const auto& slv, auto ) { return lv == slv; });
-                            };
-                        if( visit_mir_lvalues(*it3, [&](const auto& lv, auto ){ return is_lvalue_in_val(lv); }) )
+                        auto def_idx = it->second;
+                        pending.erase(it);
+                        const auto& new_dst_lval = stmt.as_Assign().dst;
+                        // TODO: Ensure that the target isn't borrowed.
+                        size_t  slot = NEVER;
+                        if( const auto* e = new_dst_lval.opt_Local() ) {
+                            if( is_one_to_one(*e) )
+                                slot = *e;
+                        }
+                        else if( new_dst_lval.is_Return() ) {
+                            // Return, can't be borrowed?
+                            slot = fcn.locals.size();
+                        }
+                        // Ensure that the target doesn't change in the intervening time.
+                        if( slot != NEVER && (last_mention[slot] == NEVER || last_mention[slot] <= def_idx) )
                         {
-                            was_invalidated = true;
-                            break;
+                            auto& def = block.statements[def_idx].as_Assign();
+                            DEBUG(state << "Replace assignment of " << def.dst << " with " << new_dst_lval);
+                            def.dst = mv$(stmt.as_Assign().dst);
+                            last_mention[slot] = def_idx;
+                            to_remove[i] = true;
+                            any_removed = true;
+                            replacement_happend = true;
+                            continue ;
                         }
                     }
+                }
 
-                    // Replacement is valid.
-                    if( ! was_invalidated )
-                    {
-                        DEBUG(state << "Replace assignment of " << to_replace_lval << " with " << new_dst_lval);
-                        it->as_Assign().dst = mv$(it2->as_Assign().dst);
-                        block.statements.erase(it2);
-                        replacement_happend = true;
-                        break;
+                visit_mir_lvalues(stmt, [&](const auto& lv, auto ) {
+                    if( lv.is_Local() )
+                        last_mention[lv.as_Local()] = i;
+                    else if( lv.is_Return() )
+                        last_mention.back() = i;
+                    return false;
+                    });
+
+                if( stmt.is_Assign() && stmt.as_Assign().src.tag() != ::MIR::RValue::TAGDEAD )
+                {
+                    if( const auto* e = stmt.as_Assign().dst.opt_Local() ) {
+                        if( is_one_to_one(*e) )
+                            pending[*e] = i;
                     }
                 }
             }
+            if( any_removed )
+            {
+                size_t i = 0;
+                auto new_end = ::std::remove_if(block.statements.begin(), block.statements.end(), [&](const auto& ) { return to_remove[i++]; });
+                block.statements.erase(new_end, block.statements.end());
+            }
         }
     }
 
@@ -3063,50 +3779,40 @@ bool MIR_Optimise_DeadAssignments(::MIR::TypeResolve& state, ::MIR::Function& fc
     bool changed = false;
     TRACE_FUNCTION_FR("", changed);
 
-    // Find any locals that are never read, and delete their assignments.
-
-    // Per-local flag indicating that the particular local is read.
-    ::std::vector<bool> read_locals( fcn.locals.size() );
-    for(const auto& bb : fcn.blocks)
-    {
-        auto cb = [&](const ::MIR::LValue& lv, ValUsage vu) {
-            if( lv.is_Local() ) {
-                read_locals[lv.as_Local()] = true;
-            }
-            return false;
-            };
-        for(const auto& stmt : bb.statements)
-        {
-            if( stmt.is_Assign() && stmt.as_Assign().dst.is_Local() )
-            {
-                visit_mir_lvalues(stmt.as_Assign().src, cb);
-            }
-            else
-            {
-                visit_mir_lvalues(stmt, cb);
-            }
-        }
-        visit_mir_lvalues(bb.terminator, cb);
-    }
+    // Find assignments of locals that are overwritten (or never read) before the next read.
+    ::MIR::dataflow::BlockGraph graph(fcn);
+    ::MIR::dataflow::Liveness   liveness(fcn, graph);
 
     for(auto& bb : fcn.blocks)
     {
-        for(auto it = bb.statements.begin(); it != bb.statements.end(); )
+        auto bb_idx = &bb - &fcn.blocks.front();
+        // Walk backwards from the end of the block, tracking the locals that will be read later
+        auto live = liveness.sol.exit[bb_idx];
+        liveness.step_back(bb.terminator, live);
+        ::std::vector<bool> to_remove(bb.statements.size());
+        bool any_removed = false;
+        for(size_t i = bb.statements.size(); i --; )
         {
-            state.set_cur_stmt(&bb - &fcn.blocks.front(), it - bb.statements.begin());
-            if( it->is_Assign() && it->as_Assign().dst.is_Local() && read_locals[it->as_Assign().dst.as_Local()] == false )
+            const auto& stmt = bb.statements[i];
+            if( stmt.is_Assign() && stmt.as_Assign().dst.is_Local() && !liveness.is_live(live, stmt.as_Assign().dst.as_Local()) )
             {
-                DEBUG(state << "Unread assignment, remove - " << *it);
-                it = bb.statements.erase(it);
-                changed = true;
+                state.set_cur_stmt(bb_idx, i);
+                DEBUG(state << "Unread assignment, remove - " << stmt);
+                to_remove[i] = true;
+                any_removed = true;
                 continue ;
             }
-            ++ it;
+            liveness.step_back(stmt, live);
+        }
+        if( any_removed )
+        {
+            size_t i = 0;
+            auto new_end = ::std::remove_if(bb.statements.begin(), bb.statements.end(), [&](const auto& ) { return to_remove[i++]; });
+            bb.statements.erase(new_end, bb.statements.end());
+            changed = true;
         }
     }
 
-    // Locate assignments of locals then find the next assignment or read.
-
     return changed;
 }
 
@@ -3460,19 +4166,179 @@ void MIR_SortBlocks(const StaticTraitResolve& resolve, const ::HIR::ItemPath& pa
 
 void MIR_OptimiseCrate(::HIR::Crate& crate, bool do_minimal_optimisation)
 {
-    ::MIR::OuterVisitor ov { crate, [do_minimal_optimisation](const auto& res, const auto& p, auto& expr, const auto& args, const auto& ty)
+    auto entries = ::MIR::collect_crate_mir(crate);
+    entries.erase(::std::remove_if(entries.begin(), entries.end(), [](const auto& e) {
+        return ! dynamic_cast<::HIR::ExprNode_Block*>(e.expr->get());
+        }), entries.end());
+
+    // Functions are optimised callees-first, so that the inliner always sees optimised (and stable) MIR.
+    // - Bodies in the same wave are independent, and are run on the worker pool.
+    // - The inliner won't touch anything that isn't finished yet (see `g_pending_mir`), so the output doesn't
+    //   depend on the thread count.
+    ::std::vector<const ::MIR::Function*>   fcn_ptrs;
+    ::std::map<const ::MIR::Function*, size_t>  fcn_idx;
+    for(size_t i = 0; i < entries.size(); i ++)
+    {
+        fcn_ptrs.push_back( &*entries[i].expr->m_mir );
+        fcn_idx.insert(::std::make_pair( fcn_ptrs.back(), i ));
+    }
+
+    // Determine the direct (local) callees of each function
+    ::std::vector< ::std::vector<size_t> >  callees(entries.size());
+    ThreadPool_Run(entries.size(), [&](size_t i) {
+        static Span sp;
+        const auto& e = entries[i];
+        const auto& fcn = *e.expr->m_mir;
+        StaticTraitResolve  resolve { crate, e.impl_generics, e.item_generics };
+        ::MIR::TypeResolve   state { sp, resolve, FMT_CB(ss, ss << e.path.get();), e.ret_type, *e.args, fcn };
+        for(unsigned int bb = 0; bb < fcn.blocks.size(); bb ++)
         {
-            if( ! dynamic_cast<::HIR::ExprNode_Block*>(expr.get()) ) {
-                return ;
+            state.set_cur_stmt_term(bb);
+            const auto* te = fcn.blocks[bb].terminator.opt_Call();
+            if( !te || !te->fcn.is_Path() )
+                continue ;
+            ParamsSet   params;
+            auto it = fcn_idx.find( get_called_mir(state, te->fcn.as_Path(), params) );
+            if( it != fcn_idx.end() )
+                callees[i].push_back(it->second);
+        }
+        ::std::sort(callees[i].begin(), callees[i].end());
+        callees[i].erase(::std::unique(callees[i].begin(), callees[i].end()), callees[i].end());
+        });
+
+    // Find functions that are part of a call cycle (strongly-connected components of more than one function, or
+    // direct recursion), as inlining those just produces another copy of the call.
+    ::std::set<const ::MIR::Function*>  recursive;
+    {
+        // Tarjan's algorithm (iterative)
+        const size_t UNVISITED = SIZE_MAX;
+        ::std::vector<size_t>   index(entries.size(), UNVISITED);
+        ::std::vector<size_t>   lowlink(entries.size());
+        ::std::vector<bool> on_stack(entries.size());
+        ::std::vector<size_t>   stack;
+        size_t  next_index = 0;
+        struct Frame { size_t node; size_t edge; };
+        ::std::vector<Frame>    call_stack;
+        for(size_t root = 0; root < entries.size(); root ++)
+        {
+            if( index[root] != UNVISITED )
+                continue ;
+            call_stack.push_back(Frame { root, 0 });
+            while( !call_stack.empty() )
+            {
+                auto& fr = call_stack.back();
+                auto v = fr.node;
+                if( fr.edge == 0 && index[v] == UNVISITED )
+                {
+                    index[v] = lowlink[v] = next_index ++;
+                    stack.push_back(v);
+                    on_stack[v] = true;
+                }
+                if( fr.edge < callees[v].size() )
+                {
+                    auto w = callees[v][fr.edge ++];
+                    if( index[w] == UNVISITED ) {
+                        call_stack.push_back(Frame { w, 0 });
+                    }
+                    else if( on_stack[w] ) {
+                        lowlink[v] = ::std::min(lowlink[v], index[w]);
+                    }
+                    continue ;
+                }
+                // All edges visited, pop the frame
+                call_stack.pop_back();
+                if( !call_stack.empty() )
+                {
+                    auto p = call_stack.back().node;
+                    lowlink[p] = ::std::min(lowlink[p], lowlink[v]);
+                }
+                if( lowlink[v] == index[v] )
+                {
+                    size_t  first = stack.size();
+                    do {
+                        first --;
+                        on_stack[stack[first]] = false;
+                    } while( stack[first] != v );
+                    if( stack.size() - first > 1 || ::std::binary_search(callees[v].begin(), callees[v].end(), v) )
+                    {
+                        for(size_t j = first; j < stack.size(); j ++)
+                            recursive.insert( fcn_ptrs[stack[j]] );
+                    }
+                    stack.resize(first);
+                }
+            }
+        }
+    }
+    DEBUG(recursive.size() << " functions in call cycles");
+
+    // Split into waves (each function comes after all of its callees)
+    ::std::vector< ::std::vector<size_t> >  waves;
+    {
+        ::std::vector< ::std::vector<size_t> >  callers(entries.size());
+        ::std::vector<size_t>   n_pending_callees(entries.size());
+        ::std::vector<bool> scheduled(entries.size());
+        ::std::vector<size_t>   ready;
+        for(size_t i = 0; i < entries.size(); i ++)
+        {
+            // Self-calls don't delay scheduling (they are only needed to detect direct recursion)
+            for(auto c : callees[i])
+                if( c != i )
+                    callers[c].push_back(i);
+            n_pending_callees[i] = callees[i].size() - ::std::count(callees[i].begin(), callees[i].end(), i);
+            if( n_pending_callees[i] == 0 )
+                ready.push_back(i);
+        }
+        size_t n_scheduled = 0;
+        while( n_scheduled < entries.size() )
+        {
+            if( ready.empty() )
+            {
+                // Mutual recursion, break the cycle by releasing the first unscheduled function
+                size_t i = 0;
+                while( scheduled[i] )
+                    i ++;
+                ready.push_back(i);
+            }
+            for(auto i : ready)
+                scheduled[i] = true;
+            n_scheduled += ready.size();
+            waves.push_back( mv$(ready) );
+            ready.clear();
+            for(auto i : waves.back())
+            {
+                for(auto c : callers[i])
+                {
+                    if( !scheduled[c] && --n_pending_callees[c] == 0 )
+                        ready.push_back(c);
+                }
             }
+            ::std::sort(ready.begin(), ready.end());
+        }
+    }
+    DEBUG(entries.size() << " functions in " << waves.size() << " waves");
+
+    ::std::set<const ::MIR::Function*>  pending { fcn_ptrs.begin(), fcn_ptrs.end() };
+    struct PendingGuard {
+        PendingGuard(const ::std::set<const ::MIR::Function*>& p, const ::std::set<const ::MIR::Function*>& r) { g_pending_mir = &p; g_recursive_mir = &r; }
+        ~PendingGuard() { g_pending_mir = nullptr; g_recursive_mir = nullptr; }
+    } _pg { pending, recursive };
+
+    for(const auto& wave : waves)
+    {
+        ThreadPool_Run(wave.size(), [&](size_t wi) {
+            const auto& e = entries[wave[wi]];
+            StaticTraitResolve  resolve { crate, e.impl_generics, e.item_generics };
             if( do_minimal_optimisation ) {
-                MIR_OptimiseMin(res, p, *expr.m_mir, args, ty);
+                MIR_OptimiseMin(resolve, e.path.get(), *e.expr->m_mir, *e.args, e.ret_type);
             }
             else {
-                MIR_Optimise(res, p, *expr.m_mir, args, ty);
+                MIR_Optimise(resolve, e.path.get(), *e.expr->m_mir, *e.args, e.ret_type);
             }
-        }
-        };
-    ov.visit_crate(crate);
-}
+            });
+        // This wave is now complete, so can be inlined by later waves
+        for(auto i : wave)
+            pending.erase( fcn_ptrs[i] );
+    }
 
+    MIR_OptimiseStats_Print(::std::cout, "MIR optimisation");
+}
@@ -7,6 +7,7 @@
  */
 #include "visit_crate_mir.hpp"
 #include <hir/expr.hpp>
+#include <thread_pool.hpp>
 
 // NOTE: This is left here to ensure that any expressions that aren't handled by higher code cause a failure
 void MIR::OuterVisitor::visit_expr(::HIR::ExprPtr& exp)
@@ -101,3 +102,53 @@ void MIR::OuterVisitor::visit_trait_impl(const ::HIR::SimplePath& trait_path, ::
     auto _ = this->m_resolve.set_impl_generics(impl.m_params);
     ::HIR::Visitor::visit_trait_impl(trait_path, impl);
 }
+
+MIR::ItemPathBuf::ItemPathBuf(const ::HIR::ItemPath& p)
+{
+    ::std::vector<const ::HIR::ItemPath*>   chain;
+    for(const auto* n = &p; n; n = n->parent)
+        chain.push_back(n);
+
+    const ::HIR::ItemPath* parent = nullptr;
+    for(auto it = chain.rbegin(); it != chain.rend(); ++ it)
+    {
+        const auto& src = **it;
+        auto node = ::std::unique_ptr<Node>(new Node(src));
+        node->path.parent = parent;
+        // Names can point at temporaries, so take a copy
+        if( src.name ) {
+            node->name = src.name;
+            node->path.name = node->name.c_str();
+        }
+        if( src.crate_name ) {
+            node->crate_name = src.crate_name;
+            node->path.crate_name = node->crate_name.c_str();
+        }
+        parent = &node->path;
+        m_nodes.push_back( mv$(node) );
+    }
+}
+
+::std::vector<MIR::CrateMirEntry> MIR::collect_crate_mir(::HIR::Crate& crate)
+{
+    static const ::HIR::Function::args_t    empty_args;
+    ::std::vector<CrateMirEntry>    rv;
+    ::MIR::OuterVisitor ov { crate, [&](const auto& res, const auto& p, auto& expr_ptr, const auto& args, const auto& ty) {
+        // NOTE: Non-function bodies are passed a temporary empty argument list
+        const auto* args_p = args.empty() ? &empty_args : &args;
+        rv.push_back(CrateMirEntry { res.m_impl_generics, res.m_item_generics, ItemPathBuf(p), &expr_ptr, args_p, ty.clone() });
+        } };
+    ov.visit_crate(crate);
+    return rv;
+}
+
+void MIR::visit_crate_mir_parallel(::HIR::Crate& crate, OuterVisitor::cb_t cb)
+{
+    auto entries = collect_crate_mir(crate);
+    ThreadPool_Run(entries.size(), [&](size_t i) {
+        const auto& e = entries[i];
+        // Each item gets its own resolver, as it has internal caches
+        StaticTraitResolve  resolve { crate, e.impl_generics, e.item_generics };
+        cb(resolve, e.path.get(), *e.expr, *e.args, e.ret_type);
+        });
+}
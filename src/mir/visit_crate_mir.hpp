@@ -43,5 +43,38 @@ public:
     void visit_trait_impl(const ::HIR::SimplePath& trait_path, ::HIR::TraitImpl& impl) override;
 };
 
+/// Owned copy of an `ItemPath` (the visitor's chain lives on the stack)
+class ItemPathBuf
+{
+    struct Node {
+        ::HIR::ItemPath path;
+        ::std::string   name;
+        ::std::string   crate_name;
+        Node(const ::HIR::ItemPath& p): path(p) {}
+    };
+    ::std::vector< ::std::unique_ptr<Node> >   m_nodes;
+public:
+    ItemPathBuf(const ::HIR::ItemPath& p);
+    const ::HIR::ItemPath& get() const { return m_nodes.back()->path; }
+};
+
+/// A MIR-containing body captured during a crate walk, so it can be processed outside of the visitor
+struct CrateMirEntry
+{
+    /// Generics in scope for this item (for constructing a `StaticTraitResolve`)
+    ::HIR::GenericParams*   impl_generics;
+    ::HIR::GenericParams*   item_generics;
+    ItemPathBuf path;
+    ::HIR::ExprPtr* expr;
+    const ::HIR::Function::args_t*  args;
+    ::HIR::TypeRef  ret_type;
+};
+
+/// Enumerate every MIR-containing body in the crate (in visitor order)
+extern ::std::vector<CrateMirEntry> collect_crate_mir(::HIR::Crate& crate);
+/// Invoke `cb` on every MIR-containing body in the crate, using the worker pool
+/// - The callback must only modify the body it is given.
+extern void visit_crate_mir_parallel(::HIR::Crate& crate, OuterVisitor::cb_t cb);
+
 
 }   // namespace MIR
@@ -1295,6 +1295,10 @@ TokenTree Parse_TT(TokenStream& lex, bool unwrapped)
     TokenTree   rv;
     TRACE_FUNCTION_FR("", rv);
 
+    // Token tree backed streams can hand over an existing group without copying it
+    if( !unwrapped && lex.getTokenTree(rv) )
+        return rv;
+
     Token tok = lex.getToken();
     eTokenType  closer = TOK_PAREN_CLOSE;
     switch(tok.type())
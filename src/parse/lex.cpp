@@ -15,6 +15,8 @@
 #include <typeinfo>
 #include <algorithm>    // std::count
 #include <cctype>
+#include <cstring>  // memcpy
+#include <fstream>
 //#define TRACE_CHARS
 //#define TRACE_RAW_TOKENS
 
@@ -22,28 +24,42 @@ Lexer::Lexer(const ::std::string& filename):
     m_path(filename.c_str()),
     m_line(1),
     m_line_ofs(0),
-    m_istream(filename.c_str()),
+    m_pos(nullptr),
+    m_end(nullptr),
     m_last_char_valid(false),
     m_hygiene( Ident::Hygiene::new_scope() )
 {
-    if( !m_istream.is_open() )
+    // Read the entire file up-front, the lexer then scans the buffer directly
+    ::std::ifstream is(filename, ::std::ios::in | ::std::ios::binary);
+    if( !is.is_open() )
     {
         throw ::std::runtime_error("Unable to open file '" + filename + "'");
     }
+    is.seekg(0, ::std::ios::end);
+    auto len = is.tellg();
+    is.seekg(0, ::std::ios::beg);
+    if( len < 0 || !is )
+    {
+        throw ::std::runtime_error("Unable to read file '" + filename + "'");
+    }
+    m_data.resize(static_cast<size_t>(len));
+    if( !m_data.empty() && !is.read(m_data.data(), m_data.size()) )
+    {
+        throw ::std::runtime_error("Unable to read file '" + filename + "'");
+    }
+    m_pos = m_data.data();
+    m_end = m_pos + m_data.size();
+
     // Consume the BOM
-    if( this->getc_byte() == '\xef' )
+    if( m_pos != m_end && *m_pos == '\xef' )
     {
-        if( this->getc_byte() != '\xbb' ) {
+        if( m_end - m_pos < 2 || m_pos[1] != '\xbb' ) {
             throw ::std::runtime_error("Incomplete BOM - missing \\xBB in second position");
         }
-        if( this->getc_byte() != '\xbf' ) {
+        if( m_end - m_pos < 3 || m_pos[2] != '\xbf' ) {
             throw ::std::runtime_error("Incomplete BOM - missing \\xBF in second position");
         }
-        m_line_ofs = 0;
-    }
-    else
-    {
-        m_istream.unget();
+        m_pos += 3;
     }
 }
 
@@ -185,14 +201,28 @@ static const struct {
 
 signed int Lexer::getSymbol()
 {
+    // Index of the first TOKENMAP entry with each leading character (or the first entry after it)
+    static const struct FirstIndex {
+        unsigned char   idx[128];
+        FirstIndex() {
+            unsigned i = 0;
+            for(unsigned c = 0; c < 128; c ++)
+            {
+                while( i < LEN(TOKENMAP) && static_cast<unsigned>(TOKENMAP[i].chars[0]) < c )
+                    i ++;
+                idx[c] = i;
+            }
+        }
+    } s_first_index;
+
     Codepoint ch = this->getc();
-    // 1. lsearch for character
+    // 1. Look up the first entry that could match (no entries start with non-ASCII)
     // 2. Consume as many characters as currently match
     // 3. IF: a smaller character or, EOS is hit - Return current best
     unsigned ofs = 0;
     signed int best = 0;
     bool hit_eof = false;
-    for(unsigned i = 0; i < LEN(TOKENMAP); i ++)
+    for(unsigned i = (ch.v < 128 ? s_first_index.idx[ch.v] : LEN(TOKENMAP)); i < LEN(TOKENMAP); i ++)
     {
         const char* const chars = TOKENMAP[i].chars;
         const size_t len = TOKENMAP[i].len;
@@ -226,6 +256,10 @@ signed int Lexer::getSymbol()
     return best;
 }
 
+static inline bool is_ascii_ident_byte(char c)
+{
+    return ('a' <= c && c <= 'z') || ('A' <= c && c <= 'Z') || ('0' <= c && c <= '9') || c == '_';
+}
 bool issym(Codepoint ch)
 {
     if('0' <= ch.v && ch.v <= '9')
@@ -313,6 +347,7 @@ Token Lexer::getTokenInt()
             return Token(TOK_NEWLINE);
         if( ch.isspace() )
         {
+            this->skip_ascii_whitespace();
             while( (ch = this->getc()).isspace() && ch != '\n' )
                 ;
             this->ungetc();
@@ -592,6 +627,10 @@ Token Lexer::getTokenInt()
                 while(ch != '\n' && ch != '\r')
                 {
                     str += ch;
+                    // Copy the rest of the line directly from the buffer
+                    const char* start = m_pos;
+                    this->skip_line_comment();
+                    str.append(start, m_pos);
                     ch = this->getc();
                 }
                 this->ungetc();
@@ -810,6 +849,15 @@ Token Lexer::getTokenInt_Identifier(Codepoint leader, Codepoint leader2)
     while( issym(ch) )
     {
         str += ch;
+        // Fast path: take the following run of ASCII identifier characters in one go
+        if( !m_last_char_valid )
+        {
+            const char* start = m_pos;
+            while( m_pos != m_end && is_ascii_ident_byte(*m_pos) )
+                m_pos ++;
+            str.append(start, m_pos);
+            m_line_ofs += m_pos - start;
+        }
         ch = this->getc();
     }
 
@@ -935,9 +983,9 @@ uint32_t Lexer::parseEscape(char enclosing)
 
 char Lexer::getc_byte()
 {
-    int rv = m_istream.get();
-    if( rv == EOF || m_istream.eof() )
+    if( m_pos == m_end )
         throw Lexer::EndOfFile();
+    char rv = *m_pos++;
 
     if( rv == '\n' )
     {
@@ -1032,6 +1080,79 @@ Codepoint Lexer::getc_cp()
     }
 }
 
+namespace {
+    const uint64_t WORD_ONES  = 0x0101010101010101ull;
+    const uint64_t WORD_HIGHS = 0x8080808080808080ull;
+    /// Non-zero if any byte in `w` is equal to `b`
+    inline uint64_t word_has_byte(uint64_t w, uint8_t b)
+    {
+        uint64_t x = w ^ (WORD_ONES * b);
+        return (x - WORD_ONES) & ~x & WORD_HIGHS;
+    }
+}
+
+// Skip spaces/tabs directly in the buffer (the caller handles any remaining whitespace)
+void Lexer::skip_ascii_whitespace()
+{
+    if( m_last_char_valid )
+        return ;
+    const char* p = m_pos;
+    while( p != m_end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\x0C') )
+        p ++;
+    m_line_ofs += p - m_pos;
+    m_pos = p;
+}
+// Advance to the next CR/LF (leaving it unread), checking eight bytes at a time
+// - Stops at the start of any malformed UTF-8 sequence (including stray continuation bytes), so `getc_cp` decodes it
+void Lexer::skip_line_comment()
+{
+    assert(!m_last_char_valid);
+    const char* p = m_pos;
+    unsigned int n_chars = 0;
+    for(;;)
+    {
+        // Plain ASCII with no line endings can be skipped a word at a time
+        while( m_end - p >= 8 )
+        {
+            uint64_t w;
+            memcpy(&w, p, 8);
+            if( (w & WORD_HIGHS) || word_has_byte(w, '\n') || word_has_byte(w, '\r') )
+                break;
+            p += 8;
+            n_chars += 8;
+        }
+        if( p == m_end )
+            break;
+        uint8_t b = *p;
+        if( b == '\n' || b == '\r' )
+            break;
+        size_t len = 1;
+        if( b >= 0x80 )
+        {
+            if( (b & 0xE0) == 0xC0 )
+                len = 2;
+            else if( (b & 0xF0) == 0xE0 )
+                len = 3;
+            else if( (b & 0xF8) == 0xF0 )
+                len = 4;
+            else
+                break;
+            if( static_cast<size_t>(m_end - p) < len )
+                break;
+            bool valid = true;
+            for(size_t i = 1; i < len; i ++)
+                valid &= (static_cast<uint8_t>(p[i]) & 0xC0) == 0x80;
+            if( !valid )
+                break;
+        }
+        // One column per character
+        n_chars ++;
+        p += len;
+    }
+    m_line_ofs += n_chars;
+    m_pos = p;
+}
+
 void Lexer::ungetc()
 {
 #ifdef TRACE_CHARS
@@ -9,7 +9,7 @@
 #define LEX_HPP_INCLUDED
 
 #include <string>
-#include <fstream>
+#include <vector>
 #include "tokenstream.hpp"
 
 struct Codepoint {
@@ -39,7 +39,10 @@ class Lexer:
     unsigned int m_line;
     unsigned int m_line_ofs;
 
-    ::std::ifstream m_istream;
+    /// Entire file contents (read up-front, scanned using `m_pos`)
+    ::std::vector<char> m_data;
+    const char* m_pos;
+    const char* m_end;
     bool    m_last_char_valid;
     Codepoint   m_last_char;
     ::std::vector<Token>    m_next_tokens;
@@ -69,6 +72,8 @@ private:
     }
 
     void ungetc();
+    void skip_ascii_whitespace();
+    void skip_line_comment();
     Codepoint getc_num();
     Codepoint getc();
     Codepoint getc_cp();
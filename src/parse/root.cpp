@@ -17,6 +17,7 @@
 #include <hir/hir.hpp>  // ABI_RUST - TODO: Move elsewhere?
 #include <expand/cfg.hpp>   // check_cfg - for `mod nonexistant;`
 #include <fstream>  // Used by directory path
+#include <chrono>   // Parse_LexerBenchmark
 #include "lex.hpp"  // New file lexer
 #include <ast/expr.hpp>
 
@@ -665,7 +666,6 @@ AST::Trait Parse_TraitDef(TokenStream& lex, const AST::MetaItems& meta_items)
         AST::MetaItems  item_attrs = Parse_ItemAttrs(lex);
         SET_ATTRS(lex, item_attrs);
 
-        auto ps = lex.start_span();
         {
             ::AST::MacroInvocation  inv;
             if( Parse_MacroInvocation_Opt(lex, inv) )
@@ -820,7 +820,6 @@ AST::Enum Parse_EnumDef(TokenStream& lex, const AST::MetaItems& meta_items)
     ::std::vector<AST::EnumVariant>   variants;
     while( GET_TOK(tok, lex) != TOK_BRACE_CLOSE )
     {
-        auto sp = lex.start_span();
         PUTBACK(tok, lex);
 
         AST::MetaItems  item_attrs = Parse_ItemAttrs(lex);
@@ -1933,3 +1932,60 @@ AST::Crate Parse_Crate(::std::string mainfile)
 
     return crate;
 }
+
+void Parse_LexerBenchmark(const ::std::string& mainfile, unsigned int iterations)
+{
+    // Parse the crate once to find every file that makes up the crate
+    struct H {
+        static void add_files(const AST::Module& mod, ::std::vector< ::std::string>& files) {
+            for(const auto& i : mod.items())
+            {
+                if( const auto* e = i.data.opt_Module() )
+                {
+                    const auto& path = e->m_file_info.path;
+                    if( path.size() > 3 && path.compare(path.size() - 3, 3, ".rs") == 0 )
+                        files.push_back(path);
+                    add_files(*e, files);
+                }
+            }
+        }
+    };
+    ::std::vector< ::std::string>   files;
+    files.push_back(mainfile);
+    {
+        auto crate = Parse_Crate(mainfile);
+        H::add_files(crate.root_module(), files);
+    }
+    size_t  total_bytes = 0;
+    for(const auto& f : files)
+    {
+        ::std::ifstream is(f, ::std::ios::in | ::std::ios::binary | ::std::ios::ate);
+        total_bytes += static_cast<size_t>(is.tellg());
+    }
+    double mb = static_cast<double>(total_bytes) / (1024*1024);
+    ::std::cout << files.size() << " files, " << mb << " MiB" << ::std::endl;
+
+    double  best = 0, total = 0;
+    for(unsigned int i = 0; i < iterations; i ++)
+    {
+        size_t  n_tokens = 0;
+        auto start = ::std::chrono::steady_clock::now();
+        for(const auto& f : files)
+        {
+            Lexer   lex(f);
+            while( lex.getToken().type() != TOK_EOF )
+                n_tokens ++;
+        }
+        double secs = ::std::chrono::duration<double>(::std::chrono::steady_clock::now() - start).count();
+
+        double rate = mb / secs;
+        ::std::cout << "#" << i << ": " << n_tokens << " tokens in " << secs << " s - " << rate << " MiB/s, "
+            << n_tokens / secs / 1e6 << " Mtok/s" << ::std::endl;
+        best = ::std::max(best, rate);
+        total += rate;
+    }
+    if( iterations > 0 )
+    {
+        ::std::cout << "Best " << best << " MiB/s, mean " << total / iterations << " MiB/s" << ::std::endl;
+    }
+}
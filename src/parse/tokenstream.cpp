@@ -8,6 +8,7 @@
 #include "tokenstream.hpp"
 #include <common.hpp>
 #include "parseerror.hpp"
+#include "tokentree.hpp"
 
 const bool DEBUG_PRINT_TOKENS = false;
 //const bool DEBUG_PRINT_TOKENS = true;
@@ -109,6 +110,50 @@ eTokenType TokenStream::lookahead(unsigned int i)
     return m_lookahead[i].first.type();
 }
 
+bool TokenStream::getTokenTree(TokenTree& out)
+{
+    // The group's opening token must be the most recent token read from the source, and nothing else can be buffered
+    Token*  open = nullptr;
+    if( m_cache_valid )
+    {
+        if( !m_lookahead.empty() )
+            return false;
+        open = &m_cache;
+    }
+    else if( m_lookahead.size() == 1 )
+    {
+        open = &m_lookahead.front().first;
+    }
+    else if( m_lookahead.empty() )
+    {
+        auto tok = this->innerGetToken();
+        auto hygiene = this->realGetHygiene();
+        m_lookahead.push_back( ::std::make_pair(mv$(tok), mv$(hygiene)) );
+        open = &m_lookahead.front().first;
+    }
+    else
+    {
+        return false;
+    }
+
+    switch(open->type())
+    {
+    case TOK_PAREN_OPEN:
+    case TOK_SQUARE_OPEN:
+    case TOK_BRACE_OPEN:
+        break;
+    default:
+        return false;
+    }
+    if( !this->realGetTokenTree(*open, out) )
+        return false;
+    DEBUG("<<< TT " << out);
+    m_cache_valid = false;
+    m_lookahead.clear();
+    m_hygiene = this->realGetHygiene();
+    return true;
+}
+
 Ident::Hygiene TokenStream::getHygiene() const
 {
     return m_hygiene;
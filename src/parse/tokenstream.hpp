@@ -18,6 +18,7 @@ namespace AST {
     class Module;
     class MetaItems;
 }
+class TokenTree;
 
 /// State the parser needs to pass down via a second channel.
 struct ParseState
@@ -47,6 +48,7 @@ struct ParseState
 class TokenStream
 {
     friend class TTLexer;   // needs access to internals to know what was consumed
+    friend class MacroExpander; // forwards `realGetTokenTree` to its inner stream
 
     bool    m_cache_valid;
     Token   m_cache;
@@ -59,6 +61,10 @@ public:
     Token   getToken();
     void    putback(Token tok);
     eTokenType  lookahead(unsigned int count);
+    /// If the next token opens a group, and the source stream can provide that group directly (sharing the
+    /// original tokens instead of re-building the tree), read the entire group into `out`.
+    /// - Returns false without consuming anything otherwise (the caller should fall back to `Parse_TT`)
+    bool    getTokenTree(TokenTree& out);
 
     Ident::Hygiene getHygiene() const;
     virtual void push_hygine() {}
@@ -77,6 +83,9 @@ protected:
     virtual ::std::shared_ptr<Span> outerSpan() const { return ::std::shared_ptr<Span>(0); }
     virtual Token   realGetToken() = 0;
     virtual Ident::Hygiene realGetHygiene() const = 0;
+    /// Read the rest of the group opened by the last token returned by `realGetToken` (which is passed as `open`),
+    /// storing the entire group (including `open`) in `out`. Returns false (consuming nothing) if not supported.
+    virtual bool realGetTokenTree(Token& open, TokenTree& out) { return false; }
 private:
     Token innerGetToken();
 };
@@ -11,12 +11,17 @@
 #include "token.hpp"
 #include <ident.hpp>
 #include <vector>
+#include <memory>
 
 class TokenTree
 {
+public:
+    typedef ::std::vector<TokenTree>    t_subtrees;
+private:
     Ident::Hygiene m_hygiene;
     Token   m_tok;
-    ::std::vector<TokenTree>    m_subtrees;
+    /// Child trees, shared between clones (so cloning a group doesn't copy it) and copied on mutable access if shared
+    ::std::shared_ptr<t_subtrees>   m_subtrees;
 public:
     virtual ~TokenTree() {}
     TokenTree() {}
@@ -37,25 +42,32 @@ public:
     }
     TokenTree(Ident::Hygiene hygiene, ::std::vector<TokenTree> subtrees):
         m_hygiene( ::std::move(hygiene) ),
-        m_subtrees( ::std::move(subtrees) )
+        m_subtrees( subtrees.empty() ? nullptr : ::std::make_shared<t_subtrees>(::std::move(subtrees)) )
     {
     }
 
+    /// Cheap copy (children are shared with this tree)
     TokenTree clone() const;
 
     bool is_token() const {
         return m_tok.type() != TOK_NULL;
     }
     unsigned int size() const {
-        return m_subtrees.size();
+        return m_subtrees ? m_subtrees->size() : 0;
+    }
+    /// Returns true if the children of this tree are not shared with another tree
+    bool is_unique() const {
+        return !m_subtrees || m_subtrees.use_count() == 1;
     }
-    const TokenTree& operator[](unsigned int idx) const { assert(idx < m_subtrees.size()); return m_subtrees[idx]; }
-          TokenTree& operator[](unsigned int idx)       { assert(idx < m_subtrees.size()); return m_subtrees[idx]; }
+    const TokenTree& operator[](unsigned int idx) const { assert(idx < size()); return (*m_subtrees)[idx]; }
+          TokenTree& operator[](unsigned int idx)       { assert(idx < size()); unshare(); return (*m_subtrees)[idx]; }
     const Token& tok() const { return m_tok; }
           Token& tok()       { return m_tok; }
     const Ident::Hygiene& hygiene() const { return m_hygiene; }
 
     friend ::std::ostream& operator<<(::std::ostream& os, const TokenTree& tt);
+private:
+    void unshare();
 };
 
 #endif // TOKENTREE_HPP_INCLUDED
@@ -8,6 +8,43 @@
 #include "ttstream.hpp"
 #include <common.hpp>
 
+namespace {
+    eTokenType get_closer(eTokenType open)
+    {
+        switch(open)
+        {
+        case TOK_PAREN_OPEN:    return TOK_PAREN_CLOSE;
+        case TOK_SQUARE_OPEN:   return TOK_SQUARE_CLOSE;
+        case TOK_BRACE_OPEN:    return TOK_BRACE_CLOSE;
+        default:    return TOK_NULL;
+        }
+    }
+    /// Check that `tree` (which starts with the opening token `open`) is exactly one delimited group
+    /// - NOTE: The first entry isn't checked, as its token may have been moved out
+    bool is_single_group(const TokenTree& tree, eTokenType open)
+    {
+        auto close = get_closer(open);
+        if( close == TOK_NULL || tree.size() < 2 || tree[0].size() != 0 )
+            return false;
+        // The group must only close at the final entry
+        unsigned int depth = 1;
+        for(unsigned int i = 1; i < tree.size(); i ++)
+        {
+            if( !tree[i].is_token() )
+                continue ;
+            auto ty = tree[i].tok().type();
+            if( ty == open )
+                depth ++;
+            else if( ty == close ) {
+                depth --;
+                if( depth == 0 )
+                    return i == tree.size() - 1;
+            }
+        }
+        return false;
+    }
+}
+
 TTStream::TTStream(Span parent, const TokenTree& input_tt):
     m_parent_span( new Span(mv$(parent)) )
 {
@@ -51,6 +88,19 @@ Token TTStream::realGetToken()
     //m_hygiene = nullptr;
     return Token(TOK_EOF);
 }
+bool TTStream::realGetTokenTree(Token& open, TokenTree& out)
+{
+    // The last token must have been the first entry of the current tree (and the tree must be that entire group)
+    if( m_stack.empty() || m_stack.back().first != 1 )
+        return false;
+    const TokenTree& tree = *m_stack.back().second;
+    if( tree.is_token() || !is_single_group(tree, open.type()) )
+        return false;
+    out = tree.clone();
+    m_hygiene_ptr = &tree[tree.size()-1].hygiene();
+    m_stack.pop_back();
+    return true;
+}
 Position TTStream::getPosition() const
 {
     // TODO: Position associated with the previous/next token?
@@ -69,7 +119,7 @@ TTStreamO::TTStreamO(Span parent, TokenTree input_tt):
     m_input_tt( mv$(input_tt) ),
     m_parent_span( new Span(mv$(parent)) )
 {
-    m_stack.push_back( ::std::make_pair(0, nullptr) );
+    m_stack.push_back( Level { 0, nullptr, m_input_tt.is_unique() } );
 }
 TTStreamO::~TTStreamO()
 {
@@ -79,27 +129,32 @@ Token TTStreamO::realGetToken()
     while(m_stack.size() > 0)
     {
         // If current index is above TT size, go up
-        unsigned int& idx = m_stack.back().first;
-        TokenTree& tree = (m_stack.back().second ? *m_stack.back().second : m_input_tt);
+        auto& lvl = m_stack.back();
+        const TokenTree& tree = (lvl.tree ? *lvl.tree : m_input_tt);
 
-        if(idx == 0 && tree.is_token()) {
-            idx ++;
+        if(lvl.idx == 0 && tree.is_token()) {
+            lvl.idx ++;
             m_last_pos = tree.tok().get_pos();
             m_hygiene_ptr = &tree.hygiene();
-            return mv$(tree.tok());
+            // NOTE: Only the root can be a bare token (and its token is never shared)
+            return mv$(const_cast<TokenTree&>(tree).tok());
         }
 
-        if(idx < tree.size())
+        if(lvl.idx < tree.size())
         {
-            TokenTree& subtree = tree[idx];
-            idx ++;
+            const TokenTree& subtree = tree[lvl.idx];
+            lvl.idx ++;
             if( subtree.size() == 0 ) {
                 m_last_pos = subtree.tok().get_pos();
                 m_hygiene_ptr = &subtree.hygiene();
-                return mv$( subtree.tok() );
+                if( lvl.owned )
+                    return mv$( const_cast<TokenTree&>(subtree).tok() );
+                else
+                    return subtree.tok().clone();
             }
             else {
-                m_stack.push_back( ::std::make_pair(0, &subtree) );
+                bool owned = lvl.owned && subtree.is_unique();
+                m_stack.push_back( Level { 0, const_cast<TokenTree*>(&subtree), owned } );
             }
         }
         else {
@@ -108,14 +163,42 @@ Token TTStreamO::realGetToken()
     }
     return Token(TOK_EOF);
 }
+bool TTStreamO::realGetTokenTree(Token& open, TokenTree& out)
+{
+    // The last token must have been the first entry of the current tree (and the tree must be that entire group)
+    if( m_stack.empty() || m_stack.back().idx != 1 )
+        return false;
+    auto& lvl = m_stack.back();
+    TokenTree& tree = (lvl.tree ? *lvl.tree : m_input_tt);
+    // NOTE: Read through a const reference, as the mutable accessors would un-share a shared tree
+    const TokenTree& ctree = tree;
+    if( !is_single_group(ctree, open.type()) )
+        return false;
+    const auto& last = ctree[ctree.size()-1];
+    m_last_pos = last.tok().get_pos();
+    if( lvl.owned )
+    {
+        // Restore the opening token (moved out by `realGetToken`), then take the tree
+        m_hygiene_ptr = nullptr;
+        m_last_hygiene = last.hygiene();
+        tree[0].tok() = mv$(open);
+        out = mv$(tree);
+    }
+    else
+    {
+        m_hygiene_ptr = &last.hygiene();
+        out = tree.clone();
+    }
+    m_stack.pop_back();
+    return true;
+}
 Position TTStreamO::getPosition() const
 {
     return m_last_pos;
 }
 Ident::Hygiene TTStreamO::realGetHygiene() const
 {
-    // Empty.
     if(!m_hygiene_ptr)
-        return Ident::Hygiene();
+        return m_last_hygiene;
     return *m_hygiene_ptr;
 }
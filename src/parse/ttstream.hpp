@@ -29,16 +29,24 @@ public:
 protected:
     Ident::Hygiene realGetHygiene() const override;
     Token realGetToken() override;
+    bool realGetTokenTree(Token& open, TokenTree& out) override;
 };
 
 /// Owned TTStream
+/// - Tokens are moved out of the tree where it isn't shared with another tree (and cloned where it is)
 class TTStreamO:
     public TokenStream
 {
     Position    m_last_pos;
     TokenTree   m_input_tt;
-    ::std::vector< ::std::pair<unsigned int, TokenTree*> > m_stack;
+    struct Level {
+        unsigned int    idx;
+        TokenTree*  tree;   // nullptr for `m_input_tt`
+        bool    owned;  // This tree (and all of its parents) are not shared, so tokens can be moved out
+    };
+    ::std::vector<Level> m_stack;
     const Ident::Hygiene*   m_hygiene_ptr = nullptr;
+    Ident::Hygiene  m_last_hygiene; // Used when the last token was in a tree that has been moved out
 public:
     ::std::shared_ptr<Span> m_parent_span;
     TTStreamO(Span parent, TokenTree input_tt);
@@ -54,4 +62,5 @@ public:
 protected:
     Ident::Hygiene realGetHygiene() const override;
     Token realGetToken() override;
+    bool realGetTokenTree(Token& open, TokenTree& out) override;
 };
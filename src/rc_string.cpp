@@ -1,44 +1,81 @@
 /*
+ * MRustC - Rust Compiler
+ * - By John Hodge (Mutabah/thePowersGang)
+ *
+ * rc_string.cpp
+ * - Interned (process-wide, immutable) strings
  */
 #include <rc_string.hpp>
-#include <cstring>
-#include <iostream>
+#include <fnv.hpp>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <atomic>
 
-RcString::RcString(const char* s, unsigned int len):
-    m_ptr(nullptr),
-    m_len(len)
-{
-    if( len > 0 )
+namespace {
+    // Borrowed view of the string in an entry (so lookups don't need to construct a `std::string`)
+    struct Key
+    {
+        const char* ptr;
+        size_t  len;
+        size_t  hash;
+    };
+    struct KeyHash {
+        size_t operator()(const Key& k) const { return k.hash; }
+    };
+    struct KeyEq {
+        bool operator()(const Key& a, const Key& b) const { return a.len == b.len && ::std::memcmp(a.ptr, b.ptr, a.len) == 0; }
+    };
+
+    // Split into independently-locked shards, as paths are also built from the typecheck/translation workers
+    const unsigned int NUM_SHARDS = 16;
+    template<typename Inner>
+    struct Shard
     {
-        m_ptr = new unsigned int[1 + (len+1 + sizeof(unsigned int)-1) / sizeof(unsigned int)];
-        *m_ptr = 1;
-        char* data_mut = reinterpret_cast<char*>(m_ptr + 1);
-        for(unsigned int j = 0; j < len; j ++ )
-            data_mut[j] = s[j];
-        data_mut[len] = '\0';
-    }
+        ::std::mutex    lock;
+        ::std::unordered_map<Key, ::std::unique_ptr<Inner>, KeyHash, KeyEq>  ents;
+    };
+    ::std::atomic<size_t>   g_lookups { 0 };
+    ::std::atomic<size_t>   g_count { 0 };
+}
+
+const ::std::string& RcString::empty_str()
+{
+    static const ::std::string  s_empty;
+    return s_empty;
 }
-RcString::~RcString()
+
+size_t RcString::hash_str(const char* s, size_t len)
 {
-    if(m_ptr)
-    {
-        *m_ptr -= 1;
-        //::std::cout << "RcString(\"" << *this << "\") - " << *m_ptr << " refs left" << ::std::endl;
-        if( *m_ptr == 0 )
-        {
-            delete[] m_ptr;
-            m_ptr = nullptr;
-        }
-    }
+    Fnv64   h;
+    h.feed(s, len);
+    return static_cast<size_t>(h.v);
 }
-bool RcString::operator==(const char* s) const
+
+const RcString::Inner* RcString::intern(const char* s, size_t len)
+{
+    // Leaked, so handles in static objects stay valid during shutdown
+    static Shard<Inner>*    s_shards = new Shard<Inner>[NUM_SHARDS];
+    if( len == 0 )
+        return nullptr;
+
+    Key key { s, len, hash_str(s, len) };
+    auto& shard = s_shards[key.hash % NUM_SHARDS];
+    g_lookups.fetch_add(1, ::std::memory_order_relaxed);
+
+    ::std::lock_guard< ::std::mutex>    lh { shard.lock };
+    auto it = shard.ents.find(key);
+    if( it != shard.ents.end() )
+        return it->second.get();
+
+    auto* inner = new Inner { key.hash, ::std::string(s, len) };
+    key.ptr = inner->str.data();
+    shard.ents.insert( ::std::make_pair(key, ::std::unique_ptr<Inner>(inner)) );
+    g_count.fetch_add(1, ::std::memory_order_relaxed);
+    return inner;
+}
+
+void RcString::print_stats(::std::ostream& os)
 {
-    if( m_len == 0 )
-        return *s == '\0';
-    auto m = this->c_str();
-    do {
-        if( *m != *s )
-            return false;
-    } while( *m++ != '\0' && *s++ != '\0' );
-    return true;
+    os << "String interner: " << g_count.load() << " distinct strings, " << g_lookups.load() << " lookups" << ::std::endl;
 }
@@ -0,0 +1,72 @@
+/*
+ * MRustC - Rust Compiler
+ * - By John Hodge (Mutabah/thePowersGang)
+ *
+ * thread_pool.cpp
+ * - Worker pool for running independent per-item jobs
+ */
+#include <thread_pool.hpp>
+#include <debug.hpp>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <exception>
+
+unsigned int g_thread_count = 1;
+
+unsigned int ThreadPool_WorkerCount()
+{
+    // Debug output from multiple threads would be interleaved, so force serial operation
+    if( debug_enabled() )
+        return 1;
+    return g_thread_count > 1 ? g_thread_count : 1;
+}
+
+void ThreadPool_Run(size_t count, ::std::function<void(size_t)> fcn)
+{
+    size_t  n_workers = ThreadPool_WorkerCount();
+    if( n_workers > count )
+        n_workers = count;
+
+    if( n_workers <= 1 )
+    {
+        for(size_t i = 0; i < count; i ++)
+            fcn(i);
+        return ;
+    }
+
+    ::std::atomic<size_t>   next_job { 0 };
+    // One slot per job, so the reported failure doesn't depend on scheduling
+    ::std::vector< ::std::exception_ptr>    errors(count);
+    auto worker = [&]() {
+        for(;;)
+        {
+            size_t i = next_job.fetch_add(1);
+            if( i >= count )
+                break;
+            try
+            {
+                fcn(i);
+            }
+            catch(...)
+            {
+                errors[i] = ::std::current_exception();
+            }
+        }
+        };
+
+    ::std::vector< ::std::thread>   threads;
+    threads.reserve(n_workers - 1);
+    for(size_t i = 1; i < n_workers; i ++)
+        threads.push_back( ::std::thread(worker) );
+    // The calling thread is also a worker
+    worker();
+    for(auto& t : threads)
+        t.join();
+
+    for(auto& e : errors)
+    {
+        if( e )
+            ::std::rethrow_exception(e);
+    }
+}
@@ -0,0 +1,222 @@
+/*
+ * MRustC - Rust Compiler
+ * - By John Hodge (Mutabah/thePowersGang)
+ *
+ * timings.cpp
+ * - Machine-readable phase timing/memory report (`--timings=<path>`)
+ */
+#include <timings.hpp>
+#include <common.hpp>
+#include <debug.hpp>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include <cstdlib>
+#include <csignal>
+#include <new>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#ifndef _WIN32
+# include <sys/resource.h>
+#endif
+
+namespace {
+    struct Entry
+    {
+        ::std::string   name;
+        double  wall_s = 0;
+        double  cpu_s = 0;
+        uint64_t    peak_rss_kb = 0;
+        uint64_t    allocs = 0;
+        // Still open when the report was written (i.e. compilation stopped during this scope)
+        bool    incomplete = false;
+        ::std::vector< ::std::unique_ptr<Entry>>    children;
+
+        // State while the scope is open
+        ::std::chrono::steady_clock::time_point wall_start;
+        ::std::clock_t  cpu_start;
+        uint64_t    allocs_start;
+    };
+
+    bool    g_timings_enabled = false;
+    bool    g_timings_written = false;
+    ::std::string   g_timings_path;
+    ::std::string   g_timings_input;
+    Entry   g_timings_root;
+    ::std::vector<Entry*>   g_timings_stack;
+
+    ::std::atomic<uint64_t> g_alloc_count { 0 };
+
+    uint64_t get_peak_rss_kb()
+    {
+#ifdef _WIN32
+        // TODO: GetProcessMemoryInfo (needs psapi)
+        return 0;
+#else
+        struct rusage   ru;
+        if( getrusage(RUSAGE_SELF, &ru) != 0 )
+            return 0;
+# ifdef __APPLE__
+        return ru.ru_maxrss / 1024; // Bytes on macOS
+# else
+        return ru.ru_maxrss;
+# endif
+#endif
+    }
+
+    void write_json_string(::std::ostream& os, const ::std::string& s)
+    {
+        os << "\"";
+        for(char c : s)
+        {
+            switch(c)
+            {
+            case '"':   os << "\\\"";   break;
+            case '\\':  os << "\\\\";   break;
+            case '\n':  os << "\\n";    break;
+            default:
+                if( static_cast<unsigned char>(c) < 0x20 )
+                    os << "\\u" << ::std::hex << ::std::setw(4) << ::std::setfill('0') << static_cast<unsigned>(c) << ::std::dec << ::std::setfill(' ');
+                else
+                    os << c;
+                break;
+            }
+        }
+        os << "\"";
+    }
+    void write_entries(::std::ostream& os, const ::std::vector< ::std::unique_ptr<Entry>>& ents, int indent)
+    {
+        auto ind = RepeatLitStr { "  ", indent };
+        os << "[";
+        for(size_t i = 0; i < ents.size(); i ++)
+        {
+            const auto& e = *ents[i];
+            os << (i == 0 ? "\n" : ",\n");
+            os << ind << "  {";
+            os << "\"name\": "; write_json_string(os, e.name);
+            os << ", \"wall_s\": " << e.wall_s;
+            os << ", \"cpu_s\": " << e.cpu_s;
+            os << ", \"peak_rss_kb\": " << e.peak_rss_kb;
+            os << ", \"allocs\": " << e.allocs;
+            if( e.incomplete )
+                os << ", \"incomplete\": true";
+            if( !e.children.empty() )
+            {
+                os << ", \"children\": ";
+                write_entries(os, e.children, indent + 2);
+            }
+            os << "}";
+        }
+        if( !ents.empty() )
+            os << "\n" << ind;
+        os << "]";
+    }
+
+    void close_entry(Entry& e)
+    {
+        e.wall_s = ::std::chrono::duration<double>(::std::chrono::steady_clock::now() - e.wall_start).count();
+        e.cpu_s = static_cast<double>(::std::clock() - e.cpu_start) / static_cast<double>(CLOCKS_PER_SEC);
+        e.peak_rss_kb = get_peak_rss_kb();
+        e.allocs = g_alloc_count.load() - e.allocs_start;
+    }
+
+    void write_report()
+    {
+        if( g_timings_written )
+            return ;
+        g_timings_written = true;
+        // Scopes still open are the ones that were running when compilation stopped
+        for(auto* e : g_timings_stack)
+        {
+            close_entry(*e);
+            e->incomplete = true;
+        }
+        ::std::ofstream os(g_timings_path);
+        if( !os.is_open() )
+        {
+            ::std::cerr << "Unable to open " << g_timings_path << " for writing" << ::std::endl;
+            return ;
+        }
+        os << ::std::fixed << ::std::setprecision(6);
+        os << "{\n";
+        os << "  \"input\": "; write_json_string(os, g_timings_input); os << ",\n";
+        os << "  \"peak_rss_kb\": " << get_peak_rss_kb() << ",\n";
+        os << "  \"allocs\": " << g_alloc_count.load() << ",\n";
+        os << "  \"phases\": "; write_entries(os, g_timings_root.children, 1); os << "\n";
+        os << "}\n";
+    }
+
+    // `BUG`/`ERROR` terminate with `abort`, which skips `atexit` handlers
+    // - Best effort (not async-signal-safe), as the process is terminating anyway
+    void on_abort(int sig)
+    {
+        ::std::signal(SIGABRT, SIG_DFL);
+        write_report();
+        ::std::raise(sig);
+    }
+}
+
+void Timings_Enable(::std::string path, ::std::string input)
+{
+    g_timings_path = mv$(path);
+    g_timings_input = mv$(input);
+    if( !g_timings_enabled )
+    {
+        g_timings_enabled = true;
+        // Written on exit, so a report is produced even if compilation stops early (or fails)
+        ::std::atexit(write_report);
+        ::std::signal(SIGABRT, on_abort);
+    }
+}
+bool Timings_IsEnabled()
+{
+    return g_timings_enabled;
+}
+
+Timings_Scope::Timings_Scope(::std::string name):
+    m_active(g_timings_enabled)
+{
+    if( !m_active )
+        return ;
+    auto& parent = g_timings_stack.empty() ? g_timings_root : *g_timings_stack.back();
+    parent.children.push_back( ::std::unique_ptr<Entry>(new Entry()) );
+    auto* e = parent.children.back().get();
+    e->name = mv$(name);
+    e->wall_start = ::std::chrono::steady_clock::now();
+    e->cpu_start = ::std::clock();
+    e->allocs_start = g_alloc_count.load();
+    g_timings_stack.push_back(e);
+}
+Timings_Scope::~Timings_Scope()
+{
+    if( !m_active )
+        return ;
+    auto* e = g_timings_stack.back();
+    g_timings_stack.pop_back();
+    close_entry(*e);
+}
+
+// Replacement global allocator, to count allocations (only when the report is enabled)
+void* operator new(size_t size)
+{
+    if( g_timings_enabled )
+        g_alloc_count.fetch_add(1, ::std::memory_order_relaxed);
+    if( size == 0 )
+        size = 1;
+    for(;;)
+    {
+        if( void* rv = ::std::malloc(size) )
+            return rv;
+        auto handler = ::std::get_new_handler();
+        if( !handler )
+            throw ::std::bad_alloc();
+        handler();
+    }
+}
+void operator delete(void* ptr) noexcept
+{
+    ::std::free(ptr);
+}
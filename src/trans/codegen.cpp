@@ -14,11 +14,13 @@
 
 #include "codegen.hpp"
 #include "monomorphise.hpp"
+#include "mono_cache.hpp"
 
 void Trans_Codegen(const ::std::string& outfile, const TransOptions& opt, const ::HIR::Crate& crate, const TransList& list, bool is_executable)
 {
     static Span sp;
-    auto codegen = Trans_Codegen_GetGeneratorC(crate, outfile);
+    auto codegen = Trans_Codegen_GetGeneratorC(crate, outfile, opt);
+    Trans_MonoCache mono_cache { crate, opt };
 
     // 1. Emit structure/type definitions.
     // - Emit in the order they're needed.
@@ -164,6 +166,14 @@ void Trans_Codegen(const ::std::string& outfile, const TransOptions& opt, const
             bool is_method = ( fcn.m_args.size() > 0 && visit_ty_with(fcn.m_args[0].second, [&](const auto& x){return x == ::HIR::TypeRef("Self",0xFFFF);}) );
             if( pp.has_types() || is_method )
             {
+                // Monomorphised upstream generics can be shared with other builds
+                bool use_cache = is_extern && mono_cache.is_cacheable(path, pp);
+                if( use_cache )
+                {
+                    ::std::string   cached_code;
+                    if( mono_cache.lookup(path, pp, cached_code) && codegen->emit_function_code_cached(path, cached_code) )
+                        continue ;
+                }
                 ::StaticTraitResolve    resolve { crate };
                 auto ret_type = pp.monomorph(resolve, fcn.m_return);
                 ::HIR::Function::args_t args;
@@ -179,6 +189,12 @@ void Trans_Codegen(const ::std::string& outfile, const TransOptions& opt, const
                 // TODO: Flag that this should be a weak (or weak-er) symbol?
                 // - If it's from an external crate, it should be weak
                 codegen->emit_function_code(path, fcn, ent.second->pp, is_extern,  mir);
+                if( use_cache )
+                {
+                    auto code = codegen->get_last_function_code();
+                    if( code != "" )
+                        mono_cache.store(path, pp, code);
+                }
             }
             // TODO: Detect if the function was a #[inline] function from another crate, and don't emit if that is the case?
             // - Emiting is nice, but it should be emitted as a weak symbol
@@ -188,6 +204,8 @@ void Trans_Codegen(const ::std::string& outfile, const TransOptions& opt, const
         }
     }
 
+    MIR_OptimiseStats_Print(::std::cout, "MIR optimisation (monomorphised)");
+
     codegen->finalise(is_executable, opt);
 }
 
@@ -52,8 +52,14 @@ public:
     virtual void emit_function_ext(const ::HIR::Path& p, const ::HIR::Function& item, const Trans_Params& params) {}
     virtual void emit_function_proto(const ::HIR::Path& p, const ::HIR::Function& item, const Trans_Params& params, bool is_extern_def) {}
     virtual void emit_function_code(const ::HIR::Path& p, const ::HIR::Function& item, const Trans_Params& params, bool is_extern_def, const ::MIR::FunctionPointer& code) {}
+
+    // Support for the monomorphisation cache (see trans/mono_cache.hpp)
+    // - Returns the output generated by the last `emit_function_code` call (empty if unsupported)
+    virtual ::std::string get_last_function_code() const { return ""; }
+    // - Emit previously generated output for a function, returns false if unsupported
+    virtual bool emit_function_code_cached(const ::HIR::Path& p, const ::std::string& code) { return false; }
 };
 
 
-extern ::std::unique_ptr<CodeGenerator> Trans_Codegen_GetGeneratorC(const ::HIR::Crate& crate, const ::std::string& outfile);
+extern ::std::unique_ptr<CodeGenerator> Trans_Codegen_GetGeneratorC(const ::HIR::Crate& crate, const ::std::string& outfile, const TransOptions& opt);
 
@@ -8,8 +8,12 @@
 #include "codegen.hpp"
 #include "mangling.hpp"
 #include <fstream>
+#include <sstream>
 #include <algorithm>
 #include <cmath>
+#include <limits>
+#include <thread>
+#include <iterator>
 #include <hir/hir.hpp>
 #include <mir/mir.hpp>
 #include <hir_typeck/static.hpp>
@@ -17,6 +21,7 @@
 #include "codegen_c.hpp"
 #include "target.hpp"
 #include "allocator.hpp"
+#include "fingerprint.hpp"
 
 namespace {
     struct FmtShell
@@ -186,7 +191,19 @@ namespace {
         ::std::string   m_outfile_path;
         ::std::string   m_outfile_path_c;
 
-        ::std::ofstream m_of;
+        // Output files
+        // - With a single codegen unit, everything goes into `m_outfile_path_c`
+        // - With multiple units, types/prototypes go into a shared header, statics (and `main`) into the first unit,
+        //   and function bodies are spread over all units.
+        ::std::string   m_outfile_path_h;
+        ::std::filebuf  m_header_buf;
+        ::std::vector< ::std::string>   m_unit_paths;
+        ::std::vector< ::std::unique_ptr< ::std::filebuf> > m_unit_bufs;
+        // Place functions by a hash of their path (instead of balancing unit sizes), so an edit to one function
+        // only changes the unit that contains it. Used for incremental builds.
+        bool    m_stable_units;
+        // Stream that all emit methods write to, pointed at the relevant output file
+        ::std::ostream  m_of;
         const ::MIR::TypeResolve* m_mir_res;
 
         Compiler    m_compiler = Compiler::Gcc;
@@ -198,13 +215,21 @@ namespace {
         ::std::map<::HIR::GenericPath, ::std::vector<unsigned>> m_enum_repr_cache;
 
         ::std::vector< ::std::pair< ::HIR::GenericPath, const ::HIR::Struct*> >   m_box_glue_todo;
+
+        // Output of the most recent `emit_function_code`
+        ::std::string   m_last_function_code;
+
+        // Set once the first command has been written to `TransOptions::build_command_file`
+        bool    m_build_command_written = false;
     public:
-        CodeGenerator_C(const ::HIR::Crate& crate, const ::std::string& outfile):
+        CodeGenerator_C(const ::HIR::Crate& crate, const ::std::string& outfile, unsigned int codegen_units, bool stable_units):
             m_crate(crate),
             m_resolve(crate),
             m_outfile_path(outfile),
             m_outfile_path_c(outfile + ".c"),
-            m_of(m_outfile_path_c)
+            m_outfile_path_h(outfile + ".h"),
+            m_stable_units(stable_units),
+            m_of(nullptr)
         {
             switch(Target_GetCurSpec().m_codegen_mode)
             {
@@ -219,6 +244,34 @@ namespace {
                 break;
             }
 
+            // TODO: Support multiple codegen units with MSVC (needs an alternative to `ld -r` and `--localize-hidden`)
+            if( m_compiler != Compiler::Gcc || codegen_units == 0 )
+                codegen_units = 1;
+            for(unsigned int i = 0; i < codegen_units; i ++)
+            {
+                m_unit_paths.push_back( i == 0 ? m_outfile_path_c : FMT(m_outfile_path << "." << i << ".c") );
+            }
+            if( m_unit_paths.size() > 1 )
+            {
+                m_header_buf.open(m_outfile_path_h, ::std::ios::out);
+                for(const auto& path : m_unit_paths)
+                {
+                    m_unit_bufs.push_back( ::std::unique_ptr< ::std::filebuf>(new ::std::filebuf) );
+                    m_unit_bufs.back()->open(path, ::std::ios::out);
+                    ::std::ostream(m_unit_bufs.back().get())
+                        << "/*\n"
+                        << " * AUTOGENERATED by mrustc\n"
+                        << " */\n"
+                        << "#include \"" << FmtEscaped(m_outfile_path_h.substr(m_outfile_path_h.find_last_of("/\\") + 1)) << "\"\n"
+                        ;
+                }
+            }
+            else
+            {
+                m_header_buf.open(m_outfile_path_c, ::std::ios::out);
+            }
+            m_of.rdbuf(&m_header_buf);
+
             m_of
                 << "/*\n"
                 << " * AUTOGENERATED by mrustc\n"
@@ -451,6 +504,72 @@ namespace {
 
         ~CodeGenerator_C() {}
 
+    private:
+        bool has_multiple_units() const
+        {
+            return m_unit_paths.size() > 1;
+        }
+        // Point `m_of` at the shared header (or the only output file)
+        void select_header()
+        {
+            m_of.rdbuf(&m_header_buf);
+        }
+        // Point `m_of` at the unit that holds static definitions and `main`
+        void select_data_unit()
+        {
+            if( has_multiple_units() )
+                m_of.rdbuf(m_unit_bufs[0].get());
+            else
+                select_header();
+        }
+        // Point `m_of` at the unit for the given function (by default, the unit with the least code emitted so far)
+        void select_code_unit(const ::HIR::Path& p)
+        {
+            if( !has_multiple_units() )
+            {
+                select_header();
+                return ;
+            }
+            if( m_stable_units )
+            {
+                Fnv64   h;
+                h.feed( FMT(Trans_Mangle(p)) );
+                m_of.rdbuf(m_unit_bufs[h.v % m_unit_bufs.size()].get());
+                return ;
+            }
+            ::std::filebuf* best = nullptr;
+            ::std::streamoff   best_size = 0;
+            for(auto& buf : m_unit_bufs)
+            {
+                auto size = static_cast< ::std::streamoff>( buf->pubseekoff(0, ::std::ios::cur, ::std::ios::out) );
+                if( !best || size < best_size )
+                {
+                    best = buf.get();
+                    best_size = size;
+                }
+            }
+            m_of.rdbuf(best);
+        }
+        // Linkage for functions that must not be visible outside this crate (e.g. monomorphs of external generics)
+        // - With multiple units they can't be `static`, so are hidden and then localised once the units are merged.
+        const char* local_linkage() const
+        {
+            return has_multiple_units() ? "__attribute__((visibility(\"hidden\"))) " : "static ";
+        }
+        // Start the definition of a drop glue function (`emit_sig` writes the return type, name, and arguments)
+        // - With multiple units, it is declared in the shared header and defined in only one unit. Finish with `select_header`
+        template<typename Cb>
+        void begin_drop_glue(const ::HIR::Path& drop_glue_path, Cb emit_sig)
+        {
+            if( has_multiple_units() )
+            {
+                m_of << local_linkage(); emit_sig(); m_of << ";\n";
+                select_code_unit(drop_glue_path);
+            }
+            m_of << local_linkage(); emit_sig();
+        }
+    public:
+
         void finalise(bool is_executable, const TransOptions& opt) override
         {
             // Emit box drop glue after everything else to avoid definition ordering issues
@@ -461,6 +580,7 @@ namespace {
 
             if( is_executable )
             {
+                select_data_unit();
                 m_of << "int main(int argc, const char* argv[]) {\n";
                 auto c_start_path = m_resolve.m_crate.get_lang_item_path_opt("mrustc-start");
                 if( c_start_path == ::HIR::SimplePath() )
@@ -477,7 +597,10 @@ namespace {
             }
 
             m_of.flush();
-            m_of.close();
+            select_header();
+            m_header_buf.close();
+            for(auto& buf : m_unit_bufs)
+                buf->close();
 
             ::std::vector<const char*> link_dirs;
             auto add_link_dir = [&link_dirs](const char* d) {
@@ -503,33 +626,111 @@ namespace {
             bool is_windows = false;
             switch( m_compiler )
             {
-            case Compiler::Gcc:
-                if( getenv("CC") ) {
-                    args.push_back( getenv("CC") );
-		}
-                else {
-                    //args.push_back( Target_GetCurSpec().m_c_compiler + "-gcc" );
-                    args.push_back( "gcc" );
-		}
-                args.push_back("-ffunction-sections");
-                args.push_back("-pthread");
-                switch(opt.opt_level)
-                {
-                case 0: break;
-                case 1:
-                    args.push_back("-O1");
-                    break;
-                case 2:
-                    args.push_back("-O2");
-                    break;
-                }
-                if( opt.emit_debug_info )
+            case Compiler::Gcc: {
+                const char* cc = getenv("CC");
+                if( !cc ) {
+                    //cc = Target_GetCurSpec().m_c_compiler + "-gcc";
+                    cc = "gcc";
+                }
+                auto push_cflags = [&](StringList& args) {
+                    args.push_back(cc);
+                    args.push_back("-ffunction-sections");
+                    args.push_back("-pthread");
+                    switch(opt.opt_level)
+                    {
+                    case 0: break;
+                    case 1:
+                        args.push_back("-O1");
+                        break;
+                    case 2:
+                        args.push_back("-O2");
+                        break;
+                    }
+                    if( opt.emit_debug_info )
+                    {
+                        args.push_back("-g");
+                    }
+                    };
+
+                ::std::string   c_input = m_outfile_path_c;
+                if( has_multiple_units() )
                 {
-                    args.push_back("-g");
+                    // Compile each unit separately (in parallel), then merge them into a single object
+                    ::std::string   merged_path = is_executable ? m_outfile_path + ".cgu.o" : m_outfile_path;
+                    ::std::vector<StringList>   unit_cmds;
+                    StringList  merge_args;
+                    merge_args.push_back(cc);
+                    merge_args.push_back("-r");
+                    merge_args.push_back("-nostdlib");
+                    merge_args.push_back("-o");
+                    merge_args.push_back(merged_path);
+                    // With `-C incremental`, units are skipped if their object is from identical inputs
+                    // - Commands that are only being written out (`-Z emit-build-command`) must always be complete
+                    bool incremental = opt.incremental && opt.build_command_file == "";
+                    Trans_FingerprintDb fp_db { m_outfile_path + ".incr" };
+                    ::std::unique_ptr<Trans_HeaderIndex>    header_index;
+                    if( incremental )
+                    {
+                        header_index.reset(new Trans_HeaderIndex(m_outfile_path_h));
+                        if( !header_index->is_loaded() )
+                            incremental = false;
+                    }
+                    for(const auto& path : m_unit_paths)
+                    {
+                        StringList  cmd;
+                        push_cflags(cmd);
+                        cmd.push_back("-c");
+                        cmd.push_back("-o");
+                        cmd.push_back(path + ".o");
+                        cmd.push_back(path);
+                        merge_args.push_back(path + ".o");
+                        if( incremental )
+                        {
+                            // Fingerprint: The compiler command, the unit itself, and the parts of the shared header
+                            // that it uses (so editing one function doesn't rebuild every unit)
+                            ::std::ifstream is(path, ::std::ios::binary);
+                            ::std::string   code { ::std::istreambuf_iterator<char>(is), ::std::istreambuf_iterator<char>() };
+                            Fnv64   h;
+                            for(const auto& a : cmd.get_vec())
+                                h.feed(a);
+                            h.feed(code);
+                            header_index->feed_used(h, code);
+                            if( fp_db.check(path + ".o", h.str()) )
+                            {
+                                DEBUG("Unchanged: " << path);
+                                continue ;
+                            }
+                        }
+                        unit_cmds.push_back(mv$(cmd));
+                    }
+                    if( incremental )
+                    {
+                        ::std::cout << "Incremental: " << m_unit_paths.size() - unit_cmds.size() << " of " << m_unit_paths.size() << " codegen units unchanged" << ::std::endl;
+                    }
+                    if( !unit_cmds.empty() )
+                        run_commands(mv$(unit_cmds), false, opt);
+                    run_command(mv$(merge_args), false, opt);
+
+                    // Crate-local functions were given hidden visibility so they could be shared between units, make
+                    // them local again so they don't conflict with other crates' copies.
+                    StringList  localise_args;
+                    localise_args.push_back( getenv("OBJCOPY") ? getenv("OBJCOPY") : "objcopy" );
+                    localise_args.push_back("--localize-hidden");
+                    localise_args.push_back(merged_path);
+                    run_command(mv$(localise_args), false, opt);
+                    // Only saved once every unit has compiled (a failed command aborts)
+                    if( incremental )
+                        fp_db.save();
+
+                    if( !is_executable )
+                        return ;
+                    c_input = merged_path;
                 }
+
+                push_cflags(args);
                 args.push_back("-o");
                 args.push_back(m_outfile_path.c_str());
-                args.push_back(m_outfile_path_c.c_str());
+                args.push_back(c_input);
                 if( is_executable )
                 {
                     for( const auto& crate : m_crate.m_ext_crates )
@@ -561,7 +762,7 @@ namespace {
                 {
                     args.push_back("-c");
                 }
-                break;
+                } break;
             case Compiler::Msvc:
                 is_windows = true;
                 // TODO: Look up these paths in the registry and use CreateProcess instead of system
@@ -623,35 +824,73 @@ namespace {
                 break;
             }
 
-            ::std::stringstream cmd_ss;
-            if (is_windows)
-            {
-                cmd_ss << "echo \"\" & ";
-            }
-            for(const auto& arg : args.get_vec())
+            run_command(mv$(args), is_windows, opt);
+        }
+
+        void run_command(StringList args, bool is_windows, const TransOptions& opt)
+        {
+            ::std::vector<StringList>   cmds;
+            cmds.push_back(mv$(args));
+            run_commands(mv$(cmds), is_windows, opt);
+        }
+        // Run a set of independent compiler commands, all at once
+        void run_commands(::std::vector<StringList> cmds, bool is_windows, const TransOptions& opt)
+        {
+            ::std::vector< ::std::string>   cmd_strs;
+            for(const auto& args : cmds)
             {
-                if(strcmp(arg, "&") == 0 && is_windows) {
-                    cmd_ss << "&";
+                ::std::stringstream cmd_ss;
+                if (is_windows)
+                {
+                    cmd_ss << "echo \"\" & ";
                 }
-                else {
-                    if( is_windows && strchr(arg, ' ') == nullptr ) {
-                        cmd_ss << arg << " ";
-                        continue ;
+                for(const auto& arg : args.get_vec())
+                {
+                    if(strcmp(arg, "&") == 0 && is_windows) {
+                        cmd_ss << "&";
+                    }
+                    else {
+                        if( is_windows && strchr(arg, ' ') == nullptr ) {
+                            cmd_ss << arg << " ";
+                            continue ;
+                        }
+                        cmd_ss << "\"" << FmtShell(arg, is_windows) << "\" ";
                     }
-                    cmd_ss << "\"" << FmtShell(arg, is_windows) << "\" ";
                 }
+                //DEBUG("- " << cmd_ss.str());
+                ::std::cout << "Running comamnd - " << cmd_ss.str() << ::std::endl;
+                cmd_strs.push_back(cmd_ss.str());
             }
-            //DEBUG("- " << cmd_ss.str());
-            ::std::cout << "Running comamnd - " << cmd_ss.str() << ::std::endl;
+
             if( opt.build_command_file != "" )
             {
-                ::std::cerr << "INVOKE CC: " << cmd_ss.str() << ::std::endl;
-                ::std::ofstream(opt.build_command_file) << cmd_ss.str() << ::std::endl;
+                // Commands are appended, as a multi-unit build produces several
+                ::std::ofstream of(opt.build_command_file, m_build_command_written ? ::std::ios::app : ::std::ios::out);
+                for(const auto& cmd : cmd_strs)
+                {
+                    ::std::cerr << "INVOKE CC: " << cmd << ::std::endl;
+                    of << cmd << ::std::endl;
+                }
+                m_build_command_written = true;
+                return ;
+            }
+
+            ::std::vector<int>  statuses(cmd_strs.size());
+            ::std::vector< ::std::thread>   threads;
+            for(size_t i = 1; i < cmd_strs.size(); i ++)
+            {
+                threads.push_back(::std::thread([&,i]() { statuses[i] = system(cmd_strs[i].c_str()); }));
             }
-            else if( system(cmd_ss.str().c_str()) != 0 )
+            statuses[0] = system(cmd_strs[0].c_str());
+            for(auto& t : threads)
+                t.join();
+            for(auto status : statuses)
             {
-                ::std::cerr << "C Compiler failed to execute" << ::std::endl;
-                abort();
+                if( status != 0 )
+                {
+                    ::std::cerr << "C Compiler failed to execute" << ::std::endl;
+                    abort();
+                }
             }
         }
 
@@ -672,7 +911,8 @@ namespace {
             ::MIR::Function empty_fcn;
             ::MIR::TypeResolve  mir_res { sp, m_resolve, FMT_CB(ss, ss << drop_glue_path;), struct_ty_ptr, args, empty_fcn };
             m_mir_res = &mir_res;
-            m_of << "static void " << Trans_Mangle(drop_glue_path) << "(struct s_" << Trans_Mangle(p) << "* rv) {\n";
+            begin_drop_glue(drop_glue_path, [&](){ m_of << "void " << Trans_Mangle(drop_glue_path) << "(struct s_" << Trans_Mangle(p) << "* rv)"; });
+            m_of << " {\n";
 
             // Obtain inner pointer
             // TODO: This is very specific to the structure of the official liballoc's Box.
@@ -683,6 +923,7 @@ namespace {
             m_of << "\t" << Trans_Mangle(box_free) << "(arg0);\n";
 
             m_of << "}\n";
+            select_header();
             m_mir_res = nullptr;
         }
 
@@ -797,7 +1038,8 @@ namespace {
                 auto ty_ptr = ::HIR::TypeRef::new_pointer(::HIR::BorrowType::Owned, ty.clone());
                 ::MIR::TypeResolve  mir_res { sp, m_resolve, FMT_CB(ss, ss << drop_glue_path;), ty_ptr, args, empty_fcn };
                 m_mir_res = &mir_res;
-                m_of << "static void " << Trans_Mangle(drop_glue_path) << "("; emit_ctype(ty); m_of << "* rv) {";
+                begin_drop_glue(drop_glue_path, [&](){ m_of << "void " << Trans_Mangle(drop_glue_path) << "("; emit_ctype(ty); m_of << "* rv)"; });
+                m_of << " {";
                 auto self = ::MIR::LValue::make_Deref({ box$(::MIR::LValue::make_Return({})) });
                 auto fld_lv = ::MIR::LValue::make_Field({ box$(self), 0 });
                 for(const auto& ity : te)
@@ -806,6 +1048,7 @@ namespace {
                     fld_lv.as_Field().field_index ++;
                 }
                 m_of << "}\n";
+                select_header();
             )
             else TU_IFLET( ::HIR::TypeRef::Data, ty.m_data, Function, te,
                 emit_type_fn(ty);
@@ -933,7 +1176,7 @@ namespace {
                 if( p.m_path.m_crate_name != m_crate.m_crate_name )
                 {
                     if( item.m_params.m_types.size() > 0 ) {
-                        m_of << "static ";
+                        m_of << local_linkage();
                     }
                     else {
                         m_of << "extern ";
@@ -944,13 +1187,14 @@ namespace {
             else if( m_resolve.is_type_owned_box(struct_ty) )
             {
                 m_box_glue_todo.push_back( ::std::make_pair( mv$(struct_ty.m_data.as_Path().path.m_data.as_Generic()), &item ) );
-                m_of << "static void " << Trans_Mangle(drop_glue_path) << "("; emit_ctype(struct_ty_ptr, FMT_CB(ss, ss << "rv";)); m_of << ");\n";
+                m_of << local_linkage() << "void " << Trans_Mangle(drop_glue_path) << "("; emit_ctype(struct_ty_ptr, FMT_CB(ss, ss << "rv";)); m_of << ");\n";
                 return ;
             }
 
             ::MIR::TypeResolve  mir_res { sp, m_resolve, FMT_CB(ss, ss << drop_glue_path;), struct_ty_ptr, args, empty_fcn };
             m_mir_res = &mir_res;
-            m_of << "static void " << Trans_Mangle(drop_glue_path) << "("; emit_ctype(struct_ty_ptr, FMT_CB(ss, ss << "rv";)); m_of << ") {\n";
+            begin_drop_glue(drop_glue_path, [&](){ m_of << "void " << Trans_Mangle(drop_glue_path) << "("; emit_ctype(struct_ty_ptr, FMT_CB(ss, ss << "rv";)); m_of << ")"; });
+            m_of << " {\n";
 
             // If this type has an impl of Drop, call that impl
             if( item.m_markings.has_drop_impl ) {
@@ -982,6 +1226,7 @@ namespace {
                 )
             )
             m_of << "}\n";
+            select_header();
             m_mir_res = nullptr;
         }
         void emit_union(const Span& sp, const ::HIR::GenericPath& p, const ::HIR::Union& item) override
@@ -1023,12 +1268,14 @@ namespace {
                 m_of << "tUNIT " << Trans_Mangle(drop_impl_path) << "(union u_" << Trans_Mangle(p) << "*rv);\n";
             }
 
-            m_of << "static void " << Trans_Mangle(drop_glue_path) << "(union u_" << Trans_Mangle(p) << "* rv) {\n";
+            begin_drop_glue(drop_glue_path, [&](){ m_of << "void " << Trans_Mangle(drop_glue_path) << "(union u_" << Trans_Mangle(p) << "* rv)"; });
+            m_of << " {\n";
             if( item.m_markings.has_drop_impl )
             {
                 m_of << "\t" << Trans_Mangle(drop_impl_path) << "(rv);\n";
             }
             m_of << "}\n";
+            select_header();
         }
 
         // TODO: Move this to codegen.cpp?
@@ -1225,7 +1472,8 @@ namespace {
                 m_of << "tUNIT " << Trans_Mangle(drop_impl_path) << "(struct e_" << Trans_Mangle(p) << "*rv);\n";
             }
 
-            m_of << "static void " << Trans_Mangle(drop_glue_path) << "(struct e_" << Trans_Mangle(p) << "* rv) {\n";
+            begin_drop_glue(drop_glue_path, [&](){ m_of << "void " << Trans_Mangle(drop_glue_path) << "(struct e_" << Trans_Mangle(p) << "* rv)"; });
+            m_of << " {\n";
 
             // If this type has an impl of Drop, call that impl
             if( item.m_markings.has_drop_impl )
@@ -1261,6 +1509,7 @@ namespace {
                 // Glue does nothing (except call the destructor, if there is one)
             }
             m_of << "}\n";
+            select_header();
             m_mir_res = nullptr;
 
             if( nonzero_path.size() )
@@ -1420,6 +1669,11 @@ namespace {
 
             TRACE_FUNCTION_F(p);
             auto type = params.monomorph(m_resolve, item.m_type);
+            // Defined in the data unit, so must not be a tentative definition in the shared header
+            if( has_multiple_units() )
+            {
+                m_of << "extern ";
+            }
             emit_ctype( type, FMT_CB(ss, ss << Trans_Mangle(p);) );
             m_of << ";";
             m_of << "\t// static " << p << " : " << type;
@@ -1435,6 +1689,7 @@ namespace {
 
             TRACE_FUNCTION_F(p);
 
+            select_data_unit();
             auto type = params.monomorph(m_resolve, item.m_type);
             emit_ctype( type, FMT_CB(ss, ss << Trans_Mangle(p);) );
             m_of << " = ";
@@ -1442,6 +1697,7 @@ namespace {
             m_of << ";";
             m_of << "\t// static " << p << " : " << type;
             m_of << "\n";
+            select_header();
 
             m_mir_res = nullptr;
         }
@@ -1738,6 +1994,24 @@ namespace {
             const auto& trait_path = p.m_data.as_UfcsKnown().trait;
             const auto& type = *p.m_data.as_UfcsKnown().type;
 
+            auto vtable_sp = trait_path.m_path;
+            vtable_sp.m_components.back() += "#vtable";
+            auto vtable_params = trait_path.m_params.clone();
+            for(const auto& ty : trait.m_type_indexes) {
+                auto aty = ::HIR::TypeRef( ::HIR::Path( type.clone(), trait_path.clone(), ty.first ) );
+                m_resolve.expand_associated_types(sp, aty);
+                vtable_params.m_types.push_back( mv$(aty) );
+            }
+            const auto& vtable_ref = m_crate.get_struct_by_path(sp, vtable_sp);
+            ::HIR::TypeRef  vtable_ty( ::HIR::GenericPath(mv$(vtable_sp), mv$(vtable_params)), &vtable_ref );
+
+            // With multiple units, the vtable is declared in the shared header and defined (with its shims) in one unit
+            if( has_multiple_units() )
+            {
+                m_of << "extern "; emit_ctype(vtable_ty); m_of << " " << Trans_Mangle(p) << ";\n";
+                select_code_unit(p);
+            }
+
             // TODO: Hack in fn pointer VTable handling
             if( const auto* te = type.m_data.opt_Function() )
             {
@@ -1780,17 +2054,6 @@ namespace {
             }
 
             {
-                auto vtable_sp = trait_path.m_path;
-                vtable_sp.m_components.back() += "#vtable";
-                auto vtable_params = trait_path.m_params.clone();
-                for(const auto& ty : trait.m_type_indexes) {
-                    auto aty = ::HIR::TypeRef( ::HIR::Path( type.clone(), trait_path.clone(), ty.first ) );
-                    m_resolve.expand_associated_types(sp, aty);
-                    vtable_params.m_types.push_back( mv$(aty) );
-                }
-                const auto& vtable_ref = m_crate.get_struct_by_path(sp, vtable_sp);
-                ::HIR::TypeRef  vtable_ty( ::HIR::GenericPath(mv$(vtable_sp), mv$(vtable_params)), &vtable_ref );
-
                 // Weak link for vtables
                 switch(m_compiler)
                 {
@@ -1840,6 +2103,7 @@ namespace {
             }
             m_of << "\n";
             m_of << "\t};\n";
+            select_header();
 
             m_mir_res = nullptr;
         }
@@ -1925,7 +2189,7 @@ namespace {
             }
             if( is_extern_def )
             {
-                m_of << "static ";
+                m_of << local_linkage();
             }
             emit_function_header(p, item, params);
             m_of << ";\n";
@@ -1946,9 +2210,12 @@ namespace {
             ::MIR::TypeResolve  mir_res { sp, m_resolve, FMT_CB(ss, ss << p;), ret_type, arg_types, *code };
             m_mir_res = &mir_res;
 
+            // Generate into a buffer, so the result can be handed to the monomorphisation cache
+            ::std::stringbuf    fcn_buf;
+            m_of.rdbuf(&fcn_buf);
             m_of << "// " << p << "\n";
             if( is_extern_def ) {
-                m_of << "static ";
+                m_of << local_linkage();
             }
             emit_function_header(p, item, params);
             m_of << "\n";
@@ -2120,9 +2387,22 @@ namespace {
                 m_of << "#endif\n";
             }
             m_of << "}\n";
-            m_of.flush();
+            m_last_function_code = fcn_buf.str();
+            emit_function_code_cached(p, m_last_function_code);
             m_mir_res = nullptr;
         }
+        ::std::string get_last_function_code() const override
+        {
+            return m_last_function_code;
+        }
+        bool emit_function_code_cached(const ::HIR::Path& p, const ::std::string& code) override
+        {
+            select_code_unit(p);
+            m_of << code;
+            m_of.flush();
+            select_header();
+            return true;
+        }
 
         void emit_fcn_node(::MIR::TypeResolve& mir_res, const Node& node, unsigned indent_level)
         {
@@ -4918,7 +5198,7 @@ namespace {
     Span CodeGenerator_C::sp;
 }
 
-::std::unique_ptr<CodeGenerator> Trans_Codegen_GetGeneratorC(const ::HIR::Crate& crate, const ::std::string& outfile)
+::std::unique_ptr<CodeGenerator> Trans_Codegen_GetGeneratorC(const ::HIR::Crate& crate, const ::std::string& outfile, const TransOptions& opt)
 {
-    return ::std::unique_ptr<CodeGenerator>(new CodeGenerator_C(crate, outfile));
+    return ::std::unique_ptr<CodeGenerator>(new CodeGenerator_C(crate, outfile, opt.codegen_units, opt.incremental));
 }
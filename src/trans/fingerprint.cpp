@@ -0,0 +1,354 @@
+/*
+ * MRustC - Rust Compiler
+ * - By John Hodge (Mutabah/thePowersGang)
+ *
+ * trans/fingerprint.cpp
+ * - Fingerprint database and header index used for incremental rebuilds
+ */
+#include "fingerprint.hpp"
+#include <debug.hpp>
+#include <fstream>
+#include <cstdio>   // rename, remove
+#include <iterator>
+#include <unordered_set>
+
+namespace {
+    const char* DB_MAGIC = "mrustc-incr-v2";
+
+    bool is_ident_start(char c) {
+        return ('a' <= c && c <= 'z') || ('A' <= c && c <= 'Z') || c == '_' || c == '$';
+    }
+    bool is_ident_char(char c) {
+        return is_ident_start(c) || ('0' <= c && c <= '9');
+    }
+    /// Keywords that can appear where a declared name would (e.g. `void (*fn)(void)`, `int f() __attribute__((x))`)
+    bool is_keyword(const ::std::string& s) {
+        static const char* const KEYWORDS[] = {
+            "__attribute__", "__declspec", "asm", "__asm__", "sizeof", "__alignof__", "_Alignas", "__typeof__",
+            "void", "char", "short", "int", "long", "unsigned", "signed", "float", "double", "_Bool", "bool",
+            "const", "volatile", "static", "extern", "inline", "typedef", "struct", "union", "enum",
+            };
+        for(const char* k : KEYWORDS)
+            if( s == k )
+                return true;
+        return false;
+    }
+    bool is_attribute(const ::std::string& s) {
+        return s == "__attribute__" || s == "__declspec" || s == "asm" || s == "__asm__";
+    }
+
+    /// If there's a comment or string/character literal at `i`, returns the index after it (otherwise returns `i`)
+    size_t skip_comment_or_literal(const ::std::string& s, size_t i)
+    {
+        if( s.compare(i, 2, "//") == 0 )
+        {
+            // Stop at the newline, it matters for finding preprocessor lines
+            auto e = s.find('\n', i);
+            return e == ::std::string::npos ? s.size() : e;
+        }
+        if( s.compare(i, 2, "/*") == 0 )
+        {
+            auto e = s.find("*/", i+2);
+            return e == ::std::string::npos ? s.size() : e + 2;
+        }
+        if( s[i] == '"' || s[i] == '\'' )
+        {
+            char q = s[i];
+            i ++;
+            while( i < s.size() && s[i] != q && s[i] != '\n' )
+                i += (s[i] == '\\' ? 2 : 1);
+            return ::std::min(i + 1, s.size());
+        }
+        return i;
+    }
+
+    /// Calls `cb` with every identifier in `s[b .. e]`
+    /// - Ones in comments and literals are included, which only makes the dependencies more conservative
+    template<typename Cb>
+    void for_each_ident(const ::std::string& s, size_t b, size_t e, Cb cb)
+    {
+        size_t i = b;
+        while( i < e )
+        {
+            if( is_ident_start(s[i]) )
+            {
+                size_t start = i;
+                while( i < e && is_ident_char(s[i]) )
+                    i ++;
+                cb(s.substr(start, i - start));
+            }
+            else if( '0' <= s[i] && s[i] <= '9' )
+            {
+                // Skip numbers whole, so suffixes (e.g. `ull`) aren't identifiers
+                while( i < e && is_ident_char(s[i]) )
+                    i ++;
+            }
+            else
+            {
+                i ++;
+            }
+        }
+    }
+}
+
+Trans_FingerprintDb::Trans_FingerprintDb(::std::string path):
+    m_path( ::std::move(path) )
+{
+    ::std::ifstream is(m_path);
+    if( !is.is_open() )
+        return ;
+    ::std::string   line;
+    if( !::std::getline(is, line) || line != DB_MAGIC )
+    {
+        DEBUG("Ignoring " << m_path << " - bad header");
+        return ;
+    }
+    // `<fingerprint> <output path>` (the path is last, as it can contain spaces)
+    while( ::std::getline(is, line) )
+    {
+        auto sp = line.find(' ');
+        if( sp == ::std::string::npos )
+            continue ;
+        m_old[line.substr(sp+1)] = line.substr(0, sp);
+    }
+}
+
+bool Trans_FingerprintDb::check(const ::std::string& output, const ::std::string& fingerprint)
+{
+    m_new[output] = fingerprint;
+    auto it = m_old.find(output);
+    if( it == m_old.end() || it->second != fingerprint )
+        return false;
+    return ::std::ifstream(output).is_open();
+}
+
+void Trans_FingerprintDb::save() const
+{
+    // Write to a temporary then rename, so an interrupted write can't leave a truncated database
+    auto tmp_path = m_path + ".tmp";
+    {
+        ::std::ofstream os(tmp_path);
+        if( !os.is_open() )
+        {
+            DEBUG("Unable to write " << tmp_path);
+            return ;
+        }
+        os << DB_MAGIC << "\n";
+        for(const auto& e : m_new)
+            os << e.second << " " << e.first << "\n";
+    }
+    if( ::std::rename(tmp_path.c_str(), m_path.c_str()) != 0 )
+    {
+        ::std::remove(tmp_path.c_str());
+    }
+}
+
+Trans_HeaderIndex::Trans_HeaderIndex(const ::std::string& path)
+{
+    ::std::ifstream is(path, ::std::ios::binary);
+    if( !is.is_open() )
+    {
+        DEBUG("Unable to read " << path);
+        return ;
+    }
+    m_text.assign(::std::istreambuf_iterator<char>(is), ::std::istreambuf_iterator<char>());
+    m_loaded = true;
+    const auto& s = m_text;
+
+    // A declaration ends at a `;` at depth zero, or (for function definitions - where a `(` is seen before the
+    // first `{`) at the `}` that closes the body.
+    // The names it declares are the identifiers (at depth zero) directly before `(`, `[`, `{`, `;`, `,`, `=` or an
+    // attribute, and `name` in `(*name`. Missing a name would make the fingerprints unsound, extra ones only cost
+    // precision.
+    enum class Prev {
+        Other,
+        Ident,  // `prev_ident` at depth zero
+        OpenParen,  // `(` at depth zero
+        ParenStar,  // `(*` at depth zero
+    };
+    size_t  start = 0;
+    unsigned    depth = 0;
+    bool    is_function = false;
+    bool    seen_brace = false;
+    bool    has_tokens = false;
+    Prev    prev = Prev::Other;
+    ::std::string   prev_ident;
+    ::std::vector< ::std::string>   names;
+    auto end_decl = [&](size_t end) {
+        size_t idx = m_decls.size();
+        m_decls.push_back(Decl { start, end });
+        if( names.empty() )
+            m_always.push_back(idx);
+        for(const auto& n : names)
+        {
+            auto& v = m_declared_by[n];
+            if( v.empty() || v.back() != idx )
+                v.push_back(idx);
+        }
+        start = end;
+        depth = 0;
+        is_function = false;
+        seen_brace = false;
+        has_tokens = false;
+        prev = Prev::Other;
+        names.clear();
+    };
+    auto add_prev_name = [&]() {
+        if( prev == Prev::Ident && !is_keyword(prev_ident) )
+            names.push_back(prev_ident);
+    };
+
+    bool    line_start = true;
+    size_t  i = 0;
+    while( i < s.size() )
+    {
+        char c = s[i];
+        if( c == '\n' ) {
+            line_start = true;
+            i ++;
+            continue ;
+        }
+        if( c == ' ' || c == '\t' || c == '\r' ) {
+            i ++;
+            continue ;
+        }
+        // Preprocessor lines (with any `\` continuations) are always included
+        if( line_start && c == '#' && depth == 0 )
+        {
+            if( has_tokens )
+                end_decl(i);
+            while( i < s.size() && s[i] != '\n' )
+                i += (s[i] == '\\' ? 2 : 1);
+            i = ::std::min(i, s.size());
+            end_decl(i);
+            continue ;
+        }
+        line_start = false;
+        size_t j = skip_comment_or_literal(s, i);
+        if( j != i ) {
+            // NOTE: Comments are ignored (they stay attached to the next declaration), literals are tokens
+            if( c == '"' || c == '\'' ) {
+                has_tokens = true;
+                prev = Prev::Other;
+            }
+            i = j;
+            continue ;
+        }
+        has_tokens = true;
+
+        if( is_ident_start(c) || ('0' <= c && c <= '9') )
+        {
+            size_t b = i;
+            while( i < s.size() && is_ident_char(s[i]) )
+                i ++;
+            if( !is_ident_start(c) ) {
+                prev = Prev::Other;
+            }
+            else if( depth == 0 ) {
+                auto id = s.substr(b, i - b);
+                if( is_attribute(id) )
+                    add_prev_name();
+                prev = Prev::Ident;
+                prev_ident = ::std::move(id);
+            }
+            else if( depth == 1 && prev == Prev::ParenStar ) {
+                names.push_back(s.substr(b, i - b));
+                prev = Prev::Other;
+            }
+            else {
+                prev = Prev::Other;
+            }
+            continue ;
+        }
+        i ++;
+
+        if( depth == 1 && prev == Prev::OpenParen && c == '*' ) {
+            prev = Prev::ParenStar;
+            continue ;
+        }
+        if( depth == 0 )
+        {
+            switch(c)
+            {
+            case '(': case '[': case '{': case ';': case ',': case '=':
+                add_prev_name();
+                break;
+            }
+        }
+        prev = Prev::Other;
+        switch(c)
+        {
+        case '(':
+            if( depth == 0 && !seen_brace )
+                is_function = true;
+            if( depth == 0 )
+                prev = Prev::OpenParen;
+            depth ++;
+            break;
+        case '[':
+            depth ++;
+            break;
+        case '{':
+            if( depth == 0 )
+                seen_brace = true;
+            depth ++;
+            break;
+        case ')': case ']': case '}':
+            if( depth > 0 )
+                depth --;
+            if( c == '}' && depth == 0 && is_function )
+                end_decl(i);
+            break;
+        case ';':
+            if( depth == 0 )
+                end_decl(i);
+            break;
+        }
+    }
+    if( has_tokens )
+        end_decl(s.size());
+    DEBUG(path << ": " << m_decls.size() << " declarations, " << m_always.size() << " always used");
+}
+
+void Trans_HeaderIndex::feed_used(Fnv64& h, const ::std::string& code) const
+{
+    ::std::vector<bool> used(m_decls.size());
+    ::std::vector<size_t>   stack;
+    ::std::unordered_set< ::std::string>   seen;
+    auto use_ident = [&](::std::string id) {
+        auto it = m_declared_by.find(id);
+        if( it == m_declared_by.end() || !seen.insert(::std::move(id)).second )
+            return ;
+        for(auto idx : it->second)
+        {
+            if( !used[idx] ) {
+                used[idx] = true;
+                stack.push_back(idx);
+            }
+        }
+    };
+    for(auto idx : m_always)
+    {
+        used[idx] = true;
+        stack.push_back(idx);
+    }
+    for_each_ident(code, 0, code.size(), use_ident);
+    while( !stack.empty() )
+    {
+        auto idx = stack.back();
+        stack.pop_back();
+        for_each_ident(m_text, m_decls[idx].start, m_decls[idx].end, use_ident);
+    }
+
+    size_t  n_used = 0;
+    for(size_t idx = 0; idx < m_decls.size(); idx ++)
+    {
+        if( used[idx] )
+        {
+            h.feed(m_text.data() + m_decls[idx].start, m_decls[idx].end - m_decls[idx].start);
+            h.feed("", 1);
+            n_used ++;
+        }
+    }
+    DEBUG("Using " << n_used << " of " << m_decls.size() << " header declarations");
+}
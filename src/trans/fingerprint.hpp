@@ -0,0 +1,57 @@
+/*
+ * MRustC - Rust Compiler
+ * - By John Hodge (Mutabah/thePowersGang)
+ *
+ * trans/fingerprint.hpp
+ * - Fingerprint database and header index used for incremental rebuilds
+ */
+#pragma once
+#include <string>
+#include <map>
+#include <vector>
+#include <unordered_map>
+#include <fnv.hpp>
+
+/// Fingerprints saved from the previous build (`<output>.incr`), used with `-C incremental`
+///
+/// Maps an output file to the fingerprint of everything that went into producing it. The database is only saved
+/// once the whole build has succeeded, and an entry is only trusted if its output still exists.
+class Trans_FingerprintDb
+{
+    ::std::string   m_path;
+    ::std::map< ::std::string, ::std::string>   m_old;
+    ::std::map< ::std::string, ::std::string>   m_new;
+public:
+    Trans_FingerprintDb(::std::string path);
+
+    /// Record the fingerprint for `output`, returns true if it matches the previous build (and the output exists)
+    bool check(const ::std::string& output, const ::std::string& fingerprint);
+    void save() const;
+};
+
+/// Index of the top-level declarations in a generated C header (used with `-C incremental`)
+///
+/// Lets each codegen unit be fingerprinted with only the declarations it (transitively) refers to, so that adding
+/// or changing an unrelated function/type doesn't invalidate every unit. Preprocessor lines and anything that
+/// doesn't obviously declare a name are always included.
+class Trans_HeaderIndex
+{
+    struct Decl {
+        size_t  start;
+        size_t  end;
+    };
+    bool    m_loaded = false;
+    ::std::string   m_text;
+    ::std::vector<Decl> m_decls;
+    ::std::vector<size_t>   m_always;
+    ::std::unordered_map< ::std::string, ::std::vector<size_t> >   m_declared_by;
+public:
+    /// Load and split the header
+    Trans_HeaderIndex(const ::std::string& path);
+
+    /// False if the header couldn't be read (so no fingerprint can be trusted)
+    bool is_loaded() const { return m_loaded; }
+
+    /// Feed every declaration used by `code` (and by those declarations) into the hash, in header order
+    void feed_used(Fnv64& h, const ::std::string& code) const;
+};
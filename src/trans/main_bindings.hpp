@@ -18,6 +18,12 @@ struct TransOptions
     unsigned int opt_level = 0;
     bool emit_debug_info = false;
     ::std::string   build_command_file;
+    // Number of C files that function bodies are split across (compiled in parallel)
+    unsigned int codegen_units = 1;
+    // Directory used to cache code for monomorphised functions from other crates (empty to disable)
+    ::std::string   mono_cache_dir;
+    // Only recompile codegen units whose C code (or compiler options) changed since the last build
+    bool incremental = false;
 
     ::std::vector< ::std::string>   library_search_dirs;
     ::std::vector< ::std::string>   libraries;
@@ -57,7 +57,7 @@ namespace {
         ss << "_ZN";
         {
             ::std::string   cn;
-            for(auto c : path.m_crate_name)
+            for(auto c : path.m_crate_name.str())
             {
                 if(c == '-') {
                     cn += "$$";
@@ -0,0 +1,190 @@
+/*
+ * MRustC - Rust Compiler
+ * - By John Hodge (Mutabah/thePowersGang)
+ *
+ * trans/mono_cache.cpp
+ * - On-disk cache of code generated for monomorphised upstream generics
+ */
+#include "mono_cache.hpp"
+#include "main_bindings.hpp"
+#include "trans_list.hpp"
+#include "target.hpp"
+#include "fingerprint.hpp"
+#include <hir/hir.hpp>
+#include <hir_typeck/common.hpp>
+#include <mir/main_bindings.hpp> // g_mir_inline_options
+#include <fstream>
+#include <sstream>
+#include <cstdio>   // rename, remove
+#include <chrono>
+#include <algorithm>    // sort
+#ifdef _WIN32
+# define NOGDI  // Don't include GDI functions (defines some macros that collide with mrustc ones)
+# include <Windows.h>
+#endif
+
+namespace {
+    /// Path to the running compiler executable
+    ::std::string get_own_executable()
+    {
+#ifdef _WIN32
+        char    buf[MAX_PATH];
+        auto len = GetModuleFileNameA(NULL, buf, sizeof(buf));
+        return ::std::string(buf, len);
+#else
+        // TODO: Other platforms (e.g. `_NSGetExecutablePath` on macOS)
+        return "/proc/self/exe";
+#endif
+    }
+}
+
+Trans_MonoCache::Trans_MonoCache(const ::HIR::Crate& crate, const TransOptions& opt):
+    m_dir(opt.mono_cache_dir),
+    m_crate(crate)
+{
+    if( m_dir == "" )
+        return ;
+    if( m_dir.back() != '/' && m_dir.back() != '\\' )
+        m_dir += "/";
+
+    // Generated code depends on the compiler build, the target, the options that change the generated code, and every upstream crate
+    // - Each upstream crate is identified by the content hash recorded in its metadata
+    const auto& target = Target_GetCurSpec();
+    Fnv64   h;
+    h.feed("mrustc-mono-v2");
+    // - The compiler binary itself, so a rebuilt/upgraded compiler never uses code generated by another build
+    if( !h.feed_file(get_own_executable()) )
+    {
+        ::std::cerr << "warning: Unable to identify the compiler executable, monomorphisation cache disabled" << ::std::endl;
+        m_dir = "";
+        return ;
+    }
+    h.feed(target.m_family);
+    h.feed(target.m_os_name);
+    h.feed(target.m_env_name);
+    h.feed(target.m_c_compiler);
+    h.feed(target.m_arch.m_name);
+    h.feed(FMT(static_cast<int>(target.m_codegen_mode) << "," << target.m_arch.m_pointer_bits << "," << (opt.codegen_units > 1)));
+    // Monomorphised functions are optimised (including inlining) before codegen
+    h.feed(FMT("inline=" << g_mir_inline_options.threshold << "," << g_mir_inline_options.budget));
+    ::std::vector< ::std::string>   crates;
+    for(const auto& ec : crate.m_ext_crates)
+        crates.push_back( FMT(ec.first << "=" << ::std::hex << ec.second.m_data->m_content_hash) );
+    // Sorted, as `m_ext_crates` is unordered
+    ::std::sort(crates.begin(), crates.end());
+    for(const auto& c : crates)
+        h.feed(c);
+    m_env_key = h.str();
+    DEBUG("Monomorphisation cache " << m_dir << " - env " << m_env_key);
+}
+Trans_MonoCache::~Trans_MonoCache()
+{
+    if( is_enabled() )
+    {
+        DEBUG("Monomorphisation cache: " << m_hits << " hits, " << m_misses << " misses");
+    }
+}
+
+bool Trans_MonoCache::is_cacheable(const ::HIR::Path& path, const Trans_Params& pp) const
+{
+    if( !is_enabled() )
+        return false;
+    const auto& local_name = m_crate.m_crate_name;
+    // Returns true if the type could depend on something in the current crate
+    auto is_local = [&](const ::HIR::TypeRef& ty)->bool {
+        TU_MATCH_DEF(::HIR::TypeRef::Data, (ty.m_data), (te),
+        (
+            return false;
+            ),
+        (Path,
+            // UFCS should have been expanded by now, be conservative
+            if( !te.path.m_data.is_Generic() )
+                return true;
+            return te.path.m_data.as_Generic().m_path.m_crate_name == local_name;
+            ),
+        (TraitObject,
+            if( te.m_trait.m_path.m_path.m_crate_name == local_name )
+                return true;
+            for(const auto& m : te.m_markers)
+                if( m.m_path.m_crate_name == local_name )
+                    return true;
+            return false;
+            ),
+        (Generic,
+            return true;
+            ),
+        (ErasedType,
+            return true;
+            ),
+        (Closure,
+            return true;
+            )
+        )
+        };
+    auto params_local = [&](const ::HIR::PathParams& params)->bool {
+        for(const auto& ty : params.m_types)
+            if( visit_ty_with(ty, is_local) )
+                return true;
+        return false;
+        };
+    if( params_local(pp.pp_impl) || params_local(pp.pp_method) )
+        return false;
+    if( visit_ty_with(pp.self_type, is_local) )
+        return false;
+    return true;
+}
+
+::std::string Trans_MonoCache::get_key(const ::HIR::Path& path, const Trans_Params& pp) const
+{
+    return FMT(m_env_key << " " << path << " impl" << pp.pp_impl << " method" << pp.pp_method << " self=" << pp.self_type);
+}
+::std::string Trans_MonoCache::get_entry_path(const ::std::string& key) const
+{
+    Fnv64   h;
+    h.feed(key);
+    return m_dir + h.str() + ".c";
+}
+
+bool Trans_MonoCache::lookup(const ::HIR::Path& path, const Trans_Params& pp, ::std::string& out_code)
+{
+    auto key = get_key(path, pp);
+    ::std::ifstream is(get_entry_path(key), ::std::ios::binary);
+    if( is.is_open() )
+    {
+        // First line is the full key (to detect hash collisions)
+        ::std::string   line;
+        ::std::getline(is, line);
+        if( line == "// " + key )
+        {
+            ::std::stringstream ss;
+            ss << is.rdbuf();
+            out_code = ss.str();
+            m_hits ++;
+            DEBUG("Hit " << path);
+            return true;
+        }
+        DEBUG("Key mismatch for " << path << " - " << line);
+    }
+    m_misses ++;
+    return false;
+}
+void Trans_MonoCache::store(const ::HIR::Path& path, const Trans_Params& pp, const ::std::string& code)
+{
+    auto key = get_key(path, pp);
+    auto entry_path = get_entry_path(key);
+    // Write to a temporary then rename, so concurrent builds never see a partial entry
+    auto tmp_path = FMT(entry_path << "." << ::std::chrono::steady_clock::now().time_since_epoch().count() << "-" << reinterpret_cast<uintptr_t>(this) << ".tmp");
+    {
+        ::std::ofstream os(tmp_path, ::std::ios::binary);
+        if( !os.is_open() )
+        {
+            DEBUG("Unable to write " << tmp_path);
+            return ;
+        }
+        os << "// " << key << "\n" << code;
+    }
+    if( ::std::rename(tmp_path.c_str(), entry_path.c_str()) != 0 )
+    {
+        ::std::remove(tmp_path.c_str());
+    }
+}
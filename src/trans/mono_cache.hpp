@@ -0,0 +1,50 @@
+/*
+ * MRustC - Rust Compiler
+ * - By John Hodge (Mutabah/thePowersGang)
+ *
+ * trans/mono_cache.hpp
+ * - On-disk cache of code generated for monomorphised upstream generics
+ */
+#pragma once
+#include <string>
+#include <cstdint>
+
+namespace HIR {
+    class Crate;
+    class Path;
+}
+struct Trans_Params;
+struct TransOptions;
+
+/// Cache of generated code for monomorphised functions from external crates
+///
+/// Entries are keyed by the function path, the monomorphisation parameters, and the content hash recorded in every
+/// loaded extern crate's metadata (along with the target and codegen settings), so can be shared between any builds
+/// that use the same upstream crates.
+class Trans_MonoCache
+{
+    ::std::string   m_dir;
+    const ::HIR::Crate& m_crate;
+    // Hash of the target/options and the content hashes of all loaded extern crates
+    ::std::string   m_env_key;
+
+    unsigned int    m_hits = 0;
+    unsigned int    m_misses = 0;
+public:
+    Trans_MonoCache(const ::HIR::Crate& crate, const TransOptions& opt);
+    ~Trans_MonoCache();
+
+    bool is_enabled() const { return m_dir != ""; }
+
+    /// Check if the generated code for this function can be cached (i.e. it only depends on upstream crates)
+    bool is_cacheable(const ::HIR::Path& path, const Trans_Params& pp) const;
+
+    /// Look up cached code for a function, returns false on a miss
+    bool lookup(const ::HIR::Path& path, const Trans_Params& pp, ::std::string& out_code);
+    /// Save generated code for a function
+    void store(const ::HIR::Path& path, const Trans_Params& pp, const ::std::string& code);
+
+private:
+    ::std::string get_key(const ::HIR::Path& path, const Trans_Params& pp) const;
+    ::std::string get_entry_path(const ::std::string& key) const;
+};
@@ -10,6 +10,7 @@
 #include "../expand/cfg.hpp"
 #include <fstream>
 #include <map>
+#include <mutex>
 #include <hir/hir.hpp>
 #include <hir_typeck/helpers.hpp>
 
@@ -244,17 +245,24 @@ namespace {
 }
 const StructRepr* Target_GetStructRepr(const Span& sp, const StaticTraitResolve& resolve, const ::HIR::TypeRef& ty)
 {
-    // TODO: Thread safety
     // Map of generic paths to struct representations.
     static ::std::map<::HIR::TypeRef, ::std::unique_ptr<StructRepr>>  s_cache;
+    // NOTE: Not held while generating the representation, as that can recurse
+    static ::std::mutex s_cache_lock;
 
-    auto it = s_cache.find(ty);
-    if( it != s_cache.end() )
     {
-        return it->second.get();
+        ::std::lock_guard< ::std::mutex>    lh { s_cache_lock };
+        auto it = s_cache.find(ty);
+        if( it != s_cache.end() )
+        {
+            return it->second.get();
+        }
     }
 
-    auto ires = s_cache.insert(::std::make_pair( ty.clone(), make_struct_repr(sp, resolve, ty) ));
+    auto repr = make_struct_repr(sp, resolve, ty);
+    ::std::lock_guard< ::std::mutex>    lh { s_cache_lock };
+    // If another thread got here first, its entry is kept
+    auto ires = s_cache.insert(::std::make_pair( ty.clone(), mv$(repr) ));
     return ires.first->second.get();
 }
 